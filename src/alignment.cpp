@@ -0,0 +1,218 @@
+#include "alignment.h"
+#include "fft.h"
+#include "parallel.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <new>
+#include <vector>
+
+// Copy a region into data[], zero-padding the rest of the transform and the points of the region
+// that lie past either end of the spectrum. The reference region has its mean removed, which
+// makes the correlation blind to offsets (and, with the full overlap below, to slopes) in the
+// other spectrum.
+static void loadSegment(std::complex<double> data[], int size, const float spectrum[], int SIZE, int firstIndex, int length, bool removeMean)
+{
+    double mean = 0;
+    if(removeMean)
+    {
+        for(int i = 0; i < length; i++)
+            mean += spectrum[firstIndex + i];
+        mean /= length;
+    }
+    for(int i = 0; i < length; i++)
+    {
+        int index = firstIndex + i;
+        data[i] = std::complex<double>(( index >= 0 && index < SIZE ? spectrum[index] - mean : 0 ), 0);
+    }
+    for(int i = length; i < size; i++)
+        data[i] = 0;
+    return;
+}
+
+spa::Status estimateShifts(
+    float shifts[],
+    float** IR_DATA,
+    int NUM_SPA_FILES,
+    int SIZE,
+    const float reference[],
+    int firstIndex,
+    int lastIndex,
+    int maxShift,
+    int numThreads
+)
+{
+    // Each spectrum contributes the region widened by maxShift on both sides, so every lag we
+    // search overlaps the whole reference region and small lags are not favoured. Near either
+    // end of the spectrum the widened region runs off it; those lags are scored over the part of
+    // the region they still overlap, and lags overlapping less than half of it are not searched.
+    if(firstIndex < 0 || lastIndex >= SIZE || lastIndex < firstIndex || maxShift < 0) return spa::ERROR_ARGUMENT;
+    const int length = lastIndex - firstIndex + 1;
+    const int widenedLength = length + 2 * maxShift;
+    const int minOverlap = (length + 1) / 2;
+    // Padding past both lengths keeps the circular correlation from wrapping
+    const int size = nextPowerOfTwo(length + widenedLength);
+    FftPlan* plan = createFftPlan(size);
+    if(plan == nullptr) return spa::ERROR_OUT_OF_MEMORY;
+
+    try
+    {
+        std::vector<std::complex<double> > referenceSpectrum(size);
+        loadSegment(&referenceSpectrum[0], size, reference, SIZE, firstIndex, length, true);
+        // Running sums of the (mean-removed) reference region, for the lags that overlap only part of it
+        std::vector<double> referenceSums(length + 1, 0);
+        std::vector<double> referenceSquares(length + 1, 0);
+        for(int n = 0; n < length; n++)
+        {
+            double value = referenceSpectrum[n].real();
+            referenceSums[n + 1] = referenceSums[n] + value;
+            referenceSquares[n + 1] = referenceSquares[n] + value * value;
+        }
+        const double referenceSpread = referenceSquares[length] - referenceSums[length] * referenceSums[length] / length;
+        fft(plan, &referenceSpectrum[0]);
+
+        if(numThreads > NUM_SPA_FILES) numThreads = NUM_SPA_FILES;
+        if(numThreads < 1) numThreads = 1;
+        std::vector<std::vector<std::complex<double> > > workspaces(numThreads, std::vector<std::complex<double> >(size));
+
+        std::vector<std::vector<double> > scores(numThreads, std::vector<double>(2 * maxShift + 1));
+
+        // Points of the spectrum, zero past either end
+        auto pointAt = [SIZE](const float spectrum[], int index) -> double
+        {
+            return ( index >= 0 && index < SIZE ? spectrum[index] : 0 );
+        };
+
+        auto measureShift = [&](const float spectrum[], std::complex<double> data[], int thread)
+        {
+            loadSegment(data, size, spectrum, SIZE, firstIndex - maxShift, widenedLength, false);
+            fft(plan, data);
+            for(int k = 0; k < size; k++)
+                data[k] = data[k] * std::conj(referenceSpectrum[k]);
+            inverseFft(plan, data);
+
+            // data[maxShift + lag] now holds sum_n x[firstIndex + n + lag] ref[firstIndex + n]. Dividing
+            // by the spread of x over each lag's window gives the normalized (Pearson) correlation, so
+            // broad slopes across the region cannot outweigh the match of the peaks.
+            double* score = &scores[thread][0];
+            double sum = 0;
+            double sumSquares = 0;
+            for(int n = 0; n < length; n++)
+            {
+                double value = pointAt(spectrum, firstIndex - maxShift + n);
+                sum += value;
+                sumSquares += value * value;
+            }
+            int firstLag = maxShift + 1;
+            int lastLag = -maxShift - 1;
+            for(int lag = -maxShift; lag <= maxShift; lag++)
+            {
+                if(lag > -maxShift)
+                { // Slide the window one point to the right
+                    double leaving = pointAt(spectrum, firstIndex + lag - 1);
+                    double entering = pointAt(spectrum, firstIndex + lag + length - 1);
+                    sum += entering - leaving;
+                    sumSquares += entering * entering - leaving * leaving;
+                }
+                // Points n of the region for which x[firstIndex + n + lag] lies on the spectrum
+                const int firstOverlap = std::max(0, -(firstIndex + lag));
+                const int endOverlap = std::min(length, SIZE - (firstIndex + lag));
+                const int overlap = endOverlap - firstOverlap;
+                if(overlap < minOverlap)
+                {
+                    score[maxShift + lag] = -HUGE_VAL;
+                    continue;
+                }
+                firstLag = std::min(firstLag, lag);
+                lastLag = std::max(lastLag, lag);
+                double spread = sumSquares - sum * sum / overlap;
+                double product = data[maxShift + lag].real();
+                if(overlap < length)
+                { // Centre the reference over the overlap alone, and scale by its spread there
+                    double referenceSum = referenceSums[endOverlap] - referenceSums[firstOverlap];
+                    double overlapSpread = referenceSquares[endOverlap] - referenceSquares[firstOverlap]
+                        - referenceSum * referenceSum / overlap;
+                    product -= sum * referenceSum / overlap;
+                    spread *= ( referenceSpread > 0 ? overlapSpread / referenceSpread : 0 );
+                }
+                score[maxShift + lag] = ( spread > 0 ? product / std::sqrt(spread) : 0 );
+            }
+
+            int bestLag = 0;
+            double best = score[maxShift];
+            for(int lag = firstLag; lag <= lastLag; lag++)
+                if(score[maxShift + lag] > best)
+                {
+                    best = score[maxShift + lag];
+                    bestLag = lag;
+                }
+            // A maximum on the edge of the search is not a peak: report it as unmatched (NaN)
+            if(bestLag == firstLag || bestLag == lastLag) return std::nan("");
+            // Vertex of the parabola through the peak and its neighbours
+            double shift = bestLag;
+            double left = score[maxShift + bestLag - 1];
+            double right = score[maxShift + bestLag + 1];
+            double curvature = left - 2 * best + right;
+            if(curvature < 0) shift += 0.5 * (left - right) / curvature;
+            return shift;
+        };
+
+        // The parabola is slightly off-centre even for the reference against itself; that offset
+        // is the same for every spectrum, so measure it once and take it out
+        const double referenceShift = measureShift(reference, &workspaces[0][0], 0);
+        parallelFor(NUM_SPA_FILES, numThreads, [&](int file, int thread)
+        {
+            TraceScope trace("kernel", "measureShift", nullptr, file);
+            shifts[file] = (float)(measureShift(IR_DATA[file], &workspaces[thread][0], thread) - referenceShift);
+        });
+    }
+    catch(const std::bad_alloc&)
+    {
+        deleteFftPlan(plan);
+        return spa::ERROR_OUT_OF_MEMORY;
+    }
+    deleteFftPlan(plan);
+    return spa::OK;
+}
+
+// Catmull-Rom interpolation of spectrum[] at fractional index x, clamped to the ends
+static float sampleAt(const float spectrum[], int SIZE, double x)
+{
+    if(x <= 0) return spectrum[0];
+    if(x >= SIZE - 1) return spectrum[SIZE - 1];
+    int i = (int)x;
+    double t = x - i;
+    double p0 = spectrum[i > 0 ? i - 1 : 0];
+    double p1 = spectrum[i];
+    double p2 = spectrum[i + 1];
+    double p3 = spectrum[i + 2 < SIZE ? i + 2 : SIZE - 1];
+    return (float)(p1 + 0.5 * t * (p2 - p0 + t * (2 * p0 - 5 * p1 + 4 * p2 - p3 + t * (3 * (p1 - p2) + p3 - p0))));
+}
+
+spa::Status applyShifts(float** IR_DATA, int NUM_SPA_FILES, int SIZE, const float shifts[], int numThreads)
+{
+    if(numThreads > NUM_SPA_FILES) numThreads = NUM_SPA_FILES;
+    if(numThreads < 1) numThreads = 1;
+    std::vector<std::vector<float> > workspaces;
+    try
+    {
+        workspaces.assign(numThreads, std::vector<float>(SIZE));
+    }
+    catch(const std::bad_alloc&)
+    {
+        return spa::ERROR_OUT_OF_MEMORY;
+    }
+    parallelFor(NUM_SPA_FILES, numThreads, [&](int file, int thread)
+    {
+        if(shifts[file] == 0) return;
+        float* original = &workspaces[thread][0];
+        for(int i = 0; i < SIZE; i++)
+            original[i] = IR_DATA[file][i];
+        // A spectrum shifted by d holds the reference's point n at index n + d
+        for(int i = 0; i < SIZE; i++)
+            IR_DATA[file][i] = sampleAt(original, SIZE, i + (double)shifts[file]);
+    });
+    return spa::OK;
+}
@@ -0,0 +1,28 @@
+#ifndef ALIGNMENT_H
+#define ALIGNMENT_H
+
+#include "spa.h"
+
+// Estimate, for each spectrum, the (fractional) number of points by which the region between
+// firstIndex and lastIndex is shifted relative to the same region of the reference spectrum,
+// using normalized FFT cross-correlation and a parabola through the correlation peak. Shifts larger than
+// maxShift points are not considered, nor are shifts that would move more than half of the region
+// past an end of the spectrum. A spectrum whose best match lies on the edge of that search is
+// left with a NaN shift, for the caller to report or replace.
+spa::Status estimateShifts(
+    float shifts[],
+    float** IR_DATA,
+    int NUM_SPA_FILES,
+    int SIZE,
+    const float reference[],
+    int firstIndex,
+    int lastIndex,
+    int maxShift,
+    int numThreads
+);
+
+// Resample every spectrum so that its estimated shift is removed (cubic interpolation;
+// points shifted in from beyond either end repeat the end value)
+spa::Status applyShifts(float** IR_DATA, int NUM_SPA_FILES, int SIZE, const float shifts[], int numThreads);
+
+#endif // ALIGNMENT_H
@@ -0,0 +1,319 @@
+#include "baseline-correction.h"
+#include "parallel.h"
+#include "processing.h"
+#include "trace.h"
+
+#include <cmath>
+#include <new>
+#include <vector>
+
+// Factor the symmetric positive definite matrix N (n x n, row-major) in place as L L^T
+static bool choleskyFactor(double* N, int n)
+{
+    for(int j = 0; j < n; j++)
+    {
+        double diag = N[j*n + j];
+        for(int k = 0; k < j; k++)
+            diag -= N[j*n + k] * N[j*n + k];
+        if(diag <= 0) return false;
+        N[j*n + j] = std::sqrt(diag);
+        for(int i = j + 1; i < n; i++)
+        {
+            double value = N[i*n + j];
+            for(int k = 0; k < j; k++)
+                value -= N[i*n + k] * N[j*n + k];
+            N[i*n + j] = value / N[j*n + j];
+        }
+    }
+    return true;
+}
+
+// Solve L L^T x = b in place, given the factor from choleskyFactor()
+static void choleskySolve(const double* L, int n, double* b)
+{
+    for(int i = 0; i < n; i++)
+    {
+        for(int k = 0; k < i; k++)
+            b[i] -= L[i*n + k] * b[k];
+        b[i] /= L[i*n + i];
+    }
+    for(int i = n - 1; i >= 0; i--)
+    {
+        for(int k = i + 1; k < n; k++)
+            b[i] -= L[k*n + i] * b[k];
+        b[i] /= L[i*n + i];
+    }
+    return;
+}
+
+spa::Result<PolyBaselinePlan*> createPolyBaselinePlan(int degree, int anchorBounds[], int numWindows, float WAVENUMBER[], int SIZE)
+{
+    if(degree < 0 || degree > MAX_POLY_DEGREE) return spa::ERROR_ARGUMENT;
+
+    // Mark every point that falls inside a window; overlapping windows count each point once
+    bool* isAnchor = new (std::nothrow) bool [SIZE];
+    if(isAnchor == nullptr) return spa::ERROR_OUT_OF_MEMORY;
+    for(int i = 0; i < SIZE; i++)
+        isAnchor[i] = false;
+    for(int w = 0; w < numWindows; w++)
+    {
+        int firstIndex = wavenumToIndex(anchorBounds[2*w], WAVENUMBER, SIZE);
+        int lastIndex = wavenumToIndex(anchorBounds[2*w + 1], WAVENUMBER, SIZE);
+        for(int i = firstIndex; i < lastIndex + 1; i++)
+            isAnchor[i] = true;
+    }
+
+    PolyBaselinePlan* plan = new (std::nothrow) PolyBaselinePlan;
+    if(plan == nullptr)
+    {
+        delete[] isAnchor;
+        return spa::ERROR_OUT_OF_MEMORY;
+    }
+    plan->degree = degree;
+    plan->numAnchors = 0;
+    for(int i = 0; i < SIZE; i++)
+        if(isAnchor[i]) plan->numAnchors++;
+
+    const int numCoeffs = degree + 1;
+    const int numAnchors = plan->numAnchors;
+    plan->anchorIndex = ( numAnchors < numCoeffs ? nullptr : new (std::nothrow) int [numAnchors] );
+    plan->projection = ( numAnchors < numCoeffs ? nullptr : new (std::nothrow) double [numCoeffs * numAnchors] );
+    if(plan->anchorIndex == nullptr || plan->projection == nullptr)
+    {
+        delete[] isAnchor;
+        deletePolyBaselinePlan(plan);
+        return ( numAnchors < numCoeffs ? spa::ERROR_ANCHORS : spa::ERROR_OUT_OF_MEMORY );
+    }
+    for(int i = 0, a = 0; i < SIZE; i++)
+        if(isAnchor[i]) plan->anchorIndex[a++] = i;
+    delete[] isAnchor;
+
+    plan->center = 0.5 * ((double)WAVENUMBER[0] + (double)WAVENUMBER[SIZE - 1]);
+    plan->halfWidth = 0.5 * ((double)WAVENUMBER[0] - (double)WAVENUMBER[SIZE - 1]);
+
+    // Design matrix A: one row of powers 1, x, x^2, ... per anchor point
+    double* powers = plan->projection; // filled with A^T, then overwritten with (A^T A)^-1 A^T
+    for(int a = 0; a < numAnchors; a++)
+    {
+        double x = ((double)WAVENUMBER[plan->anchorIndex[a]] - plan->center) / plan->halfWidth;
+        double power = 1;
+        for(int k = 0; k < numCoeffs; k++, power *= x)
+            powers[k*numAnchors + a] = power;
+    }
+
+    double normal[(MAX_POLY_DEGREE + 1) * (MAX_POLY_DEGREE + 1)];
+    for(int r = 0; r < numCoeffs; r++)
+        for(int c = 0; c < numCoeffs; c++)
+        {
+            double sum = 0;
+            for(int a = 0; a < numAnchors; a++)
+                sum += powers[r*numAnchors + a] * powers[c*numAnchors + a];
+            normal[r*numCoeffs + c] = sum;
+        }
+    if(!choleskyFactor(normal, numCoeffs))
+    {
+        deletePolyBaselinePlan(plan);
+        return spa::ERROR_ANCHORS;
+    }
+
+    // Each column of A^T becomes the matching column of (A^T A)^-1 A^T
+    double column[MAX_POLY_DEGREE + 1];
+    for(int a = 0; a < numAnchors; a++)
+    {
+        for(int k = 0; k < numCoeffs; k++)
+            column[k] = powers[k*numAnchors + a];
+        choleskySolve(normal, numCoeffs, column);
+        for(int k = 0; k < numCoeffs; k++)
+            plan->projection[k*numAnchors + a] = column[k];
+    }
+    return plan;
+}
+
+void deletePolyBaselinePlan(PolyBaselinePlan* plan)
+{
+    delete[] plan->anchorIndex;
+    delete[] plan->projection;
+    delete plan;
+    return;
+}
+
+void computePolyBaselineCorr(
+    float** CORR_DATA,
+    float** IR_DATA,
+    int NUM_SPA_FILES,
+    float WAVENUMBER[],
+    int SIZE,
+    const PolyBaselinePlan* plan,
+    int numThreads
+)
+{
+    const int numCoeffs = plan->degree + 1;
+    const int numAnchors = plan->numAnchors;
+    parallelFor(NUM_SPA_FILES, numThreads, [&](int file, int)
+    {
+        // Fitting is one dot product per coefficient
+        const float* spectrum = IR_DATA[file];
+        double coeff[MAX_POLY_DEGREE + 1];
+        for(int k = 0; k < numCoeffs; k++)
+        {
+            const double* row = &plan->projection[k*numAnchors];
+            double sum = 0;
+            for(int a = 0; a < numAnchors; a++)
+                sum += row[a] * spectrum[plan->anchorIndex[a]];
+            coeff[k] = sum;
+        }
+
+        float* corrected = CORR_DATA[file];
+        for(int i = 0; i < SIZE; i++)
+        {
+            double x = ((double)WAVENUMBER[i] - plan->center) / plan->halfWidth;
+            double baseline = coeff[numCoeffs - 1];
+            for(int k = numCoeffs - 2; k >= 0; k--)
+                baseline = baseline * x + coeff[k];
+            corrected[i] = spectrum[i] - (float)baseline;
+        }
+    });
+    return;
+}
+
+AlsWorkspace* createAlsWorkspace(int SIZE)
+{
+    AlsWorkspace* work = new (std::nothrow) AlsWorkspace;
+    if(work == nullptr) return nullptr;
+    work->size = SIZE;
+    work->weight = new (std::nothrow) double [SIZE];
+    work->diag = new (std::nothrow) double [SIZE];
+    work->lower1 = new (std::nothrow) double [SIZE];
+    work->lower2 = new (std::nothrow) double [SIZE];
+    work->baseline = new (std::nothrow) double [SIZE];
+    if(work->weight == nullptr || work->diag == nullptr || work->lower1 == nullptr
+        || work->lower2 == nullptr || work->baseline == nullptr)
+    {
+        deleteAlsWorkspace(work);
+        return nullptr;
+    }
+    return work;
+}
+
+void deleteAlsWorkspace(AlsWorkspace* work)
+{
+    delete[] work->weight;
+    delete[] work->diag;
+    delete[] work->lower1;
+    delete[] work->lower2;
+    delete[] work->baseline;
+    delete work;
+    return;
+}
+
+// Factor the pentadiagonal matrix W + lambda D^T D as L D L^T and solve it for W y.
+// D^T D has bands (1, -4, 6, -4, 1) away from the ends, so each solve is O(n).
+static void solveAlsSystem(const float y[], AlsWorkspace* work, double lambda)
+{
+    const int n = work->size;
+    const double* w = work->weight;
+    double* d = work->diag;
+    double* l1 = work->lower1;
+    double* l2 = work->lower2;
+    double* z = work->baseline;
+
+    for(int i = 0; i < n; i++)
+    {
+        // Row i of D^T D: diagonal, first and second super-diagonal
+        double a0 = 6;
+        if(i == 0 || i == n - 1) a0 = 1;
+        else if(i == 1 || i == n - 2) a0 = 5;
+        double a1 = ( (i == 0 || i == n - 2) ? -2 : -4 );
+        double a2 = 1;
+
+        double di = w[i] + lambda * a0;
+        if(i >= 1) di -= l1[i - 1] * l1[i - 1] * d[i - 1];
+        if(i >= 2) di -= l2[i - 2] * l2[i - 2] * d[i - 2];
+        d[i] = di;
+
+        if(i + 1 < n)
+        {
+            double offDiag = lambda * a1;
+            if(i >= 1) offDiag -= l2[i - 1] * d[i - 1] * l1[i - 1];
+            l1[i] = offDiag / di;
+        }
+        if(i + 2 < n) l2[i] = lambda * a2 / di;
+    }
+
+    // Forward substitution (L), scaling (D), then back substitution (L^T)
+    for(int i = 0; i < n; i++)
+    {
+        double value = w[i] * y[i];
+        if(i >= 1) value -= l1[i - 1] * z[i - 1];
+        if(i >= 2) value -= l2[i - 2] * z[i - 2];
+        z[i] = value;
+    }
+    for(int i = 0; i < n; i++)
+        z[i] /= d[i];
+    for(int i = n - 1; i >= 0; i--)
+    {
+        if(i + 1 < n) z[i] -= l1[i] * z[i + 1];
+        if(i + 2 < n) z[i] -= l2[i] * z[i + 2];
+    }
+    return;
+}
+
+int fitAlsBaseline(const float spectrum[], AlsWorkspace* work, double lambda, double p, int maxIterations)
+{
+    const int n = work->size;
+    for(int i = 0; i < n; i++)
+        work->weight[i] = 1;
+
+    int iteration = 0;
+    while(iteration < maxIterations)
+    {
+        solveAlsSystem(spectrum, work, lambda);
+        iteration++;
+        // Reweight; once no point changes side the fit has converged
+        bool changed = false;
+        for(int i = 0; i < n; i++)
+        {
+            double newWeight = ( spectrum[i] > work->baseline[i] ? p : 1 - p );
+            if(newWeight != work->weight[i]) changed = true;
+            work->weight[i] = newWeight;
+        }
+        if(!changed) break;
+    }
+    return iteration;
+}
+
+void subtractAlsBaseline(float spectrum[], AlsWorkspace* work, double lambda, double p, int maxIterations)
+{
+    fitAlsBaseline(spectrum, work, lambda, p, maxIterations);
+    for(int i = 0; i < work->size; i++)
+        spectrum[i] -= (float)work->baseline[i];
+    return;
+}
+
+spa::Status applyAlsBaseline(float** IR_DATA, int NUM_SPA_FILES, int SIZE, double lambda, double p, int maxIterations, int numThreads)
+{
+    if(SIZE < 4) return spa::ERROR_ARGUMENT;
+    if(numThreads > NUM_SPA_FILES) numThreads = NUM_SPA_FILES;
+    if(numThreads < 1) numThreads = 1;
+    std::vector<AlsWorkspace*> workspaces(numThreads, nullptr);
+    for(int t = 0; t < numThreads; t++)
+    {
+        workspaces[t] = createAlsWorkspace(SIZE);
+        if(workspaces[t] == nullptr)
+        {
+            for(int u = 0; u < t; u++)
+                deleteAlsWorkspace(workspaces[u]);
+            return spa::ERROR_OUT_OF_MEMORY;
+        }
+    }
+
+    parallelFor(NUM_SPA_FILES, numThreads, [&](int file, int thread)
+    {
+        TraceScope trace("kernel", "subtractAlsBaseline", nullptr, file);
+        subtractAlsBaseline(IR_DATA[file], workspaces[thread], lambda, p, maxIterations);
+    });
+
+    for(int t = 0; t < numThreads; t++)
+        deleteAlsWorkspace(workspaces[t]);
+    return spa::OK;
+}
@@ -0,0 +1,78 @@
+#ifndef BASELINE_CORRECTION_H
+#define BASELINE_CORRECTION_H
+
+#include "spa.h"
+
+const int MAX_POLY_DEGREE = 6;
+
+// Least-squares polynomial fit through anchor windows. Everything here depends only on the
+// wavenumber axis and the anchors, so one plan is built per run and shared by every file.
+struct PolyBaselinePlan
+{
+    int degree;
+    int numAnchors;       // number of data points inside the anchor windows
+    int* anchorIndex;     // [numAnchors] index of each anchor point
+    double* projection;   // [(degree + 1) * numAnchors] rows of (A^T A)^-1 A^T
+    double center;        // wavenumbers are mapped onto [-1, 1] for conditioning
+    double halfWidth;
+};
+
+// ERROR_ARGUMENT for a degree outside [0, MAX_POLY_DEGREE]; ERROR_ANCHORS when the windows hold
+// too few distinct points to fit it
+spa::Result<PolyBaselinePlan*> createPolyBaselinePlan(
+    int degree,
+    int anchorBounds[],   // [2 * numWindows] upper and lower bound of each window
+    int numWindows,
+    float WAVENUMBER[],
+    int SIZE
+);
+void deletePolyBaselinePlan(PolyBaselinePlan* plan);
+
+// CORR_DATA[i] = IR_DATA[i] - (polynomial fitted to IR_DATA[i] at the anchor points)
+void computePolyBaselineCorr(
+    float** CORR_DATA,
+    float** IR_DATA,
+    int NUM_SPA_FILES,
+    float WAVENUMBER[],
+    int SIZE,
+    const PolyBaselinePlan* plan,
+    int numThreads
+);
+
+// Asymmetric least squares (Eilers & Boelens): the baseline z minimizes
+//     sum w_i (y_i - z_i)^2 + lambda * sum (z_i - 2 z_(i+1) + z_(i+2))^2
+// with w_i = p where the spectrum lies above z and 1 - p where it lies below. A small p gives a
+// baseline under absorbance peaks; for % transmission (peaks point down) use p close to 1.
+
+// Scratch space for one spectrum, so each thread allocates once and reuses it for every file
+struct AlsWorkspace
+{
+    int size;
+    double* weight;
+    double* diag;     // LDL^T factor of (W + lambda D^T D): D
+    double* lower1;   // L[i + 1][i]
+    double* lower2;   // L[i + 2][i]
+    double* baseline;
+};
+
+// nullptr if memory runs out
+AlsWorkspace* createAlsWorkspace(int SIZE);
+void deleteAlsWorkspace(AlsWorkspace* work);
+
+// Fit the baseline of spectrum[] into work->baseline; returns the number of iterations used
+int fitAlsBaseline(const float spectrum[], AlsWorkspace* work, double lambda, double p, int maxIterations);
+
+// Subtract the ALS baseline from one spectrum, or from every spectrum, in place. Spectra need
+// at least 4 points (ERROR_ARGUMENT).
+void subtractAlsBaseline(float spectrum[], AlsWorkspace* work, double lambda, double p, int maxIterations);
+spa::Status applyAlsBaseline(
+    float** IR_DATA,
+    int NUM_SPA_FILES,
+    int SIZE,
+    double lambda,
+    double p,
+    int maxIterations,
+    int numThreads
+);
+
+#endif // BASELINE_CORRECTION_H
@@ -0,0 +1,347 @@
+#include "batch-jobs.h"
+#include "parallel.h"
+#include "parse-command-line-args.h"
+#include "read-write.h"
+#include "run-report.h"
+#include "spa.h"
+#include "str-to-int.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Corrected spectra for one correction window, shared by the jobs correcting over it
+struct CorrWindow
+{
+    int ubCorr;
+    int lbCorr;
+    float* offsets;
+    float** data;
+};
+
+// One aggregate, shared by the jobs grouping the same spectra the same way
+struct SharedAggregate
+{
+    int window;     // the CorrWindow aggregated, or -1 for the spectra as read
+    int groupSize;
+    AggregateMode mode;
+    char** colTitles;
+    float** data;
+};
+
+// A CSV file to write: a job's data set, and the spectra it holds
+struct JobOutput
+{
+    const BatchJob* job;
+    std::string prefix;
+    int window;     // as in SharedAggregate
+    int aggregate;  // the SharedAggregate written, or -1 for the spectra themselves
+};
+
+static void jobsFileError(const char* funcDef, const char* path, int lineNumber, const std::string& message)
+{
+    std::cerr << "Error: " << funcDef << ": '" << path << "' line " << lineNumber << ": " << message << "\n";
+    std::exit(1);
+}
+
+void readJobsFile(const char* path, int NUM_SPA_FILES, std::vector<BatchJob>& jobs)
+{
+    const char* funcDef = "void readJobsFile(const char*, int, std::vector<BatchJob>&)";
+    std::ifstream jobsFile (path);
+    if(!jobsFile.is_open())
+    {
+        std::cerr << "Error: " << funcDef << ": unable to open jobs file '" << path << "'.\n";
+        std::exit(1);
+    }
+    std::string line;
+    for(int lineNumber = 1; std::getline(jobsFile, line); lineNumber++)
+    {
+        std::istringstream words(line);
+        std::string name;
+        if(!(words >> name) || name[0] == '#') continue;
+        // The name starts every output file name
+        for(size_t c = 0; c < name.size(); c++)
+            if(!std::isalnum((unsigned char)name[c]) && name[c] != '.' && name[c] != '_' && name[c] != '-')
+                jobsFileError(funcDef, path, lineNumber, "job name '" + name + "' may only have letters, digits, '.', '_' and '-'.");
+        if(name[0] == '-')
+            jobsFileError(funcDef, path, lineNumber, "expected a job name before the options, got '" + name + "'.");
+        for(size_t j = 0; j < jobs.size(); j++)
+            if(jobs[j].name == name)
+                jobsFileError(funcDef, path, lineNumber, "job name '" + name + "' is used more than once.");
+
+        BatchJob job = {name, false, false, 0, 0, "NULL_STRING", "NULL_STRING", false, 0, 0, false, 1, AGGREGATE_MEAN};
+        bool aggregateSpecified = false;
+        std::string option;
+        while(words >> option)
+        {
+            std::string argName = truncateStrAt(option, ARG_VAL_DIV_CHAR);
+            if(option.size() <= argName.size() + 1)
+                jobsFileError(funcDef, path, lineNumber, "expected " + argName + "=<value>.");
+            std::string value = getStrAfter(option, ARG_VAL_DIV_CHAR);
+            bool* given = nullptr;
+            if(argName == UB_ARG_STR || argName == UB_ARG_SHORT_STR)
+                given = &job.upperBoundSpecified;
+            else if(argName == LB_ARG_STR || argName == LB_ARG_SHORT_STR)
+                given = &job.lowerBoundSpecified;
+            else if(argName == CONST_CORR_STR)
+                given = &job.useConstCorr;
+            else if(argName == GROUP_FILES_STR)
+                given = &job.groupFiles;
+            else if(argName == AGGREGATE_STR)
+                given = &aggregateSpecified;
+            else
+                jobsFileError(funcDef, path, lineNumber, "unknown job option '" + argName + "'. Expected "
+                    + UB_ARG_STR + ", " + LB_ARG_STR + ", " + CONST_CORR_STR + ", " + GROUP_FILES_STR + " or " + AGGREGATE_STR + ".");
+            if(*given)
+                jobsFileError(funcDef, path, lineNumber, argName + " specified more than once.");
+            *given = true;
+
+            if(given == &job.upperBoundSpecified)
+            {
+                job.ubStr = value;
+                job.upperBound = strToInt(value);
+            }
+            else if(given == &job.lowerBoundSpecified)
+            {
+                job.lbStr = value;
+                job.lowerBound = strToInt(value);
+            }
+            else if(given == &job.useConstCorr)
+            {
+                job.ubCorr = strToInt(truncateStrAt(value, VAL_VAL_DIV_CHAR));
+                job.lbCorr = strToInt(getStrAfter(value, VAL_VAL_DIV_CHAR));
+                checkBound(&job.ubCorr, &job.lbCorr, spa::MAX_WAVENUMBER, spa::MIN_WAVENUMBER);
+            }
+            else if(given == &job.groupFiles)
+            {
+                job.groupSize = strToInt(value);
+                if(job.groupSize < 1 || NUM_SPA_FILES % job.groupSize != 0)
+                    jobsFileError(funcDef, path, lineNumber, "the number of SPA files cannot be divided into groups of " + value + ".");
+            }
+            else
+                job.aggregateMode = parseAggregateMode(value.c_str());
+        }
+        if(aggregateSpecified && !job.groupFiles)
+            jobsFileError(funcDef, path, lineNumber, AGGREGATE_STR + " given without " + GROUP_FILES_STR + ".");
+        if(job.upperBoundSpecified && job.lowerBoundSpecified)
+            checkBound(&job.upperBound, &job.lowerBound, spa::MAX_WAVENUMBER, spa::MIN_WAVENUMBER);
+        else if(job.upperBoundSpecified)
+            checkBound(job.upperBound, spa::MAX_WAVENUMBER, spa::MIN_WAVENUMBER);
+        else if(job.lowerBoundSpecified)
+            checkBound(job.lowerBound, spa::MAX_WAVENUMBER, spa::MIN_WAVENUMBER);
+        jobs.push_back(job);
+    }
+    if(jobs.empty())
+    {
+        std::cerr << "Error: " << funcDef << ": jobs file '" << path << "' has no jobs.\n";
+        std::exit(1);
+    }
+    return;
+}
+
+static int findCorrWindow(const std::vector<CorrWindow>& windows, int ubCorr, int lbCorr)
+{
+    for(size_t w = 0; w < windows.size(); w++)
+        if(windows[w].ubCorr == ubCorr && windows[w].lbCorr == lbCorr) return (int)w;
+    return -1;
+}
+
+static int findAggregate(const std::vector<SharedAggregate>& aggregates, int window, int groupSize, AggregateMode mode)
+{
+    for(size_t a = 0; a < aggregates.size(); a++)
+        if(aggregates[a].window == window && aggregates[a].groupSize == groupSize && aggregates[a].mode == mode) return (int)a;
+    return -1;
+}
+
+static void addAggregate(std::vector<SharedAggregate>& aggregates, int window, int groupSize, AggregateMode mode)
+{
+    if(findAggregate(aggregates, window, groupSize, mode) != -1) return;
+    SharedAggregate aggregate = {window, groupSize, mode, nullptr, nullptr};
+    aggregates.push_back(aggregate);
+    return;
+}
+
+// The correction windows and aggregates the jobs need, each once; data is not allocated
+static void planSharedData(const std::vector<BatchJob>& jobs, std::vector<CorrWindow>& windows, std::vector<SharedAggregate>& aggregates)
+{
+    for(size_t j = 0; j < jobs.size(); j++)
+    {
+        const BatchJob& job = jobs[j];
+        int window = -1;
+        if(job.useConstCorr)
+        {
+            window = findCorrWindow(windows, job.ubCorr, job.lbCorr);
+            if(window == -1)
+            {
+                CorrWindow newWindow = {job.ubCorr, job.lbCorr, nullptr, nullptr};
+                windows.push_back(newWindow);
+                window = (int)windows.size() - 1;
+            }
+        }
+        if(!job.groupFiles) continue;
+        // The spectra as read, and the corrected ones if the job corrects
+        addAggregate(aggregates, -1, job.groupSize, job.aggregateMode);
+        if(window != -1) addAggregate(aggregates, window, job.groupSize, job.aggregateMode);
+    }
+    return;
+}
+
+long long batchJobSpectra(const std::vector<BatchJob>& jobs, int NUM_SPA_FILES)
+{
+    std::vector<CorrWindow> windows;
+    std::vector<SharedAggregate> aggregates;
+    planSharedData(jobs, windows, aggregates);
+    long long numSpectra = (long long)windows.size() * NUM_SPA_FILES;
+    for(size_t a = 0; a < aggregates.size(); a++)
+        numSpectra += NUM_SPA_FILES / aggregates[a].groupSize;
+    return numSpectra;
+}
+
+bool batchJobReadRanges(const std::vector<BatchJob>& jobs, float WAVENUMBER[], int SIZE,
+    std::vector<int>& firstIndex, std::vector<int>& lastIndex)
+{
+    firstIndex.clear();
+    lastIndex.clear();
+    for(size_t j = 0; j < jobs.size(); j++)
+    {
+        const BatchJob& job = jobs[j];
+        if(!job.upperBoundSpecified && !job.lowerBoundSpecified) return false;
+        firstIndex.push_back( job.upperBoundSpecified ? wavenumToIndex(job.upperBound, WAVENUMBER, SIZE) : 0 );
+        lastIndex.push_back( job.lowerBoundSpecified ? wavenumToIndex(job.lowerBound, WAVENUMBER, SIZE) : SIZE - 1 );
+        if(job.useConstCorr)
+        {
+            firstIndex.push_back(wavenumToIndex(job.ubCorr, WAVENUMBER, SIZE));
+            lastIndex.push_back(wavenumToIndex(job.lbCorr, WAVENUMBER, SIZE));
+        }
+    }
+    return true;
+}
+
+void runBatchJobs(
+    const std::vector<BatchJob>& jobs,
+    char** SPA_FILENAME,
+    float** IR_DATA,
+    int NUM_SPA_FILES,
+    float WAVENUMBER[],
+    int SIZE,
+    int numThreads
+)
+{
+    const char* funcDef = "void runBatchJobs(const std::vector<BatchJob>&, char**, float**, int, float [], int, int)";
+    std::vector<CorrWindow> windows;
+    std::vector<SharedAggregate> aggregates;
+    planSharedData(jobs, windows, aggregates);
+
+    // Corrected spectra: the mean spectrum is the same for every window, the offsets are not
+    if(!windows.empty())
+    {
+        ReportStage reportStage("const-corr", "jobs");
+        reportStage.addFiles((long long)NUM_SPA_FILES * windows.size());
+        float* meanSpectrum = new (std::nothrow) float [SIZE];
+        checkIfNull(meanSpectrum, funcDef, "float* meanSpectrum");
+        checkStatus(computeMeanSpectrum(meanSpectrum, IR_DATA, NUM_SPA_FILES, SIZE), funcDef, "float* meanSpectrum");
+        for(size_t w = 0; w < windows.size(); w++)
+        {
+            windows[w].offsets = new (std::nothrow) float [NUM_SPA_FILES];
+            checkIfNull(windows[w].offsets, funcDef, "float* windows[w].offsets");
+            windows[w].data = createFloatArray(NUM_SPA_FILES, SIZE, "float** windows[w].data");
+        }
+        // Each spectrum is corrected on its own, so the work is split by window and file
+        parallelFor((int)windows.size() * NUM_SPA_FILES, numThreads, [&](int item, int)
+        {
+            CorrWindow& window = windows[item / NUM_SPA_FILES];
+            const int file = item % NUM_SPA_FILES;
+            computeConstCorrOffsets(window.offsets + file, meanSpectrum, IR_DATA + file, 1, WAVENUMBER, SIZE,
+                window.ubCorr, window.lbCorr);
+            applyConstCorr(window.data + file, IR_DATA + file, window.offsets + file, 1, SIZE);
+        });
+        delete[] meanSpectrum;
+    }
+
+    // Aggregates, split by aggregate and group
+    if(!aggregates.empty())
+    {
+        ReportStage reportStage("aggregate", "jobs");
+        reportStage.addFiles((long long)NUM_SPA_FILES * aggregates.size());
+        std::vector<int> firstItem;
+        int numItems = 0;
+        for(size_t a = 0; a < aggregates.size(); a++)
+        {
+            const int numGroups = NUM_SPA_FILES / aggregates[a].groupSize;
+            aggregates[a].colTitles = createAvgDataColTitles(numGroups, aggregates[a].groupSize, SPA_FILENAME, "char** aggregates[a].colTitles");
+            aggregates[a].data = createFloatArray(numGroups, SIZE, "float** aggregates[a].data");
+            firstItem.push_back(numItems);
+            numItems += numGroups;
+        }
+        parallelFor(numItems, numThreads, [&](int item, int)
+        {
+            size_t a = 0;
+            while(a + 1 < aggregates.size() && firstItem[a + 1] <= item)
+                a++;
+            const SharedAggregate& aggregate = aggregates[a];
+            const int group = item - firstItem[a];
+            float** source = ( aggregate.window == -1 ? IR_DATA : windows[aggregate.window].data );
+            checkStatus(computeAggregate(aggregate.data + group, source + group * aggregate.groupSize, 1, aggregate.groupSize,
+                SIZE, aggregate.mode), funcDef, "float** aggregates[a].data");
+        });
+    }
+
+    // Every job's data sets, in the order a run with its options writes them
+    std::vector<JobOutput> outputs;
+    for(size_t j = 0; j < jobs.size(); j++)
+    {
+        const BatchJob& job = jobs[j];
+        const std::string aggPrefix = aggregatePrefix(job.aggregateMode);
+        const int window = ( job.useConstCorr ? findCorrWindow(windows, job.ubCorr, job.lbCorr) : -1 );
+        JobOutput raw = {&job, job.name + ".combinedRawData", -1, -1};
+        outputs.push_back(raw);
+        if(job.groupFiles)
+        {
+            JobOutput aggregated = {&job, job.name + "." + aggPrefix + "Data", -1,
+                findAggregate(aggregates, -1, job.groupSize, job.aggregateMode)};
+            outputs.push_back(aggregated);
+        }
+        if(job.useConstCorr)
+        {
+            JobOutput corrected = {&job, job.name + ".constCorrData", window, -1};
+            outputs.push_back(corrected);
+        }
+        if(job.useConstCorr && job.groupFiles)
+        {
+            JobOutput aggregated = {&job, job.name + "." + aggPrefix + "CorrData", window,
+                findAggregate(aggregates, window, job.groupSize, job.aggregateMode)};
+            outputs.push_back(aggregated);
+        }
+    }
+    // Whole files in parallel; each is formatted by the threads set with setCSVOutputStages()
+    parallelFor((int)outputs.size(), numThreads, [&](int o, int)
+    {
+        const JobOutput& output = outputs[o];
+        const BatchJob& job = *output.job;
+        char** colTitles = SPA_FILENAME;
+        float** data = ( output.window == -1 ? IR_DATA : windows[output.window].data );
+        int numCols = NUM_SPA_FILES;
+        if(output.aggregate != -1)
+        {
+            colTitles = aggregates[output.aggregate].colTitles;
+            data = aggregates[output.aggregate].data;
+            numCols = NUM_SPA_FILES / aggregates[output.aggregate].groupSize;
+        }
+        printDataSet(output.prefix, colTitles, data, numCols, WAVENUMBER, job.upperBoundSpecified, job.lowerBoundSpecified,
+            job.upperBound, job.lowerBound, job.ubStr, job.lbStr);
+    });
+
+    for(size_t w = 0; w < windows.size(); w++)
+    {
+        delete[] windows[w].offsets;
+        freeFloatArray(windows[w].data, NUM_SPA_FILES);
+    }
+    for(size_t a = 0; a < aggregates.size(); a++)
+    {
+        delete[] aggregates[a].colTitles;
+        freeFloatArray(aggregates[a].data, NUM_SPA_FILES / aggregates[a].groupSize);
+    }
+    return;
+}
@@ -0,0 +1,57 @@
+#ifndef BATCH_JOBS_H
+#define BATCH_JOBS_H
+
+#include "data-processing.h"
+
+#include <string>
+#include <vector>
+
+// One line of a --jobs-file: the data sets a run with these options would save, each file
+// name starting with the job's name and a '.'
+struct BatchJob
+{
+    std::string name;
+    bool upperBoundSpecified;
+    bool lowerBoundSpecified;
+    int upperBound;
+    int lowerBound;
+    std::string ubStr;
+    std::string lbStr;
+    bool useConstCorr;
+    int ubCorr;
+    int lbCorr;
+    bool groupFiles;
+    int groupSize;
+    AggregateMode aggregateMode;
+};
+
+// Read the jobs in path, one per line: a name followed by any of -u/--upper-bound,
+// -l/--lower-bound, --calculate-const-corr, --group-files and --aggregate, written as on the
+// command line. Blank lines and lines starting with '#' are skipped. Group sizes must divide
+// NUM_SPA_FILES. Exits on errors.
+void readJobsFile(const char* path, int NUM_SPA_FILES, std::vector<BatchJob>& jobs);
+
+// Spectra runBatchJobs() keeps besides IR_DATA: one matrix per distinct correction window and
+// one per distinct aggregate
+long long batchJobSpectra(const std::vector<BatchJob>& jobs, int NUM_SPA_FILES);
+
+// Index ranges any job saves or corrects over, for setSpectrumReadRanges(); false if some job
+// saves whole spectra
+bool batchJobReadRanges(const std::vector<BatchJob>& jobs, float WAVENUMBER[], int SIZE,
+    std::vector<int>& firstIndex, std::vector<int>& lastIndex);
+
+// Run every job on the spectra already in IR_DATA, which are only read. Whatever several jobs
+// need is computed once: the mean spectrum for all correction windows, the offsets and
+// corrected spectra for each window, and each aggregate. The steps and then the CSV files are
+// spread over numThreads threads.
+void runBatchJobs(
+    const std::vector<BatchJob>& jobs,
+    char** SPA_FILENAME,
+    float** IR_DATA,
+    int NUM_SPA_FILES,
+    float WAVENUMBER[],
+    int SIZE,
+    int numThreads
+);
+
+#endif // BATCH_JOBS_H
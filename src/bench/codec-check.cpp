@@ -0,0 +1,97 @@
+// Round-trips every SPA file under the given directories through the spectrum codec (make
+// codec-check): each spectrum is encoded, decoded by both the vectorized and the scalar
+// decoder, and compared bit for bit with the original. Also checks that a stream cut short is
+// rejected, and prints the compression ratio and the decoders' throughput.
+//
+// USAGE: codec-check DIRECTORY...
+// Exits with status 1 if any spectrum does not come back exactly.
+
+#include "../input-files.h"
+#include "../spa.h"
+#include "../spectrum-codec.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Decoded gigabytes per second of decode() over every encoded spectrum, repeated for about a second
+template <typename Decode>
+static double decodeRate(const std::vector<std::vector<unsigned char> >& encoded, float values[], Decode decode)
+{
+    const int SIZE = spa::NUM_POINTS;
+    long long bytes = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double seconds = 0;
+    while(seconds < 1)
+    {
+        for(size_t i = 0; i < encoded.size(); i++)
+            decode(&encoded[i][0], encoded[i].size(), values, SIZE);
+        bytes += (long long)encoded.size() * SIZE * sizeof(float);
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return bytes / seconds / 1e9;
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        std::cerr << "USAGE: " << argv[0] << " DIRECTORY...\n";
+        return 1;
+    }
+    std::vector<std::string> paths;
+    for(int a = 1; a < argc; a++)
+        findSPAFiles(argv[a], nullptr, 1, paths);
+    if(paths.empty())
+    {
+        std::cerr << "Error: main(): no SPA files found.\n";
+        return 1;
+    }
+
+    const int SIZE = spa::NUM_POINTS;
+    std::vector<float> original(SIZE);
+    std::vector<float> simd(SIZE);
+    std::vector<float> scalar(SIZE);
+    std::vector<std::vector<unsigned char> > encoded(paths.size());
+    long long encodedBytes = 0;
+    int numFailed = 0;
+    for(size_t i = 0; i < paths.size(); i++)
+    {
+        spa::Status status = spa::readSpectrumData(paths[i].c_str(), &original[0]);
+        if(status != spa::OK)
+        {
+            std::cerr << "Error: main(): SPA file '" << paths[i] << "': " << spa::statusMessage(status) << ".\n";
+            return 1;
+        }
+        encodeSpectrum(&original[0], SIZE, encoded[i]);
+        encodedBytes += (long long)encoded[i].size();
+        bool simdOK = decodeSpectrum(&encoded[i][0], encoded[i].size(), &simd[0], SIZE)
+            && std::memcmp(&simd[0], &original[0], SIZE * sizeof(float)) == 0;
+        bool scalarOK = decodeSpectrumScalar(&encoded[i][0], encoded[i].size(), &scalar[0], SIZE)
+            && std::memcmp(&scalar[0], &original[0], SIZE * sizeof(float)) == 0;
+        bool truncatedRejected = !decodeSpectrum(&encoded[i][0], encoded[i].size() - 1, &simd[0], SIZE);
+        if(!simdOK || !scalarOK || !truncatedRejected)
+        {
+            std::cout << "FAILED " << paths[i] << ( simdOK ? "" : " (vectorized decoder)" )
+                << ( scalarOK ? "" : " (scalar decoder)" ) << ( truncatedRejected ? "" : " (truncated stream accepted)" ) << "\n";
+            numFailed++;
+        }
+    }
+
+    const double rawBytes = (double)paths.size() * SIZE * sizeof(float);
+    std::cout << paths.size() << " spectra, " << (long long)rawBytes << " bytes of floats encoded to " << encodedBytes
+        << " bytes (" << 100 * encodedBytes / rawBytes << "%, ratio " << rawBytes / encodedBytes << ").\n";
+    std::cout << "Decoding: " << decodeRate(encoded, &simd[0], decodeSpectrumScalar) << " GB/s scalar";
+    if(spectrumCodecUsesSimd())
+        std::cout << ", " << decodeRate(encoded, &simd[0], decodeSpectrum) << " GB/s vectorized (AVX2)";
+    std::cout << ".\n";
+    if(numFailed > 0)
+    {
+        std::cout << numFailed << " of " << paths.size() << " spectra did not round-trip.\n";
+        return 1;
+    }
+    std::cout << "Every spectrum round-tripped exactly.\n";
+    return 0;
+}
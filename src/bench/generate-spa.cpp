@@ -0,0 +1,119 @@
+// Writes synthetic SPA files for the benchmarks: the same size and layout as OMNIC's (a text
+// header, NUM_POINTS little-endian floats at DATA_START, a zeroed trailer), with % transmission
+// spectra of a few absorption bands that deepen from file to file like a kinetics series, plus
+// noise. The same seed always gives the same bytes.
+//
+// USAGE: generate-spa DIRECTORY COUNT [SEED]
+//     Writes DIRECTORY/synthetic-00001.SPA to DIRECTORY/synthetic-<COUNT>.SPA. Files that
+//     already exist with the right size are left alone, so a larger set extends a smaller one.
+
+#include "../spa.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+const size_t SPA_FILE_BYTES = 765916; // as written by OMNIC for these spectra
+
+// Absorption bands: centre (inverse cm), width, depth approached by late files
+struct Band
+{
+    double centre;
+    double width;
+    double depth;
+};
+
+const Band BANDS[] = {
+    {2920.0, 25.0, 30.0},
+    {1775.0, 12.0, 45.0},   // grows fastest, as a carbonyl would during curing
+    {1460.0, 15.0, 20.0},
+    {1100.0, 40.0, 35.0}
+};
+
+// splitmix64: small, fast and identical on every platform
+static uint64_t nextRandom(uint64_t& state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static void fillSpectrum(float values[], int file, uint64_t seed)
+{
+    spa::Span<const float> wavenumbers = spa::wavenumberAxis();
+    uint64_t state = seed * 1000003ULL + (uint64_t)file;
+    const double progress = file / (file + 1000.0); // depends on nothing else, so sets can grow
+    const double offset = ((nextRandom(state) >> 11) * (1.0 / 9007199254740992.0) - 0.5) * 4.0; // drift between files
+    for(int i = 0; i < spa::NUM_POINTS; i++)
+    {
+        double wavenumber = wavenumbers[i];
+        double transmission = 92.0 + offset + 3.0 * std::sin(wavenumber / 700.0);
+        for(size_t b = 0; b < sizeof(BANDS) / sizeof(BANDS[0]); b++)
+        {
+            double distance = (wavenumber - BANDS[b].centre) / BANDS[b].width;
+            transmission -= BANDS[b].depth * (0.3 + 0.7 * progress) * std::exp(-0.5 * distance * distance);
+        }
+        double noise = ((nextRandom(state) >> 11) * (1.0 / 9007199254740992.0) - 0.5) * 0.2;
+        values[i] = (float)(transmission + noise);
+    }
+    return;
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 3 || argc > 4)
+    {
+        std::cerr << "USAGE: " << argv[0] << " DIRECTORY COUNT [SEED]\n";
+        return 1;
+    }
+    const std::string directory = argv[1];
+    const int count = std::atoi(argv[2]);
+    const uint64_t seed = ( argc == 4 ? std::strtoull(argv[3], nullptr, 10) : 1 );
+    if(count < 1)
+    {
+        std::cerr << "Error: main(): COUNT must be at least 1.\n";
+        return 1;
+    }
+    if(mkdir(directory.c_str(), 0777) != 0 && errno != EEXIST)
+    {
+        std::cerr << "Error: main(): unable to create directory '" << directory << "': " << std::strerror(errno) << ".\n";
+        return 1;
+    }
+
+    std::vector<char> bytes(SPA_FILE_BYTES, 0);
+    const char heading[] = "Spectral Data File\r\n";
+    std::memcpy(&bytes[0], heading, sizeof(heading) - 1);
+    std::vector<float> values(spa::NUM_POINTS);
+    int written = 0;
+    for(int file = 1; file <= count; file++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "synthetic-%05d.SPA", file);
+        std::string path = directory + "/" + name;
+        struct stat info;
+        if(stat(path.c_str(), &info) == 0 && (size_t)info.st_size == SPA_FILE_BYTES) continue;
+
+        std::memset(&bytes[0x1E], 0, 32); // title, as OMNIC stores it
+        std::memcpy(&bytes[0x1E], name, std::strlen(name) - 4);
+        fillSpectrum(&values[0], file, seed);
+        std::memcpy(&bytes[spa::DATA_START], &values[0], spa::NUM_POINTS * sizeof(float)); // little-endian hosts
+        FILE* output = std::fopen(path.c_str(), "wb");
+        if(output == nullptr || std::fwrite(&bytes[0], 1, bytes.size(), output) != bytes.size() || std::fclose(output) != 0)
+        {
+            std::cerr << "Error: main(): unable to write '" << path << "'.\n";
+            return 1;
+        }
+        written++;
+    }
+    std::cerr << "generate-spa: " << count << " files in '" << directory << "' (" << written << " written).\n";
+    return 0;
+}
@@ -0,0 +1,197 @@
+// Compares spa-bench results with a baseline (make perf-check): prints a table of every
+// benchmark's throughput against the baseline's, and fails when a benchmark in the baseline
+// got slower by more than the threshold. A slowdown only counts when it is beyond noise: the
+// new run's 95% interval (spa-bench --repeat) must lie below the baseline median too.
+// Benchmarks missing from the new results fail as well, so renaming one cannot hide it.
+//
+// USAGE: perf-check BASELINE RESULTS [--threshold=PERCENT]
+//     BASELINE, RESULTS  JSON written by spa-bench (make perf-baseline writes the baseline)
+//     --threshold        allowed slowdown in percent (default 10)
+// Exits with status 1 if anything regressed.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Metric
+{
+    std::string name;
+    std::string cache;
+    std::string itemName;
+    double itemsPerSecond;  // median over the runs
+    double ciLow;           // NAN without an interval (a single run)
+    double ciHigh;
+};
+
+// The results are flat objects, so each is the text between a pair of braces
+static bool findField(const std::string& object, const char* key, size_t* valueStart)
+{
+    std::string quotedKey = std::string("\"") + key + "\"";
+    size_t at = object.find(quotedKey);
+    if(at == std::string::npos) return false;
+    at = object.find_first_not_of(" \t\r\n", at + quotedKey.size());
+    if(at == std::string::npos || object[at] != ':') return false;
+    at = object.find_first_not_of(" \t\r\n", at + 1);
+    if(at == std::string::npos) return false;
+    *valueStart = at;
+    return true;
+}
+
+static std::string stringField(const std::string& object, const char* key)
+{
+    size_t at;
+    std::string value;
+    if(!findField(object, key, &at) || object[at] != '"') return value;
+    for(at++; at < object.size() && object[at] != '"'; at++)
+    {
+        if(object[at] == '\\' && at + 1 < object.size()) at++;
+        value += object[at];
+    }
+    return value;
+}
+
+static double numberField(const std::string& object, const char* key)
+{
+    size_t at;
+    if(!findField(object, key, &at)) return NAN;
+    char* end;
+    double value = std::strtod(object.c_str() + at, &end);
+    return ( end == object.c_str() + at ? NAN : value );
+}
+
+static std::vector<Metric> readResults(const char* path)
+{
+    const char* funcDef = "std::vector<Metric> readResults(const char*)";
+    std::ifstream input (path);
+    if(!input.is_open())
+    {
+        std::cerr << "Error: " << funcDef << ": unable to open '" << path << "'.\n";
+        std::exit(1);
+    }
+    std::stringstream contents;
+    contents << input.rdbuf();
+    const std::string text = contents.str();
+    size_t at = text.find("\"results\"");
+    if(at == std::string::npos)
+    {
+        std::cerr << "Error: " << funcDef << ": '" << path << "' is not spa-bench output (no \"results\").\n";
+        std::exit(1);
+    }
+    std::vector<Metric> metrics;
+    for(at = text.find('{', at); at != std::string::npos; at = text.find('{', at))
+    {
+        size_t end = text.find('}', at);
+        if(end == std::string::npos) break;
+        const std::string object = text.substr(at, end - at + 1);
+        Metric metric = {stringField(object, "name"), stringField(object, "cache"), stringField(object, "item"),
+            numberField(object, "items_per_s"), numberField(object, "ci_low"), numberField(object, "ci_high")};
+        if(metric.name.empty() || !(metric.itemsPerSecond > 0))
+        {
+            std::cerr << "Error: " << funcDef << ": '" << path << "' has a result without a name or items_per_s.\n";
+            std::exit(1);
+        }
+        metrics.push_back(metric);
+        at = end + 1;
+    }
+    return metrics;
+}
+
+static std::string label(const Metric& metric)
+{
+    return ( metric.cache.empty() ? metric.name : metric.name + " (" + metric.cache + ")" );
+}
+
+static const Metric* findMetric(const std::vector<Metric>& metrics, const Metric& wanted)
+{
+    for(size_t m = 0; m < metrics.size(); m++)
+        if(metrics[m].name == wanted.name && metrics[m].cache == wanted.cache) return &metrics[m];
+    return nullptr;
+}
+
+static std::string formatRate(double value)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%.4g", value);
+    return text;
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 3 || argc > 4)
+    {
+        std::cerr << "USAGE: " << argv[0] << " BASELINE RESULTS [--threshold=PERCENT]\n";
+        return 1;
+    }
+    double threshold = 10;
+    if(argc == 4)
+    {
+        std::string arg = argv[3];
+        if(arg.compare(0, 12, "--threshold=") != 0 || !(std::strtod(arg.c_str() + 12, nullptr) > 0))
+        {
+            std::cerr << "Error: main(): expected --threshold=PERCENT, got '" << arg << "'.\n";
+            return 1;
+        }
+        threshold = std::strtod(arg.c_str() + 12, nullptr);
+    }
+    std::vector<Metric> baseline = readResults(argv[1]);
+    std::vector<Metric> current = readResults(argv[2]);
+
+    std::cout << std::left << std::setw(34) << "Benchmark" << std::right << std::setw(12) << "baseline"
+        << std::setw(12) << "current" << std::setw(10) << "change" << std::setw(26) << "current 95% interval"
+        << "  unit          status\n";
+    int numRegressed = 0;
+    for(size_t b = 0; b < baseline.size(); b++)
+    {
+        const Metric& before = baseline[b];
+        const Metric* after = findMetric(current, before);
+        std::cout << std::left << std::setw(34) << label(before) << std::right << std::setw(12) << formatRate(before.itemsPerSecond);
+        if(after == nullptr)
+        {
+            std::cout << std::setw(12) << "-" << std::setw(10) << "" << std::setw(26) << "" << "  "
+                << std::left << std::setw(14) << (before.itemName + "/s") << "MISSING\n" << std::right;
+            numRegressed++;
+            continue;
+        }
+        const double change = (after->itemsPerSecond / before.itemsPerSecond - 1) * 100;
+        char changeText[16];
+        snprintf(changeText, sizeof(changeText), "%+.1f%%", change);
+        std::string interval = ( std::isnan(after->ciLow) ? "-" : formatRate(after->ciLow) + " - " + formatRate(after->ciHigh) );
+        const char* status = "ok";
+        if(change < -threshold)
+        { // Slower than allowed; a regression unless the new runs reach the old median
+            if(std::isnan(after->ciHigh) || after->ciHigh < before.itemsPerSecond)
+            {
+                status = "REGRESSED";
+                numRegressed++;
+            }
+            else
+                status = "slower (within noise)";
+        }
+        else if(change > threshold)
+            status = "faster";
+        std::cout << std::setw(12) << formatRate(after->itemsPerSecond) << std::setw(10) << changeText
+            << std::setw(26) << interval << "  " << std::left << std::setw(14) << (before.itemName + "/s") << status
+            << "\n" << std::right;
+    }
+    for(size_t c = 0; c < current.size(); c++)
+        if(findMetric(baseline, current[c]) == nullptr)
+            std::cout << std::left << std::setw(34) << label(current[c]) << std::right << std::setw(12) << "-"
+                << std::setw(12) << formatRate(current[c].itemsPerSecond) << std::setw(10) << "" << std::setw(26) << ""
+                << "  " << std::left << std::setw(14) << (current[c].itemName + "/s") << "new (not in baseline)\n" << std::right;
+
+    if(numRegressed > 0)
+    {
+        std::cout << "\n" << numRegressed << " benchmark(s) regressed by more than " << threshold << "% or are missing.\n"
+            << "If the slowdown is intended, update the baseline with make perf-baseline.\n";
+        return 1;
+    }
+    std::cout << "\nNo benchmark regressed by more than " << threshold << "%.\n";
+    return 0;
+}
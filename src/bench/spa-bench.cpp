@@ -0,0 +1,593 @@
+// Benchmarks for spa-reader (make bench): micro-benchmarks of the functions every run spends its
+// time in, and end-to-end runs of spa-reader itself, on synthetic files from generate-spa.
+// Results are printed as a table and written as JSON; "cold" variants drop the SPA files from
+// the page cache first (posix_fadvise), so they are read from the disk again. With --repeat,
+// the suite runs several times and each result is the median, with a 95% confidence interval.
+//
+// USAGE: spa-bench --data=DIR [--reader=PATH] [--sizes=N,N,...] [--min-time=SECONDS]
+//                  [--micro-files=N] [--out=DIR] [--json=FILE] [--only=NAME] [--repeat=N]
+//                  [--no-cold]
+//     --data         directory of synthetic-NNNNN.SPA files (generate-spa)
+//     --reader       spa-reader to run end to end (default ./spa-reader)
+//     --sizes        numbers of files for the end-to-end runs (default 10,1000,10000)
+//     --min-time     keep repeating each benchmark for at least this long (default 0.5)
+//     --micro-files  spectra held in memory by the micro-benchmarks (default 256)
+//     --out          where output files are written and deleted (default DIR/../out)
+//     --json         results file (default: standard output)
+//     --only         run only the benchmarks whose names start with NAME
+//     --repeat       run the suite N times and report medians (default 1)
+//     --no-cold      skip the cold-cache variants, which are slow and noisy
+
+#include "../baseline-correction.h"
+#include "../data-processing.h"
+#include "../parallel.h"
+#include "../pipeline.h"
+#include "../read-write.h"
+#include "../spa.h"
+#include "../spectrum-codec.h"
+#include "../str-to-int.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const int SIZE = spa::NUM_POINTS;
+
+// One benchmark's measurements; an item is whatever the benchmark counts (spectra, rows, lookups)
+struct BenchResult
+{
+    std::string name;
+    std::string cache;      // "warm", "cold" or "" where the page cache does not matter
+    std::string itemName;
+    long long iterations;
+    double seconds;         // timed seconds over all iterations
+    double items;           // items over all iterations
+    double bytes;           // bytes read or written over all iterations, 0 if not meaningful
+};
+
+// A result over every run of the suite: the throughput of each run, and their sums
+struct BenchSummary
+{
+    BenchResult total;
+    std::vector<double> itemsPerSecond;
+};
+
+static std::vector<BenchResult> results;    // of the current run of the suite
+static double minSeconds = 0.5;
+static std::string onlyPrefix;
+static bool skipCold = false;
+
+static bool selected(const std::string& name)
+{
+    return name.compare(0, onlyPrefix.size(), onlyPrefix) == 0;
+}
+
+// Call op(iteration) until it has been timed for minSeconds (at least once, at most
+// maxIterations). op returns the nanoseconds to count, so untimed preparation (dropping files
+// from the cache) can happen inside it.
+static void runBenchmark(
+    const std::string& name,
+    const std::string& cache,
+    const std::string& itemName,
+    double itemsPerOp,
+    double bytesPerOp,
+    const std::function<long long(long long)>& op,
+    long long maxIterations = LLONG_MAX
+)
+{
+    if(!selected(name) || (skipCold && cache == "cold")) return;
+    BenchResult result = {name, cache, itemName, 0, 0, 0, 0};
+    long long nanos = 0;
+    while(result.iterations < maxIterations && (result.iterations == 0 || nanos < minSeconds * 1e9))
+    {
+        nanos += op(result.iterations);
+        result.iterations++;
+    }
+    result.seconds = nanos * 1e-9;
+    result.items = itemsPerOp * result.iterations;
+    result.bytes = bytesPerOp * result.iterations;
+    results.push_back(result);
+    std::cerr << std::left << std::setw(34) << (cache.empty() ? name : name + " (" + cache + ")") << std::right
+        << std::setw(14) << std::setprecision(4) << result.items / result.seconds << " " << itemName << "/s"
+        << std::setw(14) << std::setprecision(4) << result.seconds * 1e9 / result.items << " ns/" << itemName;
+    if(result.bytes > 0) std::cerr << std::setw(12) << std::setprecision(4) << result.bytes / result.seconds / 1e6 << " MB/s";
+    std::cerr << "\n";
+    return;
+}
+
+static double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return ( n % 2 == 1 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]) );
+}
+
+// Distribution-free 95% confidence interval of the median: the k-th smallest and k-th largest
+// values, for the largest k that leaves at most 2.5% on each side (binomial(n, 1/2) tails).
+// Too few values for 95% (fewer than 6) give the smallest and largest.
+static void medianInterval(std::vector<double> values, double* low, double* high)
+{
+    std::sort(values.begin(), values.end());
+    const int n = (int)values.size();
+    double tail = 0;            // P(fewer than k values below the median)
+    double term = std::pow(0.5, n); // P(exactly k below), starting at k = 0
+    int k = 0;
+    while(k + 1 <= n / 2 && tail + term <= 0.025)
+    {
+        tail += term;
+        term *= (double)(n - k) / (k + 1);
+        k++;
+    }
+    if(k == 0) k = 1;
+    *low = values[k - 1];
+    *high = values[n - k];
+    return;
+}
+
+// Combine the runs of the suite, matching results by position (every run runs the same ones)
+static std::vector<BenchSummary> summarize(const std::vector<std::vector<BenchResult> >& runs)
+{
+    std::vector<BenchSummary> summaries;
+    for(size_t r = 0; r < runs[0].size(); r++)
+    {
+        BenchSummary summary;
+        summary.total = runs[0][r];
+        summary.total.iterations = 0;
+        summary.total.seconds = summary.total.items = summary.total.bytes = 0;
+        for(size_t run = 0; run < runs.size(); run++)
+        {
+            const BenchResult& result = runs[run][r];
+            summary.total.iterations += result.iterations;
+            summary.total.seconds += result.seconds;
+            summary.total.items += result.items;
+            summary.total.bytes += result.bytes;
+            summary.itemsPerSecond.push_back(result.items / result.seconds);
+        }
+        summaries.push_back(summary);
+    }
+    return summaries;
+}
+
+static void printSummaries(const std::vector<BenchSummary>& summaries)
+{
+    std::cerr << "\nMedian of " << summaries[0].itemsPerSecond.size() << " runs      throughput                   95% interval\n";
+    for(size_t s = 0; s < summaries.size(); s++)
+    {
+        const BenchResult& total = summaries[s].total;
+        double low, high;
+        medianInterval(summaries[s].itemsPerSecond, &low, &high);
+        std::cerr << std::left << std::setw(34) << (total.cache.empty() ? total.name : total.name + " (" + total.cache + ")")
+            << std::right << std::setw(14) << std::setprecision(4) << median(summaries[s].itemsPerSecond) << " "
+            << total.itemName << "/s" << std::setw(12) << low << " - " << high << "\n";
+    }
+    return;
+}
+
+// Time a single call
+static long long timed(const std::function<void()>& body)
+{
+    long long begin = nowNanos();
+    body();
+    return nowNanos() - begin;
+}
+
+// Ask the kernel to forget the cached pages of path, so the next read goes to the disk
+static void dropFromPageCache(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) return;
+    fdatasync(fd); // only clean pages can be dropped
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+    return;
+}
+
+static void dropAllFromPageCache(const std::vector<std::string>& paths, int count)
+{
+    for(int i = 0; i < count; i++)
+        dropFromPageCache(paths[i]);
+    return;
+}
+
+// Read every file once so the warm variants start warm
+static void warmPageCache(const std::vector<std::string>& paths, int count, float buffer[])
+{
+    for(int i = 0; i < count; i++)
+        spa::readSpectrumData(paths[i].c_str(), buffer);
+    return;
+}
+
+static std::vector<std::string> listSyntheticFiles(const std::string& directory)
+{
+    std::vector<std::string> names;
+    DIR* dir = opendir(directory.c_str());
+    if(dir == nullptr)
+    {
+        std::cerr << "Error: listSyntheticFiles(): unable to open '" << directory << "'; run generate-spa first.\n";
+        std::exit(1);
+    }
+    for(dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+        if(std::strncmp(entry->d_name, "synthetic-", 10) == 0) names.push_back(entry->d_name);
+    closedir(dir);
+    std::sort(names.begin(), names.end()); // zero-padded, so this is file order
+    for(size_t i = 0; i < names.size(); i++)
+        names[i] = directory + "/" + names[i];
+    return names;
+}
+
+static void benchWavenumToIndex(float WAVENUMBER[])
+{
+    // The bounds users give: whole wavenumbers across the spectrum, in no particular order
+    const int NUM_LOOKUPS = 1024;
+    std::vector<int> wavenumbers(NUM_LOOKUPS);
+    unsigned state = 12345;
+    for(int i = 0; i < NUM_LOOKUPS; i++)
+    {
+        state = state * 1103515245u + 12345u;
+        wavenumbers[i] = 651 + (int)((state >> 8) % 3348);
+    }
+    volatile long long sink = 0;
+    runBenchmark("wavenumToIndex", "", "lookup", NUM_LOOKUPS, 0, [&](long long)
+    {
+        return timed([&]()
+        {
+            long long sum = 0;
+            for(int i = 0; i < NUM_LOOKUPS; i++)
+                sum += wavenumToIndex(wavenumbers[i], WAVENUMBER, SIZE);
+            sink = sink + sum;
+        });
+    });
+    return;
+}
+
+static void benchReadSPAFile(std::vector<std::string>& paths, int numFiles)
+{
+    std::vector<float> spectrum(SIZE);
+    const double bytes = (double)SIZE * sizeof(float);
+    warmPageCache(paths, numFiles, &spectrum[0]);
+    runBenchmark("readSPAFile", "warm", "spectrum", 1, bytes, [&](long long i)
+    {
+        return timed([&]() { readSPAFile(&paths[i % numFiles][0], &spectrum[0]); });
+    });
+    runBenchmark("readSPAFile", "cold", "spectrum", 1, bytes, [&](long long i)
+    {
+        dropFromPageCache(paths[i % numFiles]);
+        return timed([&]() { readSPAFile(&paths[i % numFiles][0], &spectrum[0]); });
+    });
+    return;
+}
+
+static void benchKernels(float** IR_DATA, int numSpectra, float WAVENUMBER[])
+{
+    const char* funcDef = "static void benchKernels(float**, int, float [])";
+    const int GROUP_SIZE = 4;
+    const int numGroups = numSpectra / GROUP_SIZE;
+    float** AVG_DATA = createFloatArray(numGroups, SIZE, "float** AVG_DATA");
+    runBenchmark("computeAverages", "", "spectrum", numGroups * GROUP_SIZE, 0, [&](long long)
+    {
+        return timed([&]() { checkStatus(computeAverages(AVG_DATA, IR_DATA, numGroups, GROUP_SIZE, SIZE), funcDef, "computeAverages"); });
+    });
+    runBenchmark("computeMedians", "", "spectrum", numGroups * GROUP_SIZE, 0, [&](long long)
+    {
+        return timed([&]() { checkStatus(computeMedians(AVG_DATA, IR_DATA, numGroups, GROUP_SIZE, SIZE), funcDef, "computeMedians"); });
+    });
+    freeFloatArray(AVG_DATA, numGroups);
+
+    float** CORR_DATA = createFloatArray(numSpectra, SIZE, "float** CORR_DATA");
+    runBenchmark("computeConstCorr", "", "spectrum", numSpectra, 0, [&](long long)
+    {
+        return timed([&]() { checkStatus(computeConstCorr(CORR_DATA, IR_DATA, numSpectra, WAVENUMBER, SIZE, 1800, 1780), funcDef, "computeConstCorr"); });
+    });
+    freeFloatArray(CORR_DATA, numSpectra);
+
+    // The ALS baseline is by far the most expensive transform per spectrum
+    AlsWorkspace* workspace = createAlsWorkspace(SIZE);
+    checkIfNull(workspace, funcDef, "AlsWorkspace* workspace");
+    std::vector<float> spectrum(SIZE);
+    runBenchmark("subtractAlsBaseline", "", "spectrum", 1, 0, [&](long long i)
+    {
+        std::copy(IR_DATA[i % numSpectra], IR_DATA[i % numSpectra] + SIZE, spectrum.begin());
+        return timed([&]() { subtractAlsBaseline(&spectrum[0], workspace, 1e6, 0.01, 10); });
+    });
+    deleteAlsWorkspace(workspace);
+    return;
+}
+
+// Decoding the conversion cache's and .spz files' compressed spectra; bytes are decoded floats
+static void benchSpectrumCodec(float** IR_DATA, int numSpectra)
+{
+    std::vector<std::vector<unsigned char> > encoded(numSpectra);
+    for(int i = 0; i < numSpectra; i++)
+        encodeSpectrum(IR_DATA[i], SIZE, encoded[i]);
+    std::vector<float> spectrum(SIZE);
+    runBenchmark("decodeSpectrum", "", "spectrum", 1, SIZE * sizeof(float), [&](long long i)
+    {
+        const std::vector<unsigned char>& bytes = encoded[i % numSpectra];
+        return timed([&]() { decodeSpectrum(&bytes[0], bytes.size(), &spectrum[0], SIZE); });
+    });
+    return;
+}
+
+static void benchPrintToCSV(float** IR_DATA, char** titles, int numSpectra, float WAVENUMBER[], const std::string& outDirectory)
+{
+    // A full spectrum of numCols columns, the rows formatted by one thread as spa-reader does by default
+    const int numCols = std::min(numSpectra, 64);
+    const std::string path = outDirectory + "/bench.CSV";
+    double bytesPerOp = 0;
+    runBenchmark("printToCSV", "", "row", SIZE, 0, [&](long long)
+    {
+        long long nanos = timed([&]() { printToCSV(path.c_str(), titles, IR_DATA, WAVENUMBER, numCols, SIZE); });
+        struct stat info;
+        if(bytesPerOp == 0 && stat(path.c_str(), &info) == 0) bytesPerOp = (double)info.st_size;
+        std::remove(path.c_str());
+        return nanos;
+    });
+    if(!results.empty() && results.back().name == "printToCSV")
+        results.back().bytes = bytesPerOp * results.back().iterations;
+    return;
+}
+
+// The read stage alone: one reader thread (blocking reads), one per core, and io_uring
+static void benchIngestion(std::vector<std::string>& paths, int numFiles)
+{
+    float** IR_DATA = createFloatArray(numFiles, SIZE, "float** IR_DATA");
+    std::vector<char*> names(numFiles);
+    for(int i = 0; i < numFiles; i++)
+        names[i] = &paths[i][0];
+    const int threads = defaultThreadCount();
+    struct Backend
+    {
+        std::string name;
+        int readThreads;
+        int ioUringDepth;
+    };
+    const Backend backends[] = {
+        {"ingestSpectra/sync-1", 1, 0},
+        {"ingestSpectra/sync-" + std::to_string((long long)threads), threads, 0},
+        {"ingestSpectra/io_uring-64", 1, 64}
+    };
+    const double bytes = (double)numFiles * SIZE * sizeof(float);
+    for(size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++)
+    {
+        if(b == 1 && threads == 1) continue; // same as sync-1
+        const Backend& backend = backends[b];
+        for(int cold = 0; cold <= 1; cold++)
+        {
+            if(!cold) warmPageCache(paths, numFiles, IR_DATA[0]);
+            runBenchmark(backend.name, (cold ? "cold" : "warm"), "spectrum", numFiles, bytes, [&](long long)
+            {
+                if(cold) dropAllFromPageCache(paths, numFiles);
+                StageStats readStats("read", backend.readThreads);
+                StageStats transformStats("transform", 1);
+                return timed([&]()
+                {
+                    ingestSpectra(&names[0], IR_DATA, numFiles, backend.readThreads, backend.ioUringDepth, 1, 4,
+                        [](int, int) {}, &readStats, &transformStats);
+                });
+            }, 20);
+        }
+    }
+    freeFloatArray(IR_DATA, numFiles);
+    return;
+}
+
+// spa-reader as it is used: a window, the constant correction and pairs of files averaged
+static void benchEndToEnd(const std::vector<std::string>& paths, const std::vector<int>& sizes,
+    const std::string& reader, const std::string& outDirectory)
+{
+    for(size_t s = 0; s < sizes.size(); s++)
+    {
+        const int numFiles = sizes[s];
+        const std::string name = "end-to-end/" + std::to_string((long long)numFiles);
+        if(!selected(name)) continue;
+        if(numFiles > (int)paths.size())
+        {
+            std::cerr << "Skipping " << name << ": only " << paths.size() << " files were generated.\n";
+            continue;
+        }
+        const std::string manifest = outDirectory + "/manifest-" + std::to_string((long long)numFiles) + ".txt";
+        std::ofstream list (manifest.c_str());
+        for(int i = 0; i < numFiles; i++)
+            list << paths[i] << "\n";
+        list.close();
+        const std::string command = "cd '" + outDirectory + "' && '" + reader + "' -u=1850 -l=1750 "
+            + "--calculate-const-corr=1800-1780 --group-files=2 --manifest='" + manifest + "' > /dev/null";
+        auto run = [&]()
+        {
+            if(std::system(command.c_str()) != 0)
+            {
+                std::cerr << "Error: benchEndToEnd(): '" << command << "' failed.\n";
+                std::exit(1);
+            }
+        };
+        const double bytes = (double)numFiles * SIZE * sizeof(float);
+        const long long maxRuns = ( numFiles >= 1000 ? 3 : LLONG_MAX );
+        run(); // warms the page cache
+        runBenchmark(name, "warm", "spectrum", numFiles, bytes, [&](long long) { return timed(run); }, maxRuns);
+        runBenchmark(name, "cold", "spectrum", numFiles, bytes, [&](long long)
+        {
+            dropAllFromPageCache(paths, numFiles);
+            return timed(run);
+        }, maxRuns);
+        std::remove(manifest.c_str());
+    }
+    return;
+}
+
+static std::string jsonString(const std::string& text)
+{
+    std::string quoted = "\"";
+    for(size_t i = 0; i < text.size(); i++)
+    {
+        if(text[i] == '"' || text[i] == '\\') quoted += '\\';
+        quoted += text[i];
+    }
+    return quoted + "\"";
+}
+
+// Rates are medians over the runs; with more than one run, ci_low and ci_high bound items_per_s
+static void writeJSON(std::ostream& output, const std::vector<BenchSummary>& summaries, int microFiles)
+{
+    output << std::setprecision(6)
+        << "{\n  \"suite\": \"spa-reader-bench\",\n  \"version\": 1,\n"
+        << "  \"threads\": " << defaultThreadCount() << ",\n"
+        << "  \"min_time_s\": " << minSeconds << ",\n"
+        << "  \"micro_files\": " << microFiles << ",\n"
+        << "  \"results\": [\n";
+    for(size_t r = 0; r < summaries.size(); r++)
+    {
+        const BenchResult& total = summaries[r].total;
+        const size_t runs = summaries[r].itemsPerSecond.size();
+        const double itemsPerSecond = median(summaries[r].itemsPerSecond);
+        output << "    {\"name\": " << jsonString(total.name)
+            << ", \"cache\": " << jsonString(total.cache)
+            << ", \"item\": " << jsonString(total.itemName)
+            << ", \"runs\": " << runs
+            << ", \"iterations\": " << total.iterations
+            << ", \"seconds\": " << total.seconds
+            << ", \"items_per_s\": " << itemsPerSecond
+            << ", \"ns_per_item\": " << 1e9 / itemsPerSecond;
+        if(total.bytes > 0) output << ", \"mb_per_s\": " << itemsPerSecond * (total.bytes / total.items) / 1e6;
+        if(runs > 1)
+        {
+            double low, high;
+            medianInterval(summaries[r].itemsPerSecond, &low, &high);
+            output << ", \"ci_low\": " << low << ", \"ci_high\": " << high;
+        }
+        output << "}" << (r + 1 < summaries.size() ? "," : "") << "\n";
+    }
+    output << "  ]\n}\n";
+    return;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string dataDirectory;
+    std::string reader = "./spa-reader";
+    std::string outDirectory;
+    std::string jsonPath;
+    std::vector<int> sizes;
+    sizes.push_back(10);
+    sizes.push_back(1000);
+    sizes.push_back(10000);
+    int microFiles = 256;
+    int numRuns = 1;
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        std::string name = truncateStrAt(arg, '=');
+        if(name == "--data") dataDirectory = getStrAfter(arg, '=');
+        else if(name == "--reader") reader = getStrAfter(arg, '=');
+        else if(name == "--out") outDirectory = getStrAfter(arg, '=');
+        else if(name == "--json") jsonPath = getStrAfter(arg, '=');
+        else if(name == "--only") onlyPrefix = getStrAfter(arg, '=');
+        else if(name == "--min-time") minSeconds = strToDouble(getStrAfter(arg, '='));
+        else if(name == "--micro-files") microFiles = strToInt(getStrAfter(arg, '='));
+        else if(name == "--repeat") numRuns = strToInt(getStrAfter(arg, '='));
+        else if(name == "--no-cold") skipCold = true;
+        else if(name == "--sizes")
+        {
+            std::vector<std::string> pieces = splitStrAt(getStrAfter(arg, '='), ',');
+            sizes.clear();
+            for(size_t p = 0; p < pieces.size(); p++)
+                if(!pieces[p].empty()) sizes.push_back(strToInt(pieces[p]));
+        }
+        else
+        {
+            std::cerr << "Error: main(): unknown argument '" << arg << "'. See the top of bench/spa-bench.cpp.\n";
+            return 1;
+        }
+    }
+    if(dataDirectory.empty())
+    {
+        std::cerr << "Error: main(): --data=DIR is required (make bench generates it).\n";
+        return 1;
+    }
+    if(numRuns < 1)
+    {
+        std::cerr << "Error: main(): --repeat must be at least 1.\n";
+        return 1;
+    }
+    if(outDirectory.empty()) outDirectory = dataDirectory + "/../out";
+    mkdir(outDirectory.c_str(), 0777);
+    char resolved[PATH_MAX];
+    if(realpath(reader.c_str(), resolved) != nullptr) reader = resolved;
+    if(realpath(outDirectory.c_str(), resolved) != nullptr) outDirectory = resolved;
+
+    std::vector<std::string> paths = listSyntheticFiles(dataDirectory);
+    for(size_t i = 0; i < paths.size(); i++)
+        if(realpath(paths[i].c_str(), resolved) != nullptr) paths[i] = resolved;
+    microFiles = std::min(microFiles, (int)paths.size());
+    if(microFiles < 4)
+    {
+        std::cerr << "Error: main(): the micro-benchmarks need at least 4 files in '" << dataDirectory << "'.\n";
+        return 1;
+    }
+
+    float WAVENUMBER[SIZE]; // as main() computes it
+    const float STEP_SIZE = (spa::MAX_WAVENUMBER - spa::MIN_WAVENUMBER) / (SIZE - 1);
+    for(int i = 0; i < SIZE; i++)
+        WAVENUMBER[i] = spa::MAX_WAVENUMBER - (STEP_SIZE * i);
+
+    float** IR_DATA = createFloatArray(microFiles, SIZE, "float** IR_DATA");
+    for(int i = 0; i < microFiles; i++)
+        readSPAFile(&paths[i][0], IR_DATA[i]);
+    std::vector<char*> titles(microFiles);
+    for(int i = 0; i < microFiles; i++)
+        titles[i] = &paths[i][0];
+
+    std::vector<std::vector<BenchResult> > runs;
+    for(int run = 1; run <= numRuns; run++)
+    {
+        if(numRuns > 1) std::cerr << "\nRun " << run << " of " << numRuns << "\n";
+        std::cerr << "Benchmark                          throughput                 time per item\n";
+        results.clear();
+        benchWavenumToIndex(WAVENUMBER);
+        benchReadSPAFile(paths, microFiles);
+        benchKernels(IR_DATA, microFiles, WAVENUMBER);
+        benchSpectrumCodec(IR_DATA, microFiles);
+        benchPrintToCSV(IR_DATA, &titles[0], microFiles, WAVENUMBER, outDirectory);
+        benchIngestion(paths, std::min((int)paths.size(), 1000));
+        benchEndToEnd(paths, sizes, reader, outDirectory);
+        runs.push_back(results);
+    }
+    freeFloatArray(IR_DATA, microFiles);
+    if(runs[0].empty())
+    {
+        std::cerr << "Error: main(): no benchmark matches --only=" << onlyPrefix << ".\n";
+        return 1;
+    }
+    std::vector<BenchSummary> summaries = summarize(runs);
+    if(numRuns > 1) printSummaries(summaries);
+
+    if(jsonPath.empty())
+        writeJSON(std::cout, summaries, microFiles);
+    else
+    {
+        std::ofstream json (jsonPath.c_str());
+        writeJSON(json, summaries, microFiles);
+        if(!json)
+        {
+            std::cerr << "Error: main(): unable to write '" << jsonPath << "'.\n";
+            return 1;
+        }
+        std::cerr << "Results written to '" << jsonPath << "'.\n";
+    }
+    return 0;
+}
@@ -0,0 +1,314 @@
+#include "conversion-cache.h"
+#include "spectrum-codec.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+
+void setConversionCache(const char*, size_t)
+{
+    std::cerr << "Error: void setConversionCache(const char*, size_t): --cache-dir is not supported by this build.\n";
+    std::exit(1);
+}
+
+bool conversionCacheEnabled() { return false; }
+spa::Status readSpectrumThroughCache(const char* path, float values[]) { return spa::readSpectrumData(path, values); }
+void trimConversionCache() {}
+long long conversionCacheHits() { return 0; }
+long long conversionCacheMisses() { return 0; }
+
+#else // POSIX
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Layout of a cached spectrum (h-<content hash>.spec): this header, then the NUM_POINTS floats
+// encoded by encodeSpectrum() (lossless, about 40% of their size)
+struct CacheEntryHeader
+{
+    char magic[4];          // "SPAC"
+    uint32_t version;
+    uint32_t numPoints;
+    uint32_t encodedBytes;
+    uint64_t contentHash;   // of the whole SPA file
+};
+
+// Layout of a file record (s-<device>-<inode>)
+struct CacheFileRecord
+{
+    char magic[4];          // "SPAS"
+    uint32_t version;
+    int64_t size;
+    int64_t modifiedNanos;
+    uint64_t contentHash;
+};
+
+const uint32_t CACHE_VERSION = 2;   // 1 stored the floats as they are
+
+static std::string cacheDirectory;
+static size_t cacheBudget = 0;
+static std::atomic<long long> numHits(0);
+static std::atomic<long long> numMisses(0);
+static std::atomic<long long> tempCounter(0);
+
+void setConversionCache(const char* directory, size_t budgetBytes)
+{
+    const char* funcDef = "void setConversionCache(const char*, size_t)";
+    struct stat info;
+    if(stat(directory, &info) != 0)
+    {
+        if(mkdir(directory, 0777) != 0 && errno != EEXIST)
+        {
+            std::cerr << "Error: " << funcDef << ": unable to create cache directory '" << directory << "': " << std::strerror(errno) << ".\n";
+            std::exit(1);
+        }
+    }
+    else if(!S_ISDIR(info.st_mode))
+    {
+        std::cerr << "Error: " << funcDef << ": cache directory '" << directory << "' is not a directory.\n";
+        std::exit(1);
+    }
+    cacheDirectory = std::string(directory) + "/";
+    cacheBudget = budgetBytes;
+    return;
+}
+
+bool conversionCacheEnabled()
+{
+    return !cacheDirectory.empty();
+}
+
+long long conversionCacheHits()
+{
+    return numHits.load();
+}
+
+long long conversionCacheMisses()
+{
+    return numMisses.load();
+}
+
+static std::string hex(uint64_t value)
+{
+    char text[17];
+    snprintf(text, sizeof(text), "%016llx", (unsigned long long)value);
+    return text;
+}
+
+static int64_t modifiedNanos(const struct stat& info)
+{
+    return info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+}
+
+// Write bytes to path via a temporary file, so readers see all of it or none of it
+static void writeAtomically(const std::string& path, const char* header, size_t headerBytes, const char* data, size_t dataBytes)
+{
+    std::string tempPath = path + ".tmp." + std::to_string((long long)getpid()) + "." + std::to_string(tempCounter++);
+    std::ofstream file (tempPath.c_str(), std::ios::out | std::ios::binary);
+    file.write(header, headerBytes);
+    if(dataBytes > 0) file.write(data, dataBytes);
+    file.close();
+    if(!file || std::rename(tempPath.c_str(), path.c_str()) != 0)
+        std::remove(tempPath.c_str()); // the cache is only an optimization
+    return;
+}
+
+// The cached spectrum with the given content hash, if there is one
+static bool readEntry(uint64_t contentHash, float values[])
+{
+    std::string path = cacheDirectory + "h-" + hex(contentHash) + ".spec";
+    std::ifstream file (path.c_str(), std::ios::in | std::ios::binary);
+    CacheEntryHeader header;
+    if(!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    if(std::memcmp(header.magic, "SPAC", 4) != 0 || header.version != CACHE_VERSION
+        || header.numPoints != (uint32_t)spa::NUM_POINTS || header.contentHash != contentHash) return false;
+    std::vector<unsigned char> encoded(header.encodedBytes);
+    if(encoded.empty() || !file.read(reinterpret_cast<char*>(&encoded[0]), encoded.size())) return false;
+    if(!decodeSpectrum(&encoded[0], encoded.size(), values, spa::NUM_POINTS)) return false;
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0); // recently used: keep it when trimming
+    return true;
+}
+
+// Whether path holds an entry in the current layout; an older one is replaced
+static bool entryIsCurrent(const std::string& path)
+{
+    std::ifstream file (path.c_str(), std::ios::in | std::ios::binary);
+    CacheEntryHeader header;
+    return file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        && std::memcmp(header.magic, "SPAC", 4) == 0 && header.version == CACHE_VERSION;
+}
+
+spa::Status readSpectrumThroughCache(const char* path, float values[])
+{
+    struct stat info;
+    if(stat(path, &info) != 0) return spa::ERROR_OPEN;
+    std::string recordPath = cacheDirectory + "s-" + hex(info.st_dev) + "-" + hex(info.st_ino);
+
+    // Cheap check: the file is unchanged since its content hash was recorded
+    {
+        std::ifstream recordFile (recordPath.c_str(), std::ios::in | std::ios::binary);
+        CacheFileRecord record;
+        if(recordFile.read(reinterpret_cast<char*>(&record), sizeof(record))
+            && std::memcmp(record.magic, "SPAS", 4) == 0 && record.version == CACHE_VERSION
+            && record.size == (int64_t)info.st_size && record.modifiedNanos == modifiedNanos(info)
+            && readEntry(record.contentHash, values))
+        {
+            numHits++;
+            return spa::OK;
+        }
+    }
+
+    // Read, hash and decode the file, then remember it
+    numMisses++;
+    std::vector<char> bytes(info.st_size);
+    std::ifstream spaInputFile (path, std::ios::in | std::ios::binary);
+    if(!spaInputFile.is_open()) return spa::ERROR_OPEN;
+    if(!bytes.empty() && !spaInputFile.read(&bytes[0], bytes.size())) return spa::ERROR_READ;
+    spa::Status status = spa::decodeSpectrumData(bytes.empty() ? nullptr : &bytes[0], bytes.size(), values);
+    if(status != spa::OK) return status;
+
+    uint64_t contentHash = xxHash64(&bytes[0], bytes.size(), 0);
+    std::string entryPath = cacheDirectory + "h-" + hex(contentHash) + ".spec";
+    if(!entryIsCurrent(entryPath))
+    { // New content; a copy of an already cached file only needs its record
+        std::vector<unsigned char> encoded;
+        encodeSpectrum(values, spa::NUM_POINTS, encoded);
+        CacheEntryHeader header = {{'S', 'P', 'A', 'C'}, CACHE_VERSION, (uint32_t)spa::NUM_POINTS, (uint32_t)encoded.size(), contentHash};
+        writeAtomically(entryPath, reinterpret_cast<const char*>(&header), sizeof(header),
+            reinterpret_cast<const char*>(&encoded[0]), encoded.size());
+    }
+    CacheFileRecord record = {{'S', 'P', 'A', 'S'}, CACHE_VERSION, (int64_t)info.st_size, modifiedNanos(info), contentHash};
+    writeAtomically(recordPath, reinterpret_cast<const char*>(&record), sizeof(record), nullptr, 0);
+    return spa::OK;
+}
+
+void trimConversionCache()
+{
+    struct CacheFile
+    {
+        int64_t lastUsed;
+        size_t size;
+        std::string path;
+    };
+    std::vector<CacheFile> files;
+    size_t totalBytes = 0;
+    DIR* dir = opendir(cacheDirectory.c_str());
+    if(dir == nullptr) return;
+    for(dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+    {
+        std::string name = entry->d_name;
+        if(name.compare(0, 2, "h-") != 0 && name.compare(0, 2, "s-") != 0) continue;
+        CacheFile file = {0, 0, cacheDirectory + name};
+        struct stat info;
+        if(stat(file.path.c_str(), &info) != 0) continue;
+        file.lastUsed = modifiedNanos(info);
+        file.size = info.st_size;
+        totalBytes += file.size;
+        files.push_back(file);
+    }
+    closedir(dir);
+    if(totalBytes <= cacheBudget) return;
+
+    std::sort(files.begin(), files.end(), [](const CacheFile& a, const CacheFile& b) { return a.lastUsed < b.lastUsed; });
+    for(size_t i = 0; i < files.size() && totalBytes > cacheBudget; i++)
+        if(std::remove(files[i].path.c_str()) == 0)
+            totalBytes -= files[i].size;
+    return;
+}
+
+#endif // _WIN32
+
+// XXH64, as specified at github.com/Cyan4973/xxHash (doc/xxhash_spec.md)
+static const uint64_t XXH_PRIME_1 = 11400714785074694791ULL;
+static const uint64_t XXH_PRIME_2 = 14029467366897019727ULL;
+static const uint64_t XXH_PRIME_3 = 1609587929392839161ULL;
+static const uint64_t XXH_PRIME_4 = 9650029242287828579ULL;
+static const uint64_t XXH_PRIME_5 = 2870177450012600261ULL;
+
+static inline uint64_t rotateLeft(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t read64(const unsigned char* p)
+{
+    uint64_t value;
+    std::memcpy(&value, p, 8); // little-endian hosts, as for the SPA data
+    return value;
+}
+
+static inline uint32_t read32(const unsigned char* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, 4);
+    return value;
+}
+
+static inline uint64_t xxhRound(uint64_t accumulator, uint64_t lane)
+{
+    accumulator += lane * XXH_PRIME_2;
+    return rotateLeft(accumulator, 31) * XXH_PRIME_1;
+}
+
+static inline uint64_t xxhMergeRound(uint64_t accumulator, uint64_t lane)
+{
+    accumulator ^= xxhRound(0, lane);
+    return accumulator * XXH_PRIME_1 + XXH_PRIME_4;
+}
+
+uint64_t xxHash64(const void* data, size_t length, uint64_t seed)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + length;
+    uint64_t hash;
+    if(length >= 32)
+    { // Four independent lanes over 32-byte stripes
+        uint64_t v1 = seed + XXH_PRIME_1 + XXH_PRIME_2;
+        uint64_t v2 = seed + XXH_PRIME_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME_1;
+        for(; p + 32 <= end; p += 32)
+        {
+            v1 = xxhRound(v1, read64(p));
+            v2 = xxhRound(v2, read64(p + 8));
+            v3 = xxhRound(v3, read64(p + 16));
+            v4 = xxhRound(v4, read64(p + 24));
+        }
+        hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+        hash = xxhMergeRound(hash, v1);
+        hash = xxhMergeRound(hash, v2);
+        hash = xxhMergeRound(hash, v3);
+        hash = xxhMergeRound(hash, v4);
+    }
+    else
+        hash = seed + XXH_PRIME_5;
+    hash += length;
+
+    for(; p + 8 <= end; p += 8)
+        hash = rotateLeft(hash ^ xxhRound(0, read64(p)), 27) * XXH_PRIME_1 + XXH_PRIME_4;
+    if(p + 4 <= end)
+    {
+        hash = rotateLeft(hash ^ (read32(p) * XXH_PRIME_1), 23) * XXH_PRIME_2 + XXH_PRIME_3;
+        p += 4;
+    }
+    for(; p < end; p++)
+        hash = rotateLeft(hash ^ (*p * XXH_PRIME_5), 11) * XXH_PRIME_1;
+
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
@@ -0,0 +1,34 @@
+#ifndef CONVERSION_CACHE_H
+#define CONVERSION_CACHE_H
+
+#include "spa.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// On-disk cache of decoded spectra (--cache-dir), shared by every run that uses the same
+// directory. Each spectrum is stored once per distinct file content, losslessly compressed
+// (spectrum-codec.h) and named by a 64-bit xxHash of the SPA file. A small record per file (device and inode) remembers the size,
+// modification time and content hash last seen, so an unchanged file is found without
+// reading or hashing it. Files are written under temporary names and renamed into place,
+// so concurrent runs never see half-written entries.
+
+// Use directory (created if missing) and keep it to about budgetBytes; call before reading
+void setConversionCache(const char* directory, size_t budgetBytes);
+bool conversionCacheEnabled();
+
+// Fill values[] from the cache if path is unchanged since it was cached; otherwise read path,
+// decode it and add it to the cache. Failing to write the cache is not an error.
+spa::Status readSpectrumThroughCache(const char* path, float values[]);
+
+// Delete the least recently used entries until the cache fits its budget
+void trimConversionCache();
+
+// Lookups answered without reading the SPA file, and those that had to read it
+long long conversionCacheHits();
+long long conversionCacheMisses();
+
+// 64-bit xxHash (XXH64) of length bytes
+uint64_t xxHash64(const void* data, size_t length, uint64_t seed);
+
+#endif // CONVERSION_CACHE_H
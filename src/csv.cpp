@@ -0,0 +1,56 @@
+#include "csv.h"
+
+#include <cstdio>
+#include <fstream>
+
+void formatCSVHeading(std::string& block, char** titles, int numCols)
+{
+    block += "Wavenumber, ";
+    for(int i = 0; i < numCols - 1; i++)
+    {
+        block += titles[i];
+        block += ", ";
+    }
+    block += titles[numCols - 1];
+    block += "\n";
+    return;
+}
+
+// Matches what operator<< would print for each float
+void formatCSVRows(std::string& block, float** data, const float wavenumber[], int numCols, int firstRow, int lastRow)
+{
+    char number[32];
+    for(int i = firstRow; i < lastRow + 1; i++)
+    {
+        int length = snprintf(number, sizeof(number), "%g", wavenumber[i]);
+        block.append(number, length);
+        for(int j = 0; j < numCols; j++)
+        {
+            block.append(", ", 2);
+            length = snprintf(number, sizeof(number), "%g", data[j][i]);
+            block.append(number, length);
+        }
+        block.push_back('\n');
+    }
+    return;
+}
+
+spa::Status writeCSV(const char* path, char** titles, float** data, const float wavenumber[], int numCols, int firstRow, int lastRow)
+{
+    // Rows are formatted a block at a time, so the text never needs more than one block of memory
+    const int ROWS_PER_BLOCK = 256;
+    if(numCols < 1 || firstRow < 0 || lastRow < firstRow) return spa::ERROR_ARGUMENT;
+    std::ofstream output (path, std::ios::out);
+    if(!output.is_open()) return spa::ERROR_OPEN;
+    std::string block;
+    formatCSVHeading(block, titles, numCols);
+    for(int row = firstRow; row <= lastRow && output; row += ROWS_PER_BLOCK)
+    {
+        int blockLastRow = ( row + ROWS_PER_BLOCK - 1 < lastRow ? row + ROWS_PER_BLOCK - 1 : lastRow );
+        formatCSVRows(block, data, wavenumber, numCols, row, blockLastRow);
+        output.write(block.data(), block.size());
+        block.clear();
+    }
+    output.close();
+    return ( output ? spa::OK : spa::ERROR_WRITE );
+}
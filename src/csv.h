@@ -0,0 +1,19 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include "spa.h"
+
+#include <string>
+
+// Append the CSV heading line, or rows firstRow to lastRow (inclusive), to block; used by
+// writeCSV(), by spa-reader's pipelined CSV output and by the server, which streams blocks to
+// its clients instead of a file
+void formatCSVHeading(std::string& block, char** titles, int numCols);
+void formatCSVRows(std::string& block, float** data, const float wavenumber[], int numCols, int firstRow, int lastRow);
+
+// Write a heading of titles, then rows firstRow to lastRow (inclusive) of the numCols columns
+// of data, each row led by its wavenumber, to a new text file at path. ERROR_OPEN if the file
+// cannot be created, ERROR_WRITE if writing fails.
+spa::Status writeCSV(const char* path, char** titles, float** data, const float wavenumber[], int numCols, int firstRow, int lastRow);
+
+#endif // CSV_H
@@ -1,7 +1,11 @@
 #include <iostream>
 #include <cstdlib>
+#include <cerrno> // createFloatArray(): errno
 #include <string> // createFloatArray(): to_string(), string()
-#include <cmath> // wavenumToIndex(): abs()
+#include <cstring> // parseAggregateMode(): strcmp(); createFloatArray(): strerror()
+#include <vector> // createSPAFileArray()
+#include "data-processing.h"
+#include "scratch-matrix.h"
 
 using namespace std;
 
@@ -47,34 +51,6 @@ void checkBound(int bound, float MAX_WAVENUMBER, float MIN_WAVENUMBER)
     return;
 }
 
-// Convert a wavenumber to nearest index
-int wavenumToIndex(int wavenumber, float wavenumberArray[], int size)
-{
-	//cout << "wavenumToIndex(int): passed argument 'wavenumber' = " << wavenumber << "." << endl;
-	int candidateIndex = 0;
-    // Find the value in wavenumberArray that is closest to wavenumber
-    for(int i = 0; i < size; i++)
-    {
-    	if(wavenumber < wavenumberArray[i]) 
-    		candidateIndex = i;
-    	else 
-    		break;
-    } // candidateIndex now stores the index of the wavenumberArray value which is JUST GREATER THAN wavenumber
-    float leftDistance = abs(wavenumber - wavenumberArray[candidateIndex]);
-    float rightDistance = abs(wavenumber - wavenumberArray[candidateIndex + 1]);
-    if(leftDistance == rightDistance || leftDistance < rightDistance)
-    {
-    	//cout << "Found candidateIndex: " << candidateIndex << " with corresponding value " << wavenumberArray[candidateIndex] << "." << endl;
-    	return candidateIndex;
-    }
-    else
-    {
-    	//cout << "Found candidateIndex: " << candidateIndex + 1 << " with corresponding value " << wavenumberArray[candidateIndex + 1] << "." << endl;
-    	return candidateIndex + 1; 	// Note: candidateIndex cannot ever be the last index;
-    								// this is prevented by truncation and checkBounds()
-    }
-}
-
 void checkIfNull(void* pointer, const char* callingFunc, const char* ptrDef)
 {
 	if(pointer == nullptr)
@@ -85,14 +61,24 @@ void checkIfNull(void* pointer, const char* callingFunc, const char* ptrDef)
 	return;
 }
 
-char** createSPAFileArray(int NUM_SPA_FILES, int numOptArgs, char* argv[], const char* ptrDef)
+void checkStatus(spa::Status status, const char* callingFunc, const std::string& what)
 {
-    const char* funcDef = "char** createSPAFileArray(int, int, char* [], const char*)";
+	if(status != spa::OK)
+	{
+		cerr << "Error: " << callingFunc << ": " << what << ": " << spa::statusMessage(status) << ".\n";
+		exit(1);
+	}
+	return;
+}
+
+char** createSPAFileArray(std::vector<std::string>& paths, const char* ptrDef)
+{
+    const char* funcDef = "char** createSPAFileArray(std::vector<std::string>&, const char*)";
     char** filenameArray;
-    filenameArray = new (nothrow) char* [NUM_SPA_FILES];
+    filenameArray = new (nothrow) char* [paths.size()];
     checkIfNull(filenameArray, funcDef, ptrDef);
-    for(int i = 0; i < NUM_SPA_FILES; i++)
-        filenameArray[i] = argv[i + numOptArgs + 1];
+    for(size_t i = 0; i < paths.size(); i++)
+        filenameArray[i] = &paths[i][0];
     return filenameArray;
 }
 
@@ -110,6 +96,16 @@ float** createFloatArray(int numCols, int numRows, const char* ptrDef)
 {
     const char* funcDef = "float** createFloatArray(int, int, const char*)";
     float** floatArray;
+    if(scratchMatricesInUse())
+    {
+        floatArray = createScratchFloatArray(numCols, numRows);
+        if(floatArray == nullptr)
+        {
+            cerr << "Error: " << funcDef << ": unable to map a scratch file for " << ptrDef << ": " << strerror(errno) << ".\n";
+            exit(1);
+        }
+        return floatArray;
+    }
     floatArray = new (nothrow) float* [numCols];
     checkIfNull(floatArray, funcDef, ptrDef);
     string ptrDefStr = ptrDef;
@@ -123,59 +119,33 @@ float** createFloatArray(int numCols, int numRows, const char* ptrDef)
     return floatArray;
 }
 
-void computeAverages(float** AVG_DATA, float** IR_DATA, int numGroups, int groupSize, int SIZE)
+void freeFloatArray(float** floatArray, int numCols)
 {
-    for(int i = 0; i < SIZE; i++)
-        for(int j = 0; j < numGroups; j++)
-        {
-            float sum = 0;
-            for(int k = 0; k < groupSize; k++)
-                sum += IR_DATA[j*groupSize + k][i];
-            AVG_DATA[j][i] = sum / (float)groupSize;
-        }
+    if(floatArray == nullptr || freeScratchFloatArray(floatArray)) return;
+    for(int i = 0; i < numCols; i++)
+        delete[] floatArray[i];
+    delete[] floatArray;
     return;
 }
 
-void computeConstCorr(float** CORR_DATA, float** IR_DATA, int NUM_SPA_FILES, float WAVENUMBER[], int SIZE, int ubCorr, int lbCorr)
-{
-    const char* funcDef = "void computeConstCorr(float**, float**, int, int, int, int)";
-    float* baseline = new (nothrow) float [SIZE];
-    checkIfNull(baseline, funcDef, "float* baseline");
-    for(int i = 0; i < SIZE; i++)
-    {
-        float sum = 0;
-        for(int j = 0; j < NUM_SPA_FILES; j++)
-            sum += IR_DATA[j][i];
-        baseline[i] = sum / (float)NUM_SPA_FILES;
-    }
 
-    float** difference = createFloatArray(NUM_SPA_FILES, SIZE, (string(funcDef) + string(": ") + string("float** difference")).c_str());
-    for(int i = 0; i < NUM_SPA_FILES; i++)
-        for(int j = 0; j < SIZE; j++)
-            difference[i][j] = baseline[j] - IR_DATA[i][j];
-    
-    int lbCorrIndex = wavenumToIndex(ubCorr, WAVENUMBER, SIZE);
-    int ubCorrIndex = wavenumToIndex(lbCorr, WAVENUMBER, SIZE);
+AggregateMode parseAggregateMode(const char* modeStr)
+{
+    const char* funcDef = "AggregateMode parseAggregateMode(const char*)";
+    if(strcmp(modeStr, "mean") == 0) return AGGREGATE_MEAN;
+    if(strcmp(modeStr, "median") == 0) return AGGREGATE_MEDIAN;
+    if(strcmp(modeStr, "trimmed-mean") == 0) return AGGREGATE_TRIMMED_MEAN;
+    cerr << "Error: " << funcDef << ": unknown aggregate '" << modeStr << "'. Expected mean, median or trimmed-mean.\n";
+    exit(1);
+}
 
-    float* averageDiffOverInterval = new (nothrow) float [NUM_SPA_FILES];
-    checkIfNull(averageDiffOverInterval, funcDef, "float* averageDiffOverInterval");
-    for(int i = 0; i < NUM_SPA_FILES; i++)
+// Prefix used to name the output files of each aggregate
+const char* aggregatePrefix(AggregateMode mode)
+{
+    switch(mode)
     {
-        float sum = 0;
-        for(int j = lbCorrIndex; j < ubCorrIndex + 1; j++)
-            sum += difference[i][j];
-        averageDiffOverInterval[i] = sum / (float)(ubCorrIndex - lbCorrIndex + 1);
+        case AGGREGATE_MEDIAN: return "median";
+        case AGGREGATE_TRIMMED_MEAN: return "trimmedMean";
+        default: return "averaged";
     }
-
-    for(int i = 0; i < NUM_SPA_FILES; i++)
-        for(int j = 0; j < SIZE; j++)
-            CORR_DATA[i][j] = averageDiffOverInterval[i] + IR_DATA[i][j];
-
-    delete[] baseline;
-    delete[] averageDiffOverInterval;
-    for(int i = 0; i < NUM_SPA_FILES; i++)
-        delete[] difference[i];
-    delete[] difference;
-    
-    return;
 }
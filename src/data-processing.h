@@ -1,22 +1,23 @@
 #ifndef DATA_PROCESSING_H
 #define DATA_PROCESSING_H
 
+#include "processing.h"
+
+#include <string>
+#include <vector>
+
 void checkBound(int* upperBound, int* lowerBound, float MAX_WAVENUMBER, float MIN_WAVENUMBER);
 void checkBound(int bound, float MAX_WAVENUMBER, float MIN_WAVENUMBER);
-int wavenumToIndex(int wavenumber, float wavenumberArray[], int size);
-void computeAverages(float** AVG_DATA, float** IR_DATA, int numGroups, int groupSize, int SIZE);
-void computeConstCorr(
-    float** CORR_DATA,
-    float** IR_DATA,
-    int NUM_SPA_FILES,
-    float WAVENUMBER[],
-    int SIZE,
-    int upperBoundCorrection,
-    int lowerBoundCorrection
-);
+AggregateMode parseAggregateMode(const char* modeStr);
+const char* aggregatePrefix(AggregateMode mode);
 
-char** createSPAFileArray(int NUM_SPA_FILES, int numOptArgs, char* argv[], const char* ptrDef);
+void checkIfNull(void* pointer, const char* callingFunc, const char* ptrDef);
+// Exits with an error naming what failed unless status is spa::OK
+void checkStatus(spa::Status status, const char* callingFunc, const std::string& what);
+// Pointers into paths, which must outlive the array
+char** createSPAFileArray(std::vector<std::string>& paths, const char* ptrDef);
 float** createFloatArray(int numCols, int numRows, const char* ptrDef);
+void freeFloatArray(float** floatArray, int numCols);
 char** createAvgDataColTitles(int numGroups, int groupSize, char** SPA_FILENAME, const char* ptrDef);
 
 #endif // DATA_PROCESSING_H
@@ -0,0 +1,96 @@
+#include "fft.h"
+
+#include <cmath>
+#include <new>
+#include <utility>
+
+int nextPowerOfTwo(int n)
+{
+    int power = 1;
+    while(power < n)
+        power *= 2;
+    return power;
+}
+
+FftPlan* createFftPlan(int size)
+{
+    if(size < 2 || nextPowerOfTwo(size) != size) return nullptr;
+    FftPlan* plan = new (std::nothrow) FftPlan;
+    if(plan == nullptr) return nullptr;
+    plan->size = size;
+    plan->twiddle = new (std::nothrow) std::complex<double> [size / 2];
+    plan->bitReverse = new (std::nothrow) int [size];
+    if(plan->twiddle == nullptr || plan->bitReverse == nullptr)
+    {
+        deleteFftPlan(plan);
+        return nullptr;
+    }
+
+    const double PI = 3.14159265358979323846;
+    for(int k = 0; k < size / 2; k++)
+        plan->twiddle[k] = std::polar(1.0, -2.0 * PI * k / size);
+
+    int numBits = 0;
+    while((1 << numBits) < size)
+        numBits++;
+    for(int i = 0; i < size; i++)
+    {
+        int reversed = 0;
+        for(int b = 0; b < numBits; b++)
+            if(i & (1 << b)) reversed |= 1 << (numBits - 1 - b);
+        plan->bitReverse[i] = reversed;
+    }
+    return plan;
+}
+
+void deleteFftPlan(FftPlan* plan)
+{
+    delete[] plan->twiddle;
+    delete[] plan->bitReverse;
+    delete plan;
+    return;
+}
+
+// Iterative decimation-in-time butterflies; conjugate twiddles give the inverse
+static void transform(const FftPlan* plan, std::complex<double> data[], bool inverse)
+{
+    const int n = plan->size;
+    for(int i = 0; i < n; i++)
+    {
+        int j = plan->bitReverse[i];
+        if(i < j) std::swap(data[i], data[j]);
+    }
+    for(int length = 2; length <= n; length *= 2)
+    {
+        int half = length / 2;
+        int stride = n / length; // step through the twiddle table
+        for(int start = 0; start < n; start += length)
+            for(int k = 0; k < half; k++)
+            {
+                // Multiply by hand: operator* on std::complex checks for NaN/inf on every call
+                double wRe = plan->twiddle[k * stride].real();
+                double wIm = ( inverse ? -plan->twiddle[k * stride].imag() : plan->twiddle[k * stride].imag() );
+                double xRe = data[start + k + half].real();
+                double xIm = data[start + k + half].imag();
+                std::complex<double> odd(wRe * xRe - wIm * xIm, wRe * xIm + wIm * xRe);
+                data[start + k + half] = data[start + k] - odd;
+                data[start + k] += odd;
+            }
+    }
+    return;
+}
+
+void fft(const FftPlan* plan, std::complex<double> data[])
+{
+    transform(plan, data, false);
+    return;
+}
+
+void inverseFft(const FftPlan* plan, std::complex<double> data[])
+{
+    transform(plan, data, true);
+    const double scale = 1.0 / plan->size;
+    for(int i = 0; i < plan->size; i++)
+        data[i] *= scale;
+    return;
+}
@@ -0,0 +1,24 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <complex>
+
+// Twiddle factors and bit-reversal order for one radix-2 transform size. A plan is read-only
+// once created, so threads can share it.
+struct FftPlan
+{
+    int size;                          // power of two
+    std::complex<double>* twiddle;     // [size / 2] exp(-2 pi i k / size)
+    int* bitReverse;                   // [size]
+};
+
+int nextPowerOfTwo(int n);
+// nullptr if size is not a power of two of at least 2, or if memory runs out
+FftPlan* createFftPlan(int size);
+void deleteFftPlan(FftPlan* plan);
+
+// In-place transform of plan->size values; the inverse is scaled by 1 / size
+void fft(const FftPlan* plan, std::complex<double> data[]);
+void inverseFft(const FftPlan* plan, std::complex<double> data[]);
+
+#endif // FFT_H
@@ -0,0 +1,211 @@
+#include "input-files.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+bool naturalLess(const std::string& a, const std::string& b)
+{
+    size_t i = 0;
+    size_t j = 0;
+    while(i < a.size() && j < b.size())
+    {
+        if(std::isdigit((unsigned char)a[i]) && std::isdigit((unsigned char)b[j]))
+        { // Compare the numbers: without leading zeros, the longer is larger, else the first difference
+            while(i < a.size() && a[i] == '0') i++;
+            while(j < b.size() && b[j] == '0') j++;
+            size_t aEnd = i;
+            size_t bEnd = j;
+            while(aEnd < a.size() && std::isdigit((unsigned char)a[aEnd])) aEnd++;
+            while(bEnd < b.size() && std::isdigit((unsigned char)b[bEnd])) bEnd++;
+            if(aEnd - i != bEnd - j) return aEnd - i < bEnd - j;
+            int difference = a.compare(i, aEnd - i, b, j, bEnd - j);
+            if(difference != 0) return difference < 0;
+            i = aEnd;
+            j = bEnd;
+        }
+        else if(a[i] != b[j])
+            return (unsigned char)a[i] < (unsigned char)b[j];
+        else
+        {
+            i++;
+            j++;
+        }
+    }
+    if(i < a.size() || j < b.size()) return j < b.size(); // a prefix comes first
+    return a < b;
+}
+
+void readManifest(const char* manifest, std::vector<std::string>& paths)
+{
+    const char* funcDef = "void readManifest(const char*, std::vector<std::string>&)";
+    const bool useStdin = (std::strcmp(manifest, "-") == 0);
+    std::ifstream manifestFile;
+    if(!useStdin)
+    {
+        manifestFile.open(manifest);
+        if(!manifestFile.is_open())
+        {
+            std::cerr << "Error: " << funcDef << ": unable to open manifest '" << manifest << "'.\n";
+            std::exit(1);
+        }
+    }
+    std::istream& input = ( useStdin ? std::cin : manifestFile );
+    std::string line;
+    while(std::getline(input, line))
+    {
+        if(!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+        if(!line.empty()) paths.push_back(line);
+    }
+    return;
+}
+
+bool hasSPAExtension(const std::string& name)
+{
+    if(name.size() < 4) return false;
+    std::string extension = name.substr(name.size() - 4);
+    for(size_t i = 0; i < extension.size(); i++)
+        extension[i] = (char)std::tolower((unsigned char)extension[i]);
+    return extension == ".spa";
+}
+
+#ifdef _WIN32
+
+void findSPAFiles(const char*, const char*, int, std::vector<std::string>&)
+{
+    std::cerr << "Error: void findSPAFiles(const char*, const char*, int, std::vector<std::string>&): "
+        << "--input-dir is not supported by this build; use --manifest.\n";
+    std::exit(1);
+}
+
+void expandGlob(const char*, std::vector<std::string>&)
+{
+    std::cerr << "Error: void expandGlob(const char*, std::vector<std::string>&): --glob is not supported by this build; use --manifest.\n";
+    std::exit(1);
+}
+
+#else // POSIX
+
+#include <condition_variable>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <glob.h>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
+
+// Directories still to be listed, shared by the listing threads. A thread that finds the stack
+// empty waits while others are busy, since they may yet push subdirectories.
+struct DirectoryWork
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::string> pending;
+    int numBusy;
+};
+
+void findSPAFiles(const char* directory, const char* namePattern, int numThreads, std::vector<std::string>& paths)
+{
+    const char* funcDef = "void findSPAFiles(const char*, const char*, int, std::vector<std::string>&)";
+    struct stat info;
+    if(stat(directory, &info) != 0 || !S_ISDIR(info.st_mode))
+    {
+        std::cerr << "Error: " << funcDef << ": '" << directory << "' is not a directory.\n";
+        std::exit(1);
+    }
+
+    DirectoryWork work;
+    work.pending.push_back(directory);
+    work.numBusy = 0;
+    std::vector<std::vector<std::string> > found(numThreads);
+
+    auto lister = [&](int thread)
+    {
+        std::unique_lock<std::mutex> lock(work.mutex);
+        for(;;)
+        {
+            work.changed.wait(lock, [&]() { return !work.pending.empty() || work.numBusy == 0; });
+            if(work.pending.empty()) break; // nothing left and nobody can add more
+            std::string path = work.pending.back();
+            work.pending.pop_back();
+            work.numBusy++;
+            lock.unlock();
+
+            std::vector<std::string> subdirectories;
+            if(path[path.size() - 1] != '/') path += '/';
+            DIR* dir = opendir(path.c_str());
+            if(dir == nullptr)
+                std::cerr << "Warning: unable to list directory '" << path << "': " << std::strerror(errno) << ".\n";
+            for(dirent* entry = ( dir ? readdir(dir) : nullptr ); entry != nullptr; entry = readdir(dir))
+            {
+                const char* name = entry->d_name;
+                if(std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0) continue;
+                std::string entryPath = path + name;
+                bool isDirectory = (entry->d_type == DT_DIR);
+                bool isFile = (entry->d_type == DT_REG);
+                if(entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK)
+                { // Links count as the file they name, but are not followed into directories
+                    struct stat entryInfo;
+                    if(stat(entryPath.c_str(), &entryInfo) != 0) continue;
+                    isDirectory = (entry->d_type == DT_UNKNOWN && S_ISDIR(entryInfo.st_mode));
+                    isFile = S_ISREG(entryInfo.st_mode);
+                }
+                if(isDirectory)
+                    subdirectories.push_back(entryPath);
+                else if(isFile && ( namePattern ? fnmatch(namePattern, name, 0) == 0 : hasSPAExtension(name) ))
+                    found[thread].push_back(entryPath);
+            }
+            if(dir) closedir(dir);
+
+            lock.lock();
+            work.pending.insert(work.pending.end(), subdirectories.begin(), subdirectories.end());
+            work.numBusy--;
+            work.changed.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(int t = 1; t < numThreads; t++)
+        threads.push_back(std::thread(lister, t));
+    lister(0);
+    for(size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    size_t firstNew = paths.size();
+    for(int t = 0; t < numThreads; t++)
+        paths.insert(paths.end(), found[t].begin(), found[t].end());
+    std::sort(paths.begin() + firstNew, paths.end(), naturalLess);
+    return;
+}
+
+void expandGlob(const char* pattern, std::vector<std::string>& paths)
+{
+    const char* funcDef = "void expandGlob(const char*, std::vector<std::string>&)";
+    glob_t matches;
+    int status = glob(pattern, GLOB_MARK | GLOB_NOSORT, nullptr, &matches); // GLOB_MARK: directories end in '/'
+    size_t firstNew = paths.size();
+    for(size_t i = 0; status == 0 && i < matches.gl_pathc; i++)
+    {
+        std::string path = matches.gl_pathv[i];
+        if(path[path.size() - 1] != '/') paths.push_back(path);
+    }
+    globfree(&matches);
+    if(status == GLOB_NOSPACE || status == GLOB_ABORTED)
+    {
+        std::cerr << "Error: " << funcDef << ": unable to expand '" << pattern << "'.\n";
+        std::exit(1);
+    }
+    if(paths.size() == firstNew)
+    {
+        std::cerr << "Error: " << funcDef << ": no files match '" << pattern << "'.\n";
+        std::exit(1);
+    }
+    std::sort(paths.begin() + firstNew, paths.end(), naturalLess);
+    return;
+}
+
+#endif // _WIN32
@@ -0,0 +1,30 @@
+#ifndef INPUT_FILES_H
+#define INPUT_FILES_H
+
+#include <string>
+#include <vector>
+
+// Ways of naming the SPA files to read besides listing them after the options, for sets too
+// large for the command line (ARG_MAX) or for the shell to glob quickly. Each adds to paths.
+
+// Every file under directory, recursively, whose name matches the shell pattern namePattern
+// (nullptr: names ending in .spa, in any case). Subdirectories are listed by up to numThreads
+// threads at once; symbolic links to directories are not followed. Sorted with naturalLess().
+void findSPAFiles(const char* directory, const char* namePattern, int numThreads, std::vector<std::string>& paths);
+
+// The files matching the shell pattern pattern (e.g. 'SPA-Files/*-degC/*.SPA', quoted so the
+// shell leaves it alone), sorted with naturalLess(). No match is an error.
+void expandGlob(const char* pattern, std::vector<std::string>& paths);
+
+// One path per line of the file manifest ("-": standard input), in the order given. Blank
+// lines are skipped and a trailing carriage return is dropped.
+void readManifest(const char* manifest, std::vector<std::string>& paths);
+
+// Natural order: runs of digits compare by value, so 11361_2-16 comes before 113121_2-22.
+// Names that differ only in leading zeros fall back to plain string order, so the order is total.
+bool naturalLess(const std::string& a, const std::string& b);
+
+// Whether name ends in .spa, in any case
+bool hasSPAExtension(const std::string& name);
+
+#endif // INPUT_FILES_H
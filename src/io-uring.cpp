@@ -0,0 +1,321 @@
+#include "io-uring.h"
+#include "pipeline.h"
+#include "read-write.h"
+#include "spa.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+
+#if !defined(__linux__) || !defined(IORING_FEAT_CQE_SKIP)
+
+bool readSPAFilesUring(char**, float**, int, int, const std::function<void(int)>&, std::string* reason)
+{
+    *reason = "io_uring is not supported by this build";
+    return false;
+}
+
+#else // Linux with a recent enough io_uring.h (5.17: direct descriptors for openat and close)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Registered buffers per registration; the kernel allows at most 1 << 14
+const int MAX_REGISTERED_BUFFERS = 1 << 14;
+
+// What a completion belongs to: user_data = slot << 32 | range << 8 | kind
+enum UringRequestKind
+{
+    URING_OPEN = 0,
+    URING_READ = 1,
+    URING_CLOSE = 2
+};
+
+// The submission and completion rings, mapped from the kernel
+struct Uring
+{
+    int fd;
+    unsigned sqEntries;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned sqMask;
+    unsigned* sqArray;
+    io_uring_sqe* sqes;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    io_uring_cqe* cqes;
+    unsigned pendingTail;   // SQEs written but not yet submitted end here
+    void* sqRing;
+    size_t sqRingBytes;
+    void* cqRing;
+    size_t cqRingBytes;
+    size_t sqesBytes;
+};
+
+static int uringSetup(unsigned entries, io_uring_params* params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+static int uringRegister(int fd, unsigned opcode, const void* arg, unsigned numArgs)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, numArgs);
+}
+
+static void closeUring(Uring* ring)
+{
+    if(ring->sqes) munmap(ring->sqes, ring->sqesBytes);
+    if(ring->cqRing && ring->cqRing != ring->sqRing) munmap(ring->cqRing, ring->cqRingBytes);
+    if(ring->sqRing) munmap(ring->sqRing, ring->sqRingBytes);
+    if(ring->fd >= 0) close(ring->fd);
+    return;
+}
+
+static bool openUring(Uring* ring, unsigned entries, std::string* reason)
+{
+    std::memset(ring, 0, sizeof(*ring));
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ring->fd = uringSetup(entries, &params);
+    if(ring->fd < 0)
+    {
+        *reason = std::string("io_uring_setup failed: ") + std::strerror(errno);
+        return false;
+    }
+    // IORING_FEAT_CQE_SKIP arrived in 5.17, after direct descriptors for openat and close (5.15)
+    if(!(params.features & IORING_FEAT_CQE_SKIP))
+    {
+        *reason = "kernel io_uring is too old (5.17 or later is needed)";
+        close(ring->fd);
+        return false;
+    }
+
+    ring->sqEntries = params.sq_entries;
+    ring->sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+        ring->sqRingBytes = ring->cqRingBytes = std::max(ring->sqRingBytes, ring->cqRingBytes);
+    ring->sqRing = mmap(nullptr, ring->sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if(ring->sqRing == MAP_FAILED) ring->sqRing = nullptr;
+    ring->cqRing = ( (params.features & IORING_FEAT_SINGLE_MMAP) ? ring->sqRing :
+        mmap(nullptr, ring->cqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING) );
+    if(ring->cqRing == MAP_FAILED) ring->cqRing = nullptr;
+    ring->sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, ring->sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    ring->sqes = ( sqes == MAP_FAILED ? nullptr : static_cast<io_uring_sqe*>(sqes) );
+    if(!ring->sqRing || !ring->cqRing || !ring->sqes)
+    {
+        *reason = std::string("unable to map the io_uring rings: ") + std::strerror(errno);
+        closeUring(ring);
+        return false;
+    }
+
+    char* sq = static_cast<char*>(ring->sqRing);
+    ring->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    ring->sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    ring->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(ring->cqRing);
+    ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    ring->cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    ring->pendingTail = *ring->sqTail;
+
+    // openat, read and close must all be available
+    std::vector<char> probeMemory(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+    io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(&probeMemory[0]);
+    const int neededOps[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_READ_FIXED, IORING_OP_CLOSE};
+    bool supported = (uringRegister(ring->fd, IORING_REGISTER_PROBE, probe, 256) == 0);
+    for(int i = 0; supported && i < 4; i++)
+        supported = (neededOps[i] <= probe->last_op && (probe->ops[neededOps[i]].flags & IO_URING_OP_SUPPORTED));
+    if(!supported)
+    {
+        *reason = "io_uring does not support openat, read and close here";
+        closeUring(ring);
+        return false;
+    }
+    return true;
+}
+
+// Next free SQE, cleared; the caller has checked there is room
+static io_uring_sqe* nextSqe(Uring* ring)
+{
+    unsigned index = ring->pendingTail & ring->sqMask;
+    io_uring_sqe* sqe = &ring->sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    ring->sqArray[index] = index;
+    ring->pendingTail++;
+    return sqe;
+}
+
+static unsigned freeSqes(const Uring* ring)
+{
+    return ring->sqEntries - (ring->pendingTail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE));
+}
+
+// Per file slot: the file being read and what its completions have said so far
+struct UringSlot
+{
+    int file;
+    int completions;
+    spa::Status status;
+    long long submitNanos;  // for --trace
+};
+
+bool readSPAFilesUring(
+    char** SPA_FILENAME,
+    float** IR_DATA,
+    int NUM_SPA_FILES,
+    int ioDepth,
+    const std::function<void(int)>& fileRead,
+    std::string* reason
+)
+{
+    const char* funcDef = "bool readSPAFilesUring(char**, float**, int, int, const std::function<void(int)>&, std::string*)";
+    std::vector<int> firstIndex;
+    std::vector<int> lastIndex;
+    getSpectrumReadRanges(firstIndex, lastIndex);
+    const int numRanges = (int)firstIndex.size();
+    const int sqesPerFile = numRanges + 2;
+
+    Uring ring;
+    if(!openUring(&ring, (unsigned)(ioDepth * sqesPerFile), reason)) return false;
+    // Slot s holds the open file of slot s's chain; the kernel fills and empties it
+    std::vector<int> sparseFiles(ioDepth, -1);
+    if(uringRegister(ring.fd, IORING_REGISTER_FILES, &sparseFiles[0], ioDepth) != 0)
+    {
+        *reason = std::string("unable to register io_uring file slots: ") + std::strerror(errno);
+        closeUring(&ring);
+        return false;
+    }
+
+    std::vector<UringSlot> slots(ioDepth);
+    std::vector<int> freeSlots;
+    for(int s = ioDepth - 1; s >= 0; s--)
+        freeSlots.push_back(s);
+    bool useFixedBuffers = true; // until the kernel refuses to pin them (RLIMIT_MEMLOCK)
+
+    for(int chunkStart = 0; chunkStart < NUM_SPA_FILES; chunkStart += MAX_REGISTERED_BUFFERS)
+    {
+        const int chunkEnd = std::min(chunkStart + MAX_REGISTERED_BUFFERS, NUM_SPA_FILES);
+        bool fixedBuffers = false;
+        if(useFixedBuffers)
+        { // Buffer b is file chunkStart + b's row of IR_DATA
+            std::vector<iovec> buffers(chunkEnd - chunkStart);
+            for(int file = chunkStart; file < chunkEnd; file++)
+            {
+                buffers[file - chunkStart].iov_base = IR_DATA[file];
+                buffers[file - chunkStart].iov_len = spa::NUM_POINTS * sizeof(float);
+            }
+            fixedBuffers = (uringRegister(ring.fd, IORING_REGISTER_BUFFERS, &buffers[0], (unsigned)buffers.size()) == 0);
+            useFixedBuffers = fixedBuffers;
+        }
+
+        int nextFile = chunkStart;
+        int filesDone = chunkStart;
+        while(filesDone < chunkEnd)
+        {
+            // Start a chain per free slot: openat -> read each range -> close. The reads are hard
+            // links so a short read still closes the file; a failed openat cancels the rest.
+            while(nextFile < chunkEnd && !freeSlots.empty() && freeSqes(&ring) >= (unsigned)sqesPerFile)
+            {
+                int slot = freeSlots.back();
+                freeSlots.pop_back();
+                UringSlot fresh = {nextFile, 0, spa::OK, ( traceEnabled() ? nowNanos() : 0 )};
+                slots[slot] = fresh;
+                unsigned long long tag = (unsigned long long)slot << 32;
+
+                io_uring_sqe* open = nextSqe(&ring);
+                open->opcode = IORING_OP_OPENAT;
+                open->fd = AT_FDCWD;
+                open->addr = (unsigned long long)(uintptr_t)SPA_FILENAME[nextFile];
+                open->open_flags = O_RDONLY;
+                open->file_index = slot + 1;
+                open->flags = IOSQE_IO_LINK;
+                open->user_data = tag | URING_OPEN;
+                for(int r = 0; r < numRanges; r++)
+                {
+                    io_uring_sqe* read = nextSqe(&ring);
+                    read->opcode = ( fixedBuffers ? IORING_OP_READ_FIXED : IORING_OP_READ );
+                    read->fd = slot;
+                    read->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+                    read->addr = (unsigned long long)(uintptr_t)(IR_DATA[nextFile] + firstIndex[r]);
+                    read->len = (lastIndex[r] - firstIndex[r] + 1) * sizeof(float);
+                    read->off = spa::DATA_START + (unsigned long long)firstIndex[r] * sizeof(float);
+                    read->buf_index = ( fixedBuffers ? nextFile - chunkStart : 0 );
+                    read->user_data = tag | ((unsigned long long)r << 8) | URING_READ;
+                }
+                io_uring_sqe* closeFile = nextSqe(&ring);
+                closeFile->opcode = IORING_OP_CLOSE;
+                closeFile->file_index = slot + 1;
+                closeFile->user_data = tag | URING_CLOSE;
+                nextFile++;
+            }
+
+            // Submit everything written and wait for at least one completion
+            unsigned toSubmit = ring.pendingTail - *ring.sqTail;
+            __atomic_store_n(ring.sqTail, ring.pendingTail, __ATOMIC_RELEASE);
+            if(uringEnter(ring.fd, toSubmit, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            {
+                std::cerr << "Error: " << funcDef << ": io_uring_enter failed: " << std::strerror(errno) << ".\n";
+                std::exit(1);
+            }
+
+            unsigned head = *ring.cqHead;
+            unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+            for(; head != tail; head++)
+            {
+                const io_uring_cqe& cqe = ring.cqes[head & ring.cqMask];
+                int slot = (int)(cqe.user_data >> 32);
+                int range = (int)((cqe.user_data >> 8) & 0xffffff);
+                int kind = (int)(cqe.user_data & 0xff);
+                UringSlot& current = slots[slot];
+                if(kind == URING_OPEN && cqe.res < 0)
+                    current.status = spa::ERROR_OPEN;
+                else if(kind == URING_READ && current.status == spa::OK
+                    && cqe.res != (int)((lastIndex[range] - firstIndex[range] + 1) * sizeof(float)))
+                    current.status = spa::ERROR_READ;
+                if(++current.completions < sqesPerFile) continue;
+
+                // Every request of the chain has completed (cancelled ones included)
+                if(current.status != spa::OK)
+                {
+                    std::cerr << "Error: " << funcDef << ": SPA file '" << SPA_FILENAME[current.file] << "': "
+                        << spa::statusMessage(current.status) << "." << std::endl;
+                    std::exit(1);
+                }
+                zeroUnreadValues(IR_DATA[current.file]);
+                if(traceEnabled()) // from submission to the last completion of the chain
+                    traceEvent("read", "io_uring read", SPA_FILENAME[current.file], current.file, current.submitNanos, nowNanos());
+                freeSlots.push_back(slot);
+                filesDone++;
+                fileRead(current.file);
+            }
+            __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+        }
+        if(fixedBuffers) uringRegister(ring.fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+    }
+    closeUring(&ring);
+    return true;
+}
+
+#endif // io_uring
@@ -0,0 +1,25 @@
+#ifndef IO_URING_H
+#define IO_URING_H
+
+#include <functional>
+#include <string>
+
+// Read SPA files with Linux io_uring (--io-backend=io_uring), without liburing. Up to
+// ioDepth files are in flight at once; each is one linked chain of submissions, openat into a
+// registered file slot, a read of each range readSPAFile() would read (straight into the
+// file's row of IR_DATA, through registered buffers when the kernel lets us pin them), and
+// close. fileRead(file) is called on this thread as each file completes, in completion order.
+//
+// Returns false, with the reason, if io_uring cannot be used here (old kernel, seccomp, not
+// Linux); nothing has been read then and the caller should read the files another way. A file
+// that cannot be read is an error, exactly as in readSPAFile().
+bool readSPAFilesUring(
+    char** SPA_FILENAME,
+    float** IR_DATA,
+    int NUM_SPA_FILES,
+    int ioDepth,
+    const std::function<void(int)>& fileRead,
+    std::string* reason
+);
+
+#endif // IO_URING_H
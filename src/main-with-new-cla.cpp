@@ -1,40 +1,68 @@
+#include "alignment.h"
+#include "baseline-correction.h"
+#include "batch-jobs.h"
+#include "conversion-cache.h"
 #include "data-processing.h"
+#include "input-files.h"
+#include "parallel.h"
+#include "pipeline.h"
 #include "parse-command-line-args.h"
+#include "perf-counters.h"
 #include "print-usage.h"
+#include "quantize.h"
 #include "read-write.h"
+#include "run-report.h"
+#include "scratch-matrix.h"
+#include "server.h"
+#include "spa.h"
+#include "spectrum-codec.h"
 #include "str-to-int.h"
+#include "summation.h"
+#include "tar-archive.h"
+#include "trace.h"
+#include "transforms.h"
+#include "watch.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
+#include <new>
 
 // TODO(ben): stdlib imports
 
-const std::string UB_ARG_STR = "--upper-bound";
-const std::string LB_ARG_STR = "--lower-bound";
-const std::string UB_ARG_SHORT_STR = "-u";
-const std::string LB_ARG_SHORT_STR = "-l";
-const std::string CONST_CORR_STR = "--calculate-const-corr";
-const std::string GROUP_FILES_STR = "--group-files";
-
-const int UB_ARG_INDEX = 0;
-const int LB_ARG_INDEX = 1;
-const int CONST_CORR_ARG_INDEX = 2;
-const int GROUP_FILES_ARG_INDEX = 3;
-
-const char ARG_VAL_DIV_CHAR = '=';
-const char VAL_VAL_DIV_CHAR = '-';
-
-const int HEX_START = 0x49C;		// Hex address of first byte of first datum in SPA file
-const int HEX_END = 0x036927;		// Hex address of last byte of last datum
-const int SIZE = (HEX_END - HEX_START + 1) / 4;	// Number of data in SPA file (+ 1 includes last byte, / 4 bytes per float)
-const float MAX_WAVENUMBER =  3999.9907;	// inverse cm
-const float MIN_WAVENUMBER = 649.9812;		// inverse cm
+// The SPA layout is owned by libspa (spa.h)
+const int SIZE = spa::NUM_POINTS;	// Number of data in SPA file
+const float MAX_WAVENUMBER = spa::MAX_WAVENUMBER;	// inverse cm
+const float MIN_WAVENUMBER = spa::MIN_WAVENUMBER;	// inverse cm
 const float STEP_SIZE = (MAX_WAVENUMBER - MIN_WAVENUMBER) / (SIZE - 1);	// inverse cm; distance between sequential data 
                                                                         // (- 1 ensures that last datum gets last wavenum)
+const int MAX_ALIGN_SHIFT = 25;     // data points (about 1.5 inverse cm); larger shifts are not searched
 
 int main(int argc, char* argv[])
 {
     // Expected usage of this program:
-    // ./PROG_NAME [-u=<upper bound>] [-l=<lower bound>] [--calculate-const-corr=<bound>-<bound>] [--group-files=<group size>] <SPA filename 1> <SPA filename 2> ...
+    // ./PROG_NAME [-u=<upper bound>] [-l=<lower bound>] [--calculate-const-corr=<bound>-<bound>] [--group-files=<group size>]
+    //     [--aggregate=mean|median|trimmed-mean] [--report-outliers] [--baseline-anchors=<bound>-<bound>,...]
+    //     [--baseline-degree=<degree>] [--threads=<count>] [--als-baseline=<lambda>,<p>] [--als-iterations=<count>]
+    //     [--reference=<SPA filename>] [--convert=absorbance] [--align=<bound>-<bound>]
+    //     [--stage-threads=<read>,<transform>,<format>] [--pipeline-stats] [--report=<file> [--perf-counters]] [--trace=<file>] <SPA filename 1> <SPA filename 2> ...
+    // or, to answer requests from other programs:
+    // ./PROG_NAME --serve=<socket path> [--serve-cache=<MiB>] [--threads=<count>]
+    // or, to keep the outputs up to date as SPA files are acquired:
+    // ./PROG_NAME [options...] --watch=<directory>
+    // -u and -l can be replaced by any number of regions, saved in one pass over each data set:
+    // ./PROG_NAME --region=<bound>-<bound>[:name] [--region=...] [--region-column] [options...] <SPA filename 1> ...
+    // or, to run many jobs (bounds, correction window, groups) over one read of the SPA files:
+    // ./PROG_NAME [options...] --jobs-file=<file> <SPA filename 1> <SPA filename 2> ...
+    // or, to keep the spectra in 16 bits per value when screening many files:
+    // ./PROG_NAME --quantize=float16|int16 [options...] <SPA filename 1> <SPA filename 2> ...
+    // Data sets can be saved compressed instead of as CSV, and turned back into CSV later:
+    // ./PROG_NAME --output-format=csv|spz [options...] <SPA filename 1> <SPA filename 2> ...
+    // ./PROG_NAME --spz-to-csv=<spz file> [--threads=<count>]
+    // Means and correction offsets are summed in an order that does not depend on --threads, either of:
+    // ./PROG_NAME --summation=pairwise|compensated [options...] <SPA filename 1> <SPA filename 2> ...
 
     // Check for 'help' flags
     if(argc < 2)
@@ -52,38 +80,307 @@ int main(int argc, char* argv[])
 	    }
 	}
 
-    const int NUM_OPT_ARGS = 4;
-    const int MAX_OPT_ARG_INDEX = 4;
+    const int NUM_OPT_ARGS = 38;
+    const int MAX_OPT_ARG_INDEX = 38;
 
     bool upperBoundSpecified = false;
     bool lowerBoundSpecified = false;
     bool useConstCorr = false;
     bool groupFiles = false;
+    bool aggregateSpecified = false;
+    bool reportOutliers = false;
+    bool usePolyBaseline = false;
+    bool baselineDegreeSpecified = false;
+    bool threadsSpecified = false;
+    bool useAlsBaseline = false;
+    bool alsIterationsSpecified = false;
+    bool convertSpecified = false;
+    bool useReference = false;
+    bool alignSpectra = false;
+    bool stageThreadsSpecified = false;
+    bool printPipelineStats = false;
+    bool serve = false;
+    bool serveCacheSpecified = false;
+    bool watch = false;
+    bool useCacheDir = false;
+    bool cacheBudgetSpecified = false;
+    bool ioBackendSpecified = false;
+    bool ioDepthSpecified = false;
+    bool useInputDir = false;
+    bool useGlob = false;
+    bool useManifest = false;
+    bool useInputTar = false;
+    bool memoryBudgetSpecified = false;
+    bool writeReport = false;
+    bool writeTraceFile = false;
+    bool usePerfCounters = false;
+    bool useJobsFile = false;
+    bool useRegions = false;
+    bool regionColumn = false;
+    bool quantize = false;
+    bool outputFormatSpecified = false;
+    bool spzToCsv = false;
+    bool summationSpecified = false;
 
     bool* optionalArgs[] = {
         &upperBoundSpecified,
         &lowerBoundSpecified,
         &useConstCorr,
-        &groupFiles
-    }; // NOTE: ordering of these pointers affects *_ARG_INDEX values in this file and parse-command-line-args.cpp
+        &groupFiles,
+        &aggregateSpecified,
+        &reportOutliers,
+        &usePolyBaseline,
+        &baselineDegreeSpecified,
+        &threadsSpecified,
+        &useAlsBaseline,
+        &alsIterationsSpecified,
+        &convertSpecified,
+        &useReference,
+        &alignSpectra,
+        &stageThreadsSpecified,
+        &printPipelineStats,
+        &serve,
+        &serveCacheSpecified,
+        &watch,
+        &useCacheDir,
+        &cacheBudgetSpecified,
+        &ioBackendSpecified,
+        &ioDepthSpecified,
+        &useInputDir,
+        &useGlob,
+        &useManifest,
+        &useInputTar,
+        &memoryBudgetSpecified,
+        &writeReport,
+        &writeTraceFile,
+        &usePerfCounters,
+        &useJobsFile,
+        &useRegions,
+        &regionColumn,
+        &quantize,
+        &outputFormatSpecified,
+        &spzToCsv,
+        &summationSpecified
+    }; // NOTE: ordering of these pointers affects *_ARG_INDEX values in parse-command-line-args.h
 
-    int optionalArgIndices[] = {0,0,0,0};
+    int optionalArgIndices[] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
 
-    bool optionalArgsUsed = 
-        usingOptionalArgs(argc, argv, NUM_OPT_ARGS, optionalArgs, optionalArgIndices);
+    usingOptionalArgs(argc, argv, NUM_OPT_ARGS, optionalArgs, optionalArgIndices);
     
     // Check that SPA filenames are not interspersed between optional arguments 
     // and get the number of optional args specified
     int numOptArgsGiven = checkArgOrder(NUM_OPT_ARGS, optionalArgs, optionalArgIndices, argc, argv);
-    const int NUM_SPA_FILES = argc - (numOptArgsGiven + 1);
+    const int numFileArgs = argc - (numOptArgsGiven + 1);
+    const bool filesGiven = (numFileArgs != 0 || useInputDir || useGlob || useManifest || useInputTar);
 
-    // Get data from SPA files
-    // If no acceptable optional arguments were used, we will assume that all arguments are SPA files, and begin reading them in
-    char** SPA_FILENAME = createSPAFileArray(NUM_SPA_FILES, numOptArgsGiven, argv, "char** SPA_FILENAME");
-    float** IR_DATA = createFloatArray(NUM_SPA_FILES, SIZE, "float** IR_DATA");
+    int numThreads = ( threadsSpecified ?
+        strToInt(getStrAfter(std::string(argv[optionalArgIndices[THREADS_ARG_INDEX]]), ARG_VAL_DIV_CHAR)) : defaultThreadCount() );
+    if(numThreads < 1)
+    {
+        std::cerr << "Error: main(): number of threads must be at least 1.\n";
+        exit(1);
+    }
+    if(summationSpecified) // before --serve and --watch, which average too
+    {
+        std::string modeStr = getStrAfter(std::string(argv[optionalArgIndices[SUMMATION_ARG_INDEX]]), ARG_VAL_DIV_CHAR);
+        SummationMode mode;
+        if(parseSummationMode(modeStr.c_str(), &mode) != spa::OK)
+        {
+            std::cerr << "Error: main(): unknown summation '" << modeStr << "'. Expected pairwise or compensated.\n";
+            exit(1);
+        }
+        setSummationMode(mode);
+    }
+
+    if(watch && (filesGiven || serve || alignSpectra || usePolyBaseline))
+    { // Alignment and the polynomial baseline are not kept up to date incrementally
+        std::cerr << "Error: main(): " << WATCH_STR << " cannot be used with SPA files, " << SERVE_STR << ", "
+            << ALIGN_STR << " or " << BASELINE_ANCHORS_STR << ".\n";
+        exit(1);
+    }
+    if(useJobsFile && (upperBoundSpecified || lowerBoundSpecified || useConstCorr || groupFiles || aggregateSpecified
+        || reportOutliers || usePolyBaseline || watch || serve))
+    { // Each job gives its own bounds, correction window and groups
+        std::cerr << "Error: main(): " << JOBS_FILE_STR << " cannot be used with " << UB_ARG_STR << ", " << LB_ARG_STR << ", "
+            << CONST_CORR_STR << ", " << GROUP_FILES_STR << ", " << AGGREGATE_STR << ", " << REPORT_OUTLIERS_STR << ", "
+            << BASELINE_ANCHORS_STR << ", " << WATCH_STR << " or " << SERVE_STR << "; give them to each job instead.\n";
+        exit(1);
+    }
+    if(useRegions && (upperBoundSpecified || lowerBoundSpecified || useJobsFile || watch || serve))
+    {
+        std::cerr << "Error: main(): " << REGION_STR << " cannot be used with " << UB_ARG_STR << ", " << LB_ARG_STR << ", "
+            << JOBS_FILE_STR << ", " << WATCH_STR << " or " << SERVE_STR << ".\n";
+        exit(1);
+    }
+    if(quantize && (alignSpectra || usePolyBaseline || reportOutliers || useJobsFile || watch || serve))
+    { // These need every spectrum as floats at once
+        std::cerr << "Error: main(): " << QUANTIZE_STR << " cannot be used with " << ALIGN_STR << ", " << BASELINE_ANCHORS_STR << ", "
+            << REPORT_OUTLIERS_STR << ", " << JOBS_FILE_STR << ", " << WATCH_STR << " or " << SERVE_STR << ".\n";
+        exit(1);
+    }
+    if(regionColumn && !useRegions)
+    {
+        std::cerr << "Error: main(): " << REGION_COLUMN_STR << " given without " << REGION_STR << ".\n";
+        exit(1);
+    }
+    if((writeReport || writeTraceFile) && (watch || serve))
+    { // Neither run ends, so there would be no report
+        std::cerr << "Error: main(): " << (writeReport ? REPORT_STR : TRACE_STR) << " cannot be used with "
+            << WATCH_STR << " or " << SERVE_STR << ".\n";
+        exit(1);
+    }
+    if(usePerfCounters && !writeReport)
+    {
+        std::cerr << "Error: main(): " << PERF_COUNTERS_STR << " given without " << REPORT_STR << ".\n";
+        exit(1);
+    }
+    if(usePerfCounters && !openPerfCounters()) // before any other thread starts, so all are counted
+        std::cerr << "Warning: hardware counters are unavailable (" << perfCountersError() << "); the report has times only.\n";
+    if(writeReport) enableRunReport();
+    if(writeTraceFile) enableTrace();
+    if(serveCacheSpecified && !serve)
+    {
+        std::cerr << "Error: main(): " << SERVE_CACHE_STR << " given without " << SERVE_STR << ".\n";
+        exit(1);
+    }
+    if(serve)
+    { // Files are named by each request instead
+        if(filesGiven)
+        {
+            std::cerr << "Error: main(): " << SERVE_STR << " does not take SPA files; name them in requests.\n";
+            exit(1);
+        }
+        int cacheMiB = ( serveCacheSpecified ?
+            strToInt(getStrAfter(std::string(argv[optionalArgIndices[SERVE_CACHE_ARG_INDEX]]), ARG_VAL_DIV_CHAR)) : 256 );
+        if(cacheMiB < 1)
+        {
+            std::cerr << "Error: main(): server cache must be at least 1 MiB.\n";
+            exit(1);
+        }
+        serveRequests(getStrAfter(std::string(argv[optionalArgIndices[SERVE_ARG_INDEX]]), ARG_VAL_DIV_CHAR).c_str(),
+            numThreads, (size_t)cacheMiB << 20);
+        return 0;
+    }
+    if(spzToCsv)
+    { // Rows are formatted against the same wavenumbers as when the data set was computed
+        if(filesGiven)
+        {
+            std::cerr << "Error: main(): " << SPZ_TO_CSV_STR << " does not take SPA files.\n";
+            exit(1);
+        }
+        std::string spzFilename = getStrAfter(std::string(argv[optionalArgIndices[SPZ_TO_CSV_ARG_INDEX]]), ARG_VAL_DIV_CHAR);
+        SpzDataSet dataSet;
+        readSpzDataSet(spzFilename.c_str(), SIZE, &dataSet);
+        std::string csvFilename = ( spzFilename.size() > 4 && spzFilename.compare(spzFilename.size() - 4, 4, ".spz") == 0 ?
+            spzFilename.substr(0, spzFilename.size() - 4) : spzFilename ) + ".CSV";
+        std::vector<float> wavenumber(SIZE);
+        for(int i = 0; i < SIZE; i++)
+            wavenumber[i] = MAX_WAVENUMBER - (STEP_SIZE * i);
+        std::vector<char*> colTitles;
+        std::vector<float*> columns;
+        for(size_t j = 0; j < dataSet.columns.size(); j++)
+        {
+            colTitles.push_back(&dataSet.titles[j][0]);
+            columns.push_back(&dataSet.columns[j][0]);
+        }
+        setCSVOutputStages(numThreads, 4 * numThreads, nullptr, nullptr);
+        printRowsToCSV(csvFilename.c_str(), ( colTitles.empty() ? nullptr : &colTitles[0] ), ( columns.empty() ? nullptr : &columns[0] ),
+            &wavenumber[dataSet.firstIndex], (int)columns.size(), 0, dataSet.numRows - 1);
+        return 0;
+    }
+    if(outputFormatSpecified)
+    {
+        std::string outputFormat = getStrAfter(std::string(argv[optionalArgIndices[OUTPUT_FORMAT_ARG_INDEX]]), ARG_VAL_DIV_CHAR);
+        if(outputFormat != "csv" && outputFormat != "spz")
+        {
+            std::cerr << "Error: main(): unknown output format '" << outputFormat << "'. Expected " << OUTPUT_FORMAT_STR << "=csv|spz.\n";
+            exit(1);
+        }
+        if(outputFormat == "spz" && regionColumn)
+        { // One CSV file of all regions has no counterpart among the .spz files
+            std::cerr << "Error: main(): " << OUTPUT_FORMAT_STR << "=spz cannot be used with " << REGION_COLUMN_STR << ".\n";
+            exit(1);
+        }
+        setSpzOutput(outputFormat == "spz");
+    }
+
+    // If no acceptable optional arguments were used, we will assume that all arguments are SPA files.
+    // Those named by --manifest, then those found by --input-dir or --glob, follow them.
+    std::vector<std::string> inputFiles(argv + numOptArgsGiven + 1, argv + argc);
+    if(useManifest)
+        readManifest(getStrAfter(std::string(argv[optionalArgIndices[MANIFEST_ARG_INDEX]]), ARG_VAL_DIV_CHAR).c_str(), inputFiles);
+    std::string globPattern = ( useGlob ?
+        getStrAfter(std::string(argv[optionalArgIndices[GLOB_ARG_INDEX]]), ARG_VAL_DIV_CHAR) : "" );
+    if(useInputDir) // --glob then picks files by name
+        findSPAFiles(getStrAfter(std::string(argv[optionalArgIndices[INPUT_DIR_ARG_INDEX]]), ARG_VAL_DIV_CHAR).c_str(),
+            ( useGlob ? globPattern.c_str() : nullptr ), numThreads, inputFiles);
+    else if(useGlob)
+        expandGlob(globPattern.c_str(), inputFiles);
+    if(useInputTar)
+    { // Member names could also be paths on disk, so the archive is the only input
+        if(!inputFiles.empty())
+        {
+            std::cerr << "Error: main(): " << INPUT_TAR_STR << " cannot be used with other SPA files.\n";
+            exit(1);
+        }
+        openTarArchive(getStrAfter(std::string(argv[optionalArgIndices[INPUT_TAR_ARG_INDEX]]), ARG_VAL_DIV_CHAR).c_str(), inputFiles);
+    }
+    if(inputFiles.empty() && !watch)
+    { // Every data set needs at least one spectrum
+        std::string sources;
+        auto addSource = [&](const std::string& option, int argIndex)
+        {
+            sources += ( sources.empty() ? "" : ", " ) + option + " '"
+                + getStrAfter(std::string(argv[optionalArgIndices[argIndex]]), ARG_VAL_DIV_CHAR) + "'";
+        };
+        if(useManifest) addSource(MANIFEST_STR, MANIFEST_ARG_INDEX);
+        if(useInputDir) addSource(INPUT_DIR_STR, INPUT_DIR_ARG_INDEX);
+        if(useInputTar) addSource(INPUT_TAR_STR, INPUT_TAR_ARG_INDEX);
+        std::cerr << "Error: main(): no SPA files found in " << ( sources.empty() ? "the arguments" : sources ) << ".\n";
+        exit(1);
+    }
+    const int NUM_SPA_FILES = (int)inputFiles.size();
+    char** SPA_FILENAME = createSPAFileArray(inputFiles, "char** SPA_FILENAME");
+    std::vector<BatchJob> jobs;
+    if(useJobsFile)
+        readJobsFile(getStrAfter(std::string(argv[optionalArgIndices[JOBS_FILE_ARG_INDEX]]), ARG_VAL_DIV_CHAR).c_str(),
+            NUM_SPA_FILES, jobs);
+    QuantizedFormat quantizedFormat = ( quantize ?
+        parseQuantizedFormat(getStrAfter(std::string(argv[optionalArgIndices[QUANTIZE_ARG_INDEX]]), ARG_VAL_DIV_CHAR).c_str()) : QUANTIZE_FLOAT16 );
+    // Quantized spectra are read this many files at a time as floats
+    const int QUANTIZE_CHUNK_FILES = std::min(NUM_SPA_FILES, 256);
 
-    for(int i = 0; i < NUM_SPA_FILES; i++)
-        readSPAFile(SPA_FILENAME[i], IR_DATA[i], SIZE, HEX_START);
+    if(memoryBudgetSpecified)
+    { // Every matrix of spectra kept at once: IR_DATA and, if used, CORR_DATA, BASELINE_CORR_DATA and AVG_DATA,
+      // or those shared by the jobs
+        long long memoryBudget = strToBytes(getStrAfter(std::string(argv[optionalArgIndices[MEMORY_BUDGET_ARG_INDEX]]), ARG_VAL_DIV_CHAR));
+        int groupSizeGiven = ( groupFiles ?
+            strToInt(getStrAfter(std::string(argv[optionalArgIndices[GROUP_FILES_ARG_INDEX]]), ARG_VAL_DIV_CHAR)) : 1 );
+        long long numSpectra = (long long)NUM_SPA_FILES * (1 + (useConstCorr ? 1 : 0) + (usePolyBaseline ? 1 : 0))
+            + ( groupFiles && groupSizeGiven > 0 ? NUM_SPA_FILES / groupSizeGiven : 0 )
+            + ( useJobsFile ? batchJobSpectra(jobs, NUM_SPA_FILES) : 0 );
+        long long matrixBytes = numSpectra * SIZE * (long long)sizeof(float);
+        if(quantize) // 16 bits per value, read through one chunk of floats, and no corrected copy
+            matrixBytes = (long long)NUM_SPA_FILES * SIZE * (long long)sizeof(uint16_t)
+                + (numSpectra - NUM_SPA_FILES * (useConstCorr ? 2 : 1) + QUANTIZE_CHUNK_FILES) * SIZE * (long long)sizeof(float);
+        if(matrixBytes > memoryBudget)
+        { // Scratch files go to $TMPDIR, or next to the output files
+            const char* tmpdir = std::getenv("TMPDIR");
+            std::string scratchDirectory = ( tmpdir && *tmpdir ? tmpdir : "." );
+            std::cerr << "Spectra need " << (matrixBytes >> 20) << " MiB, more than " << MEMORY_BUDGET_STR
+                << "; keeping them in scratch files in '" << scratchDirectory << "'.\n";
+            if(!useScratchMatrices(scratchDirectory))
+            {
+                std::cerr << "Error: int main(int, char* []): the spectra do not fit in --memory-budget, "
+                    << "and scratch-file matrices are not supported by this build.\n";
+                exit(1);
+            }
+        }
+    }
+    float** IR_DATA = ( quantize ?
+        nullptr : createFloatArray(NUM_SPA_FILES, SIZE, "float** IR_DATA") );
+    QuantizedSpectra* QUANTIZED_DATA = ( quantize ?
+        createQuantizedSpectra(quantizedFormat, NUM_SPA_FILES, SIZE, "QuantizedSpectra* QUANTIZED_DATA") : nullptr );
 
 	float WAVENUMBER[SIZE]; // Array to store corresponding wavenumber (assumed to be the same for all input files)
     
@@ -100,12 +397,23 @@ int main(int argc, char* argv[])
 
     int numGroups = NUM_SPA_FILES / groupSize;
 
+    AggregateMode aggregateMode = ( aggregateSpecified ?
+        parseAggregateMode(getStrAfter(std::string(argv[optionalArgIndices[AGGREGATE_ARG_INDEX]]), ARG_VAL_DIV_CHAR).c_str()) : AGGREGATE_MEAN );
+    if((aggregateSpecified || reportOutliers) && !groupFiles)
+    {
+        std::cerr << "Error: main(): " << (aggregateSpecified ? AGGREGATE_STR : REPORT_OUTLIERS_STR) << " given without " << GROUP_FILES_STR << ".\n";
+        exit(1);
+    }
+    const std::string AGG_PREFIX = aggregatePrefix(aggregateMode);
+
     char** AVG_DATA_COL_TITLES = ( groupFiles ?
         createAvgDataColTitles(numGroups, groupSize, SPA_FILENAME, "char** AVG_DATA_COL_TITLES") : nullptr );
     float** AVG_DATA = ( groupFiles ?
         createFloatArray(numGroups, SIZE, "float** AVG_DATA") : nullptr );
-    float** CORR_DATA = ( useConstCorr ?
+    float** CORR_DATA = ( useConstCorr && !quantize ?
         createFloatArray(NUM_SPA_FILES, SIZE, "float** CORR_DATA") : nullptr );
+    float* CORR_OFFSETS = ( useConstCorr && quantize ? new (std::nothrow) float [NUM_SPA_FILES] : nullptr );
+    if(useConstCorr && quantize) checkIfNull(CORR_OFFSETS, "int main(int, char* [])", "float* CORR_OFFSETS");
     
     std::string ubStr = ( upperBoundSpecified ?
         getStrAfter(std::string(argv[optionalArgIndices[UB_ARG_INDEX]]), ARG_VAL_DIV_CHAR) : "NULL_STRING" );
@@ -127,113 +435,540 @@ int main(int argc, char* argv[])
         strToInt(getStrAfter(getStrAfter(std::string(argv[optionalArgIndices[CONST_CORR_ARG_INDEX]]), ARG_VAL_DIV_CHAR), VAL_VAL_DIV_CHAR)) : 0 );
     if(useConstCorr) checkBound(&ubCorr, &lbCorr, MAX_WAVENUMBER, MIN_WAVENUMBER);
 
-    // Output requested data
-    if(optionalArgsUsed)
-    {
-    	//cout << "Outputting requested data: optionalArgsUsed has value of " << (optionalArgsUsed ? "True" : "False") << endl;
-        if(upperBoundSpecified && lowerBoundSpecified)
-        { // SCENARIO: both bounds given
-            // Create raw data CSV
-            const char* RAW_CSV_FILENAME = createCSVFilename("combinedRawData", ubStr, lbStr);
-            printToCSV(RAW_CSV_FILENAME, SPA_FILENAME, IR_DATA, WAVENUMBER, NUM_SPA_FILES, SIZE, upperBound, lowerBound);
-            // Create averaged data CSV if specified
-            if(groupFiles)
-            {
-                computeAverages(AVG_DATA, IR_DATA, numGroups, groupSize, SIZE);
-                const char* AVG_CSV_FILENAME = createCSVFilename("averagedData", ubStr, lbStr);
-                printToCSV(AVG_CSV_FILENAME, AVG_DATA_COL_TITLES, AVG_DATA, WAVENUMBER, numGroups, SIZE, upperBound, lowerBound);
-            }
-            // Create corrected data CSV if specified
-            if(useConstCorr)
-            {
-                computeConstCorr(CORR_DATA, IR_DATA, NUM_SPA_FILES, WAVENUMBER, SIZE, ubCorr, lbCorr);
-                const char* CORR_CSV_FILENAME = createCSVFilename("constCorrData", ubStr, lbStr);
-                printToCSV(CORR_CSV_FILENAME, SPA_FILENAME, CORR_DATA, WAVENUMBER, NUM_SPA_FILES, SIZE, upperBound, lowerBound);
-            }
-            // Create corrected averaged data if specified
-            if(useConstCorr && groupFiles)
-            {
-                computeAverages(AVG_DATA, CORR_DATA, numGroups, groupSize, SIZE);
-                const char* AVG_CORR_CSV_FILENAME = createCSVFilename("averagedCorrData", ubStr, lbStr);
-                printToCSV(AVG_CORR_CSV_FILENAME, AVG_DATA_COL_TITLES, AVG_DATA, WAVENUMBER, numGroups, SIZE, upperBound, lowerBound);
+    // Regions are resolved to rows once; every data set is then saved over all of them
+    std::vector<CSVRegion> regions;
+    if(useRegions)
+    { // Each given as <bound>-<bound>[:name]; the name defaults to the bounds as given
+        std::vector<int> regionArgIndices = findArgIndices(argc, argv, REGION_STR);
+        for(size_t r = 0; r < regionArgIndices.size(); r++)
+        {
+            std::string regionStr = getStrAfter(std::string(argv[regionArgIndices[r]]), ARG_VAL_DIV_CHAR);
+            std::string boundsStr = truncateStrAt(regionStr, REGION_NAME_DIV_CHAR);
+            std::string name = ( regionStr.size() > boundsStr.size() ? regionStr.substr(boundsStr.size() + 1) : boundsStr );
+            int ubRegion = strToInt(truncateStrAt(boundsStr, VAL_VAL_DIV_CHAR));
+            int lbRegion = strToInt(getStrAfter(boundsStr, VAL_VAL_DIV_CHAR));
+            checkBound(&ubRegion, &lbRegion, MAX_WAVENUMBER, MIN_WAVENUMBER);
+            bool validName = !name.empty();
+            for(size_t c = 0; c < name.size(); c++)
+                if(!std::isalnum((unsigned char)name[c]) && name[c] != '.' && name[c] != '_' && name[c] != '-') validName = false;
+            for(size_t other = 0; other < regions.size(); other++)
+                if(regions[other].name == name)
+                {
+                    std::cerr << "Error: main(): region name '" << name << "' is used more than once.\n";
+                    exit(1);
+                }
+            if(!validName)
+            { // The name is part of the file names
+                std::cerr << "Error: main(): region name '" << name << "' may only have letters, digits, '.', '_' and '-'.\n";
+                exit(1);
             }
+            CSVRegion region = {name, wavenumToIndex(ubRegion, WAVENUMBER, SIZE), wavenumToIndex(lbRegion, WAVENUMBER, SIZE)};
+            regions.push_back(region);
         }
-        else if (upperBoundSpecified || lowerBoundSpecified)
-        { // SCENARIO: one bound given
-            std::string boundStr = ( upperBoundSpecified ? (std::string(".upperBound.") + ubStr) : (std::string(".lowerBound.") + lbStr) );
-            int bound = ( upperBoundSpecified ? upperBound : lowerBound );
-            const char* RAW_CSV_FILENAME = (std::string("combinedRawData") + boundStr + std::string(".CSV")).c_str();
-            printToCSV(RAW_CSV_FILENAME, SPA_FILENAME, IR_DATA, WAVENUMBER, NUM_SPA_FILES, SIZE, bound, upperBoundSpecified);
+        setCSVRegions(regions, regionColumn);
+    }
 
-            if(groupFiles)
-            {
-                computeAverages(AVG_DATA, IR_DATA, numGroups, groupSize, SIZE);
-                const char* AVG_CSV_FILENAME = (std::string("averagedData") + boundStr + std::string(".CSV")).c_str();
-                printToCSV(AVG_CSV_FILENAME, AVG_DATA_COL_TITLES, AVG_DATA, WAVENUMBER, numGroups, SIZE, bound, upperBoundSpecified);
-            }
+    if(cacheBudgetSpecified && !useCacheDir)
+    {
+        std::cerr << "Error: main(): " << CACHE_BUDGET_STR << " given without " << CACHE_DIR_STR << ".\n";
+        exit(1);
+    }
+    if(useCacheDir && useInputTar)
+    { // Members are decoded straight from the mapped archive, which is as fast as the cache
+        std::cerr << "Warning: " << INPUT_TAR_STR << " is read through memory; ignoring " << CACHE_DIR_STR << ".\n";
+        useCacheDir = false;
+    }
+    if(useCacheDir)
+    {
+        int cacheBudgetMiB = ( cacheBudgetSpecified ?
+            strToInt(getStrAfter(std::string(argv[optionalArgIndices[CACHE_BUDGET_ARG_INDEX]]), ARG_VAL_DIV_CHAR)) : 1024 );
+        if(cacheBudgetMiB < 1)
+        {
+            std::cerr << "Error: main(): cache budget must be at least 1 MiB.\n";
+            exit(1);
+        }
+        setConversionCache(getStrAfter(std::string(argv[optionalArgIndices[CACHE_DIR_ARG_INDEX]]), ARG_VAL_DIV_CHAR).c_str(),
+            (size_t)cacheBudgetMiB << 20);
+    }
 
-            if(useConstCorr)
-            {
-                computeConstCorr(CORR_DATA, IR_DATA, NUM_SPA_FILES, WAVENUMBER, SIZE, ubCorr, lbCorr);
-                const char* CORR_CSV_FILENAME = (std::string("constCorrData") + boundStr + std::string(".CSV")).c_str();
-                printToCSV(CORR_CSV_FILENAME, SPA_FILENAME, CORR_DATA, WAVENUMBER, NUM_SPA_FILES, SIZE, bound, upperBoundSpecified);
-            }
+    // Threads per pipeline stage; each defaults to --threads
+    int readThreads = numThreads;
+    int transformThreads = numThreads;
+    int formatThreads = numThreads;
+    if(stageThreadsSpecified)
+    { // Given as <read>,<transform>,<format>
+        std::vector<std::string> stageThreads = splitStrAt(
+            getStrAfter(std::string(argv[optionalArgIndices[STAGE_THREADS_ARG_INDEX]]), ARG_VAL_DIV_CHAR), ',');
+        if(stageThreads.size() != 3)
+        {
+            std::cerr << "Error: main(): expected " << STAGE_THREADS_STR << "=<read>,<transform>,<format>.\n";
+            exit(1);
+        }
+        readThreads = strToInt(stageThreads[0]);
+        transformThreads = strToInt(stageThreads[1]);
+        formatThreads = strToInt(stageThreads[2]);
+        if(readThreads < 1 || transformThreads < 1 || formatThreads < 1)
+        {
+            std::cerr << "Error: main(): every pipeline stage needs at least 1 thread.\n";
+            exit(1);
+        }
+    }
 
-            if(useConstCorr && groupFiles)
-            {
-                computeAverages(AVG_DATA, CORR_DATA, numGroups, groupSize, SIZE);
-                const char* AVG_CORR_CSV_FILENAME = (std::string("averagedCorrData") + boundStr + std::string(".CSV")).c_str();
-                printToCSV(AVG_CORR_CSV_FILENAME, AVG_DATA_COL_TITLES, AVG_DATA, WAVENUMBER, numGroups, SIZE, bound, upperBoundSpecified);
-            }
+    // Files read at once by the io_uring backend; 0 reads them with the read threads
+    int ioUringDepth = 0;
+    if(ioDepthSpecified && !ioBackendSpecified)
+    {
+        std::cerr << "Error: main(): " << IO_DEPTH_STR << " given without " << IO_BACKEND_STR << "=io_uring.\n";
+        exit(1);
+    }
+    if(ioBackendSpecified)
+    {
+        std::string ioBackend = getStrAfter(std::string(argv[optionalArgIndices[IO_BACKEND_ARG_INDEX]]), ARG_VAL_DIV_CHAR);
+        if(ioBackend == "io_uring")
+            ioUringDepth = ( ioDepthSpecified ?
+                strToInt(getStrAfter(std::string(argv[optionalArgIndices[IO_DEPTH_ARG_INDEX]]), ARG_VAL_DIV_CHAR)) : 64 );
+        else if(ioBackend != "sync")
+        {
+            std::cerr << "Error: main(): unknown I/O backend '" << ioBackend << "'. Expected " << IO_BACKEND_STR << "=sync|io_uring.\n";
+            exit(1);
+        }
+        if(ioBackend == "io_uring" && ioUringDepth < 1)
+        {
+            std::cerr << "Error: main(): I/O depth must be at least 1.\n";
+            exit(1);
+        }
+        if(ioUringDepth > 0 && useCacheDir)
+        { // Cached spectra are not read from their SPA files
+            std::cerr << "Warning: " << CACHE_DIR_STR << " reads through the cache; ignoring " << IO_BACKEND_STR << "=io_uring.\n";
+            ioUringDepth = 0;
+        }
+        if(ioUringDepth > 0 && useInputTar)
+        { // Members are decoded from the mapped archive; there is nothing to read
+            std::cerr << "Warning: " << INPUT_TAR_STR << " is read through memory; ignoring " << IO_BACKEND_STR << "=io_uring.\n";
+            ioUringDepth = 0;
         }
+    }
+    // One thread drives io_uring; readThreads still read synchronously if it is unavailable
+    StageStats readStats("read", ( ioUringDepth > 0 ? 1 : readThreads ));
+    StageStats transformStats("transform", transformThreads);
+    StageStats formatStats("format", formatThreads);
+    StageStats writeStats("write", 1);
+    setCSVOutputStages(formatThreads, 4 * formatThreads, &formatStats, &writeStats);
+
+    if(convertSpecified)
+    {
+        std::string convertTo = getStrAfter(std::string(argv[optionalArgIndices[CONVERT_ARG_INDEX]]), ARG_VAL_DIV_CHAR);
+        if(convertTo != "absorbance")
+        {
+            std::cerr << "Error: main(): unknown conversion '" << convertTo << "'. Expected " << CONVERT_STR << "=absorbance.\n";
+            exit(1);
+        }
+    }
+    std::string referenceFilename = ( useReference ?
+        getStrAfter(std::string(argv[optionalArgIndices[REFERENCE_ARG_INDEX]]), ARG_VAL_DIV_CHAR) : "NULL_STRING" );
+
+    int ubAlign = ( alignSpectra ?
+        strToInt(truncateStrAt(getStrAfter(std::string(argv[optionalArgIndices[ALIGN_ARG_INDEX]]), ARG_VAL_DIV_CHAR), VAL_VAL_DIV_CHAR)) : 0 );
+    int lbAlign = ( alignSpectra ?
+        strToInt(getStrAfter(getStrAfter(std::string(argv[optionalArgIndices[ALIGN_ARG_INDEX]]), ARG_VAL_DIV_CHAR), VAL_VAL_DIV_CHAR)) : 0 );
+    if(alignSpectra) checkBound(&ubAlign, &lbAlign, MAX_WAVENUMBER, MIN_WAVENUMBER);
+
+    if(alsIterationsSpecified && !useAlsBaseline)
+    {
+        std::cerr << "Error: main(): " << ALS_ITERATIONS_STR << " given without " << ALS_BASELINE_STR << ".\n";
+        exit(1);
+    }
+    double alsLambda = 0;
+    double alsAsymmetry = 0;
+    if(useAlsBaseline)
+    { // Given as <lambda>,<p>
+        std::vector<std::string> alsParams = splitStrAt(
+            getStrAfter(std::string(argv[optionalArgIndices[ALS_BASELINE_ARG_INDEX]]), ARG_VAL_DIV_CHAR), ',');
+        if(alsParams.size() != 2)
+        {
+            std::cerr << "Error: main(): expected " << ALS_BASELINE_STR << "=<lambda>,<p>.\n";
+            exit(1);
+        }
+        alsLambda = strToDouble(alsParams[0]);
+        alsAsymmetry = strToDouble(alsParams[1]);
+        if(alsLambda <= 0 || alsAsymmetry <= 0 || alsAsymmetry >= 1)
+        {
+            std::cerr << "Error: main(): ALS baseline needs lambda > 0 and 0 < p < 1.\n";
+            exit(1);
+        }
+    }
+    int alsIterations = ( alsIterationsSpecified ?
+        strToInt(getStrAfter(std::string(argv[optionalArgIndices[ALS_ITERATIONS_ARG_INDEX]]), ARG_VAL_DIV_CHAR)) : 10 );
+    if(alsIterations < 1)
+    {
+        std::cerr << "Error: main(): number of ALS iterations must be at least 1.\n";
+        exit(1);
+    }
+
+    if(baselineDegreeSpecified && !usePolyBaseline)
+    {
+        std::cerr << "Error: main(): " << BASELINE_DEGREE_STR << " given without " << BASELINE_ANCHORS_STR << ".\n";
+        exit(1);
+    }
+    int baselineDegree = ( baselineDegreeSpecified ?
+        strToInt(getStrAfter(std::string(argv[optionalArgIndices[BASELINE_DEGREE_ARG_INDEX]]), ARG_VAL_DIV_CHAR)) : 1 );
+    PolyBaselinePlan* polyBaselinePlan = nullptr;
+    float** BASELINE_CORR_DATA = nullptr;
+    if(usePolyBaseline)
+    { // Anchor windows are given as <bound>-<bound>,<bound>-<bound>,...
+        std::vector<std::string> windows = splitStrAt(
+            getStrAfter(std::string(argv[optionalArgIndices[BASELINE_ANCHORS_ARG_INDEX]]), ARG_VAL_DIV_CHAR), ',');
+        std::vector<int> anchorBounds;
+        for(size_t w = 0; w < windows.size(); w++)
+        {
+            int ubAnchor = strToInt(truncateStrAt(windows[w], VAL_VAL_DIV_CHAR));
+            int lbAnchor = strToInt(getStrAfter(windows[w], VAL_VAL_DIV_CHAR));
+            checkBound(&ubAnchor, &lbAnchor, MAX_WAVENUMBER, MIN_WAVENUMBER);
+            anchorBounds.push_back(ubAnchor);
+            anchorBounds.push_back(lbAnchor);
+        }
+        if(baselineDegree < 0 || baselineDegree > MAX_POLY_DEGREE)
+        {
+            std::cerr << "Error: main(): " << BASELINE_DEGREE_STR << " must be between 0 and " << MAX_POLY_DEGREE << ".\n";
+            exit(1);
+        }
+        spa::Result<PolyBaselinePlan*> plan = createPolyBaselinePlan(baselineDegree, &anchorBounds[0], (int)windows.size(), WAVENUMBER, SIZE);
+        checkStatus(plan.status(), "int main(int, char* [])", std::string(BASELINE_ANCHORS_STR) + " with a degree " + std::to_string(baselineDegree) + " polynomial");
+        polyBaselinePlan = plan.value();
+        BASELINE_CORR_DATA = createFloatArray(NUM_SPA_FILES, SIZE, "float** BASELINE_CORR_DATA");
+    }
+
+    // Read the SPA files and transform the spectra in place before anything else looks at them:
+    // ratio against the reference, convert to absorbance, align, then remove the ALS baseline.
+    // Each file is transformed as soon as it has been read, except that alignment needs the
+    // first spectrum in its final form, so when aligning the ALS baseline waits for it.
+    float* REFERENCE_DATA = nullptr;
+    if(useReference)
+    {
+        REFERENCE_DATA = new (std::nothrow) float [SIZE];
+        checkIfNull(REFERENCE_DATA, "int main(int, char* [])", "float* REFERENCE_DATA");
+        // Always a file on disk, even when the spectra come from --input-tar
+        spa::Status status = spa::readSpectrumData(referenceFilename.c_str(), REFERENCE_DATA);
+        if(status != spa::OK)
+        {
+            std::cerr << "Error: main(): reference SPA file '" << referenceFilename << "': " << spa::statusMessage(status) << ".\n";
+            exit(1);
+        }
+        int badIndex = findNonPositive(REFERENCE_DATA, SIZE);
+        if(badIndex != -1)
+        {
+            std::cerr << "Error: main(): reference spectrum '" << referenceFilename
+                << "' has a non-positive value at index " << badIndex << ".\n";
+            exit(1);
+        }
+    }
+    if(watch)
+    {
+        WatchOptions watchOptions = {upperBoundSpecified, lowerBoundSpecified, upperBound, lowerBound, ubStr, lbStr,
+            groupFiles, groupSize, aggregateMode, reportOutliers, useConstCorr, ubCorr, lbCorr,
+            REFERENCE_DATA, convertSpecified, useAlsBaseline, alsLambda, alsAsymmetry, alsIterations, numThreads};
+        watchDirectory(getStrAfter(std::string(argv[optionalArgIndices[WATCH_ARG_INDEX]]), ARG_VAL_DIV_CHAR).c_str(),
+            watchOptions, WAVENUMBER);
+    }
+    // With a window and only pointwise stages, read just the window (and the const-corr window)
+    // from each file; alignment and both baselines look at the whole spectrum, and the cache
+    // stores whole spectra
+    if((upperBoundSpecified || lowerBoundSpecified) && !alignSpectra && !useAlsBaseline && !usePolyBaseline && !useCacheDir)
+    {
+        int firstIndex[] = {
+            ( upperBoundSpecified ? wavenumToIndex(upperBound, WAVENUMBER, SIZE) : 0 ),
+            ( useConstCorr ? wavenumToIndex(ubCorr, WAVENUMBER, SIZE) : 0 ) };
+        int lastIndex[] = {
+            ( lowerBoundSpecified ? wavenumToIndex(lowerBound, WAVENUMBER, SIZE) : SIZE - 1 ),
+            ( useConstCorr ? wavenumToIndex(lbCorr, WAVENUMBER, SIZE) : 0 ) };
+        setSpectrumReadRanges(firstIndex, lastIndex, ( useConstCorr ? 2 : 1 ));
+    }
+    if(useRegions && !alignSpectra && !useAlsBaseline && !usePolyBaseline && !useCacheDir)
+    {
+        std::vector<int> firstIndex, lastIndex;
+        for(size_t r = 0; r < regions.size(); r++)
+        {
+            firstIndex.push_back(regions[r].firstIndex);
+            lastIndex.push_back(regions[r].lastIndex);
+        }
+        if(useConstCorr)
+        {
+            firstIndex.push_back(wavenumToIndex(ubCorr, WAVENUMBER, SIZE));
+            lastIndex.push_back(wavenumToIndex(lbCorr, WAVENUMBER, SIZE));
+        }
+        setSpectrumReadRanges(&firstIndex[0], &lastIndex[0], (int)firstIndex.size());
+    }
+    std::vector<int> jobFirstIndex, jobLastIndex;
+    if(useJobsFile && !alignSpectra && !useAlsBaseline && !useCacheDir
+        && batchJobReadRanges(jobs, WAVENUMBER, SIZE, jobFirstIndex, jobLastIndex))
+        setSpectrumReadRanges(&jobFirstIndex[0], &jobLastIndex[0], (int)jobFirstIndex.size());
+    const bool alsWhileReading = useAlsBaseline && !alignSpectra;
+    std::vector<AlsWorkspace*> alsWorkspaces;
+    if(alsWhileReading)
+        for(int t = 0; t < transformThreads; t++)
+        {
+            alsWorkspaces.push_back(createAlsWorkspace(SIZE));
+            checkIfNull(alsWorkspaces.back(), "int main(int, char* [])", "AlsWorkspace* alsWorkspaces[t]");
+        }
+
+    auto transformSpectrum = [&](float* spectrum, int thread)
+    {
+        if(useReference) ratioSpectrumToReference(spectrum, REFERENCE_DATA, SIZE);
+        if(convertSpecified) convertSpectrumToAbsorbance(spectrum, SIZE);
+        if(alsWhileReading) subtractAlsBaseline(spectrum, alsWorkspaces[thread], alsLambda, alsAsymmetry, alsIterations);
+    };
+    {
+        ReportStage reportStage("read", ( ioUringDepth > 0 ? "io_uring" : "sync" ));
+        if(!quantize)
+            ingestSpectra(SPA_FILENAME, IR_DATA, NUM_SPA_FILES, readThreads, ioUringDepth, transformThreads, 4 * transformThreads,
+                [&](int file, int thread) { transformSpectrum(IR_DATA[file], thread); },
+                &readStats, &transformStats);
         else
-        { // SCENARIO: no bounds given
-            const char* RAW_CSV_FILENAME = "combinedRawData.fullSpectrum.CSV";
-            printToCSV(RAW_CSV_FILENAME, SPA_FILENAME, IR_DATA, WAVENUMBER, NUM_SPA_FILES, SIZE);
+        { // Each chunk of files is read as floats, and each spectrum stored once it is transformed.
+          // Rows outside the read ranges are left 0 (or, converted to absorbance, huge), so only
+          // the read ranges set an int16 spectrum's range and its error.
+            std::vector<int> quantizeFirstIndex, quantizeLastIndex;
+            getSpectrumReadRanges(quantizeFirstIndex, quantizeLastIndex);
+            float** CHUNK_DATA = createFloatArray(QUANTIZE_CHUNK_FILES, SIZE, "float** CHUNK_DATA");
+            for(int file = 0; file < QUANTIZE_CHUNK_FILES; file++)
+                for(int i = 0; i < SIZE; i++)
+                    CHUNK_DATA[file][i] = 0;
+            for(int first = 0; first < NUM_SPA_FILES; first += QUANTIZE_CHUNK_FILES)
+                ingestSpectra(SPA_FILENAME + first, CHUNK_DATA, std::min(QUANTIZE_CHUNK_FILES, NUM_SPA_FILES - first),
+                    readThreads, ioUringDepth, transformThreads, 4 * transformThreads,
+                    [&](int file, int thread)
+                    {
+                        transformSpectrum(CHUNK_DATA[file], thread);
+                        quantizeSpectrum(QUANTIZED_DATA, first + file, CHUNK_DATA[file],
+                            &quantizeFirstIndex[0], &quantizeLastIndex[0], (int)quantizeFirstIndex.size());
+                    },
+                    &readStats, &transformStats);
+            freeFloatArray(CHUNK_DATA, QUANTIZE_CHUNK_FILES);
+            std::cerr << "Spectra quantized to " << quantizedFormatName(quantizedFormat) << ": "
+                << (((long long)NUM_SPA_FILES * SIZE * (long long)sizeof(uint16_t)) >> 20) << " MiB instead of "
+                << (((long long)NUM_SPA_FILES * SIZE * (long long)sizeof(float)) >> 20) << " MiB, largest error "
+                << largestQuantizationError(QUANTIZED_DATA) << ".\n";
+        }
+        // Spectrum data read from each file: its read ranges
+        std::vector<int> firstRead, lastRead;
+        getSpectrumReadRanges(firstRead, lastRead);
+        long long valuesRead = 0;
+        for(size_t r = 0; r < firstRead.size(); r++)
+            valuesRead += lastRead[r] - firstRead[r] + 1;
+        reportStage.addFiles(NUM_SPA_FILES);
+        reportStage.addBytesRead(NUM_SPA_FILES * valuesRead * (long long)sizeof(float));
+    }
+
+    if(useCacheDir) trimConversionCache();
+    delete[] REFERENCE_DATA;
+    for(size_t t = 0; t < alsWorkspaces.size(); t++)
+        deleteAlsWorkspace(alsWorkspaces[t]);
 
-            if(groupFiles)
+    if(alignSpectra)
+    { // Line every spectrum up with the first one over the alignment window
+        ReportStage reportStage("align");
+        reportStage.addFiles(NUM_SPA_FILES);
+        float* shifts = new (std::nothrow) float [NUM_SPA_FILES];
+        float* alignReference = new (std::nothrow) float [SIZE];
+        checkIfNull(shifts, "int main(int, char* [])", "float* shifts");
+        checkIfNull(alignReference, "int main(int, char* [])", "float* alignReference");
+        for(int i = 0; i < SIZE; i++)
+            alignReference[i] = IR_DATA[0][i];
+        checkStatus(estimateShifts(shifts, IR_DATA, NUM_SPA_FILES, SIZE, alignReference,
+            wavenumToIndex(ubAlign, WAVENUMBER, SIZE), wavenumToIndex(lbAlign, WAVENUMBER, SIZE), MAX_ALIGN_SHIFT, numThreads),
+            "int main(int, char* [])", "estimating the --align shifts");
+        for(int file = 0; file < NUM_SPA_FILES; file++)
+            if(std::isnan(shifts[file]))
             {
-                computeAverages(AVG_DATA, IR_DATA, numGroups, groupSize, SIZE);
-                const char* AVG_CSV_FILENAME = "averagedData.fullSpectrum.CSV";
-                printToCSV(AVG_CSV_FILENAME, AVG_DATA_COL_TITLES, AVG_DATA, WAVENUMBER, numGroups, SIZE);
+                std::cerr << "Warning: int main(int, char* []): spectrum " << file + 1 << " does not match the reference within "
+                    << MAX_ALIGN_SHIFT << " points; it is left unshifted.\n";
+                shifts[file] = 0;
             }
+        checkStatus(applyShifts(IR_DATA, NUM_SPA_FILES, SIZE, shifts, numThreads), "int main(int, char* [])", "applying the --align shifts");
+        printAlignmentShifts("alignmentShifts.CSV", SPA_FILENAME, shifts, STEP_SIZE, NUM_SPA_FILES);
+        delete[] shifts;
+        delete[] alignReference;
+    }
+    if(useAlsBaseline && !alsWhileReading)
+    {
+        ReportStage reportStage("als-baseline");
+        reportStage.addFiles(NUM_SPA_FILES);
+        checkStatus(applyAlsBaseline(IR_DATA, NUM_SPA_FILES, SIZE, alsLambda, alsAsymmetry, alsIterations, numThreads),
+            "int main(int, char* [])", "subtracting the ALS baseline");
+    }
 
-            if(useConstCorr)
+    // Output requested data
+    if(useJobsFile)
+    { // The jobs' files are written in parallel, so each is formatted by one thread
+        setCSVOutputStages(1, 4, &formatStats, &writeStats);
+        runBatchJobs(jobs, SPA_FILENAME, IR_DATA, NUM_SPA_FILES, WAVENUMBER, SIZE, numThreads);
+    }
+    else if(quantize)
+        printQuantizedDataSet("combinedRawData", SPA_FILENAME, QUANTIZED_DATA, nullptr, WAVENUMBER,
+            upperBoundSpecified, lowerBoundSpecified, upperBound, lowerBound, ubStr, lbStr);
+    else
+        printDataSet("combinedRawData", SPA_FILENAME, IR_DATA, NUM_SPA_FILES, WAVENUMBER,
+            upperBoundSpecified, lowerBoundSpecified, upperBound, lowerBound, ubStr, lbStr);
+    // Create averaged data CSV if specified
+    if(groupFiles)
+    {
+        {
+            ReportStage reportStage("aggregate", (AGG_PREFIX + "Data").c_str());
+            reportStage.addFiles(NUM_SPA_FILES);
+            if(quantize)
+                computeQuantizedAggregate(AVG_DATA, QUANTIZED_DATA, nullptr, numGroups, groupSize, aggregateMode, numThreads);
+            else
+                checkStatus(computeAggregate(AVG_DATA, IR_DATA, numGroups, groupSize, SIZE, aggregateMode),
+                    "int main(int, char* [])", AGG_PREFIX + "Data");
+        }
+        printDataSet(AGG_PREFIX + "Data", AVG_DATA_COL_TITLES, AVG_DATA, numGroups, WAVENUMBER,
+            upperBoundSpecified, lowerBoundSpecified, upperBound, lowerBound, ubStr, lbStr);
+    }
+    // Create corrected data CSV if specified
+    if(useConstCorr)
+    {
+        {
+            ReportStage reportStage("const-corr", "constCorrData");
+            reportStage.addFiles(NUM_SPA_FILES);
+            if(quantize) // Only the offsets are kept; they are added as the spectra are decoded
+                computeQuantizedConstCorrOffsets(CORR_OFFSETS, QUANTIZED_DATA, WAVENUMBER, ubCorr, lbCorr);
+            else
+                checkStatus(computeConstCorr(CORR_DATA, IR_DATA, NUM_SPA_FILES, WAVENUMBER, SIZE, ubCorr, lbCorr),
+                    "int main(int, char* [])", "constCorrData");
+        }
+        if(quantize)
+            printQuantizedDataSet("constCorrData", SPA_FILENAME, QUANTIZED_DATA, CORR_OFFSETS, WAVENUMBER,
+                upperBoundSpecified, lowerBoundSpecified, upperBound, lowerBound, ubStr, lbStr);
+        else
+            printDataSet("constCorrData", SPA_FILENAME, CORR_DATA, NUM_SPA_FILES, WAVENUMBER,
+                upperBoundSpecified, lowerBoundSpecified, upperBound, lowerBound, ubStr, lbStr);
+    }
+    // Create corrected averaged data if specified
+    if(useConstCorr && groupFiles)
+    {
+        {
+            ReportStage reportStage("aggregate", (AGG_PREFIX + "CorrData").c_str());
+            reportStage.addFiles(NUM_SPA_FILES);
+            if(quantize)
+                computeQuantizedAggregate(AVG_DATA, QUANTIZED_DATA, CORR_OFFSETS, numGroups, groupSize, aggregateMode, numThreads);
+            else
+                checkStatus(computeAggregate(AVG_DATA, CORR_DATA, numGroups, groupSize, SIZE, aggregateMode),
+                    "int main(int, char* [])", AGG_PREFIX + "CorrData");
+        }
+        printDataSet(AGG_PREFIX + "CorrData", AVG_DATA_COL_TITLES, AVG_DATA, numGroups, WAVENUMBER,
+            upperBoundSpecified, lowerBoundSpecified, upperBound, lowerBound, ubStr, lbStr);
+    }
+    // Create polynomial-baseline corrected data CSVs if specified
+    if(usePolyBaseline)
+    {
+        {
+            ReportStage reportStage("poly-baseline", "baselineCorrData");
+            reportStage.addFiles(NUM_SPA_FILES);
+            computePolyBaselineCorr(BASELINE_CORR_DATA, IR_DATA, NUM_SPA_FILES, WAVENUMBER, SIZE, polyBaselinePlan, numThreads);
+        }
+        printDataSet("baselineCorrData", SPA_FILENAME, BASELINE_CORR_DATA, NUM_SPA_FILES, WAVENUMBER,
+            upperBoundSpecified, lowerBoundSpecified, upperBound, lowerBound, ubStr, lbStr);
+        if(groupFiles)
+        {
             {
-                computeConstCorr(CORR_DATA, IR_DATA, NUM_SPA_FILES, WAVENUMBER, SIZE, ubCorr, lbCorr);
-                const char* CORR_CSV_FILENAME = "constCorrData.fullSpectrum.CSV";
-                printToCSV(CORR_CSV_FILENAME, SPA_FILENAME, CORR_DATA, WAVENUMBER, NUM_SPA_FILES, SIZE);
+                ReportStage reportStage("aggregate", (AGG_PREFIX + "BaselineCorrData").c_str());
+                reportStage.addFiles(NUM_SPA_FILES);
+                checkStatus(computeAggregate(AVG_DATA, BASELINE_CORR_DATA, numGroups, groupSize, SIZE, aggregateMode),
+                    "int main(int, char* [])", AGG_PREFIX + "BaselineCorrData");
             }
-            
-            if(useConstCorr && groupFiles)
+            printDataSet(AGG_PREFIX + "BaselineCorrData", AVG_DATA_COL_TITLES, AVG_DATA, numGroups, WAVENUMBER,
+                upperBoundSpecified, lowerBoundSpecified, upperBound, lowerBound, ubStr, lbStr);
+        }
+    }
+    // Report which files were rejected by the group aggregate over the saved region(s)
+    if(reportOutliers)
+    {
+        int firstIndex = 0;
+        int lastIndex = SIZE - 1;
+        if(upperBoundSpecified) firstIndex = wavenumToIndex(upperBound, WAVENUMBER, SIZE);
+        if(lowerBoundSpecified) lastIndex = wavenumToIndex(lowerBound, WAVENUMBER, SIZE);
+        std::vector<std::pair<int, int> > savedRows(1, std::make_pair(firstIndex, lastIndex));
+        if(useRegions)
+        { // Every row in some region, once
+            savedRows.clear();
+            for(size_t r = 0; r < regions.size(); r++)
+                savedRows.push_back(std::make_pair(regions[r].firstIndex, regions[r].lastIndex));
+            std::sort(savedRows.begin(), savedRows.end());
+            size_t numMerged = 0;
+            for(size_t r = 1; r < savedRows.size(); r++)
+                if(savedRows[r].first <= savedRows[numMerged].second + 1)
+                    savedRows[numMerged].second = std::max(savedRows[numMerged].second, savedRows[r].second);
+                else
+                    savedRows[++numMerged] = savedRows[r];
+            savedRows.resize(numMerged + 1);
+        }
+        int* timesLowest = new int [NUM_SPA_FILES];
+        int* timesHighest = new int [NUM_SPA_FILES];
+        int* rangeLowest = new int [NUM_SPA_FILES];
+        int* rangeHighest = new int [NUM_SPA_FILES];
+        int numPoints = 0;
+        for(size_t r = 0; r < savedRows.size(); r++)
+        {
+            countGroupRejections(rangeLowest, rangeHighest, IR_DATA, numGroups, groupSize, savedRows[r].first, savedRows[r].second,
+                aggregateMode);
+            for(int i = 0; i < NUM_SPA_FILES; i++)
             {
-                computeAverages(AVG_DATA, CORR_DATA, numGroups, groupSize, SIZE);
-                const char* AVG_CORR_CSV_FILENAME = "averagedCorrData.fullSpectrum.CSV";
-                printToCSV(AVG_CORR_CSV_FILENAME, AVG_DATA_COL_TITLES, AVG_DATA, WAVENUMBER, numGroups, SIZE);
+                timesLowest[i] = ( r == 0 ? 0 : timesLowest[i] ) + rangeLowest[i];
+                timesHighest[i] = ( r == 0 ? 0 : timesHighest[i] ) + rangeHighest[i];
             }
+            numPoints += savedRows[r].second - savedRows[r].first + 1;
         }
+        delete[] rangeLowest;
+        delete[] rangeHighest;
+        printOutlierReport((std::string("outlierReport.") + AGG_PREFIX + std::string(".CSV")).c_str(), SPA_FILENAME,
+            timesLowest, timesHighest, NUM_SPA_FILES, groupSize, numPoints);
+        delete[] timesLowest;
+        delete[] timesHighest;
     }
-    else
-    { // SCENARIO: No optional arguments given
-        const char* RAW_CSV_FILENAME = "combinedRawData.fullSpectrum.CSV";
-        printToCSV(RAW_CSV_FILENAME, SPA_FILENAME, IR_DATA, WAVENUMBER, NUM_SPA_FILES, SIZE);
+
+    if(printPipelineStats)
+    {
+        const StageStats* const stages[] = {&readStats, &transformStats, &formatStats, &writeStats};
+        printStageStats(stages, 4);
+        if(useCacheDir)
+            std::cerr << "Conversion cache: " << conversionCacheHits() << " hits, " << conversionCacheMisses() << " misses.\n";
+    }
+    if(writeReport)
+    {
+        const StageStats* const stages[] = {&readStats, &transformStats, &formatStats, &writeStats};
+        writeRunReport(getStrAfter(std::string(argv[optionalArgIndices[REPORT_ARG_INDEX]]), ARG_VAL_DIV_CHAR),
+            NUM_SPA_FILES, numThreads, stages, 4);
+    }
+    if(writeTraceFile)
+    {
+        std::string tracePath = getStrAfter(std::string(argv[optionalArgIndices[TRACE_ARG_INDEX]]), ARG_VAL_DIV_CHAR);
+        size_t numDropped = 0;
+        checkStatus(writeTrace(tracePath, &numDropped), "int main(int, char* [])", "trace file '" + tracePath + "'");
+        if(numDropped > 0)
+            std::cerr << "Warning: " << numDropped << " of the earliest trace events were overwritten; the trace keeps the last "
+                << TRACE_EVENTS_PER_THREAD << " of each thread.\n";
     }
 
     delete[] SPA_FILENAME;
-    for(int i = 0; i < NUM_SPA_FILES; i++)
+    if(quantize)
     {
-        delete[] IR_DATA[i];
-        if(useConstCorr) delete[] CORR_DATA[i];
+        deleteQuantizedSpectra(QUANTIZED_DATA);
+        delete[] CORR_OFFSETS;
+    }
+    else
+    {
+        freeFloatArray(IR_DATA, NUM_SPA_FILES);
+        if(useConstCorr) freeFloatArray(CORR_DATA, NUM_SPA_FILES);
+    }
+    if(usePolyBaseline)
+    {
+        freeFloatArray(BASELINE_CORR_DATA, NUM_SPA_FILES);
+        deletePolyBaselinePlan(polyBaselinePlan);
     }
-
-    delete[] IR_DATA;
-    if(useConstCorr) delete[] CORR_DATA;
     if(groupFiles)
     {
         delete[] AVG_DATA_COL_TITLES;
-        for(int i = 0; i < numGroups; i++)
-            delete[] AVG_DATA[i];
-        delete[] AVG_DATA;
+        freeFloatArray(AVG_DATA, numGroups);
     }
     return 0;
 }
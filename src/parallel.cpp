@@ -0,0 +1,37 @@
+#include "parallel.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+int defaultThreadCount()
+{
+    unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    return (hardwareThreads == 0 ? 1 : (int)hardwareThreads);
+}
+
+void parallelFor(int count, int numThreads, const std::function<void(int, int)>& body)
+{
+    if(numThreads > count) numThreads = count;
+    if(numThreads <= 1)
+    { // Run on the calling thread
+        for(int i = 0; i < count; i++)
+            body(i, 0);
+        return;
+    }
+
+    std::atomic<int> nextIndex(0);
+    auto worker = [&](int threadIndex)
+    {
+        for(int i = nextIndex++; i < count; i = nextIndex++)
+            body(i, threadIndex);
+    };
+
+    std::vector<std::thread> threads;
+    for(int t = 1; t < numThreads; t++)
+        threads.push_back(std::thread(worker, t));
+    worker(0); // The calling thread does its share
+    for(size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+    return;
+}
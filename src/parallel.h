@@ -0,0 +1,14 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+// Number of threads to use when the user does not give --threads
+int defaultThreadCount();
+
+// Call body(i, threadIndex) for every i in [0, count) using up to numThreads threads.
+// Indices are handed out one at a time, so uneven work balances itself; threadIndex is
+// in [0, numThreads) and can be used to pick a per-thread workspace.
+void parallelFor(int count, int numThreads, const std::function<void(int, int)>& body);
+
+#endif // PARALLEL_H
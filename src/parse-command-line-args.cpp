@@ -5,21 +5,7 @@
 #include <cstdlib>
 #include <iostream>
 #include <string>
-
-const std::string UB_ARG_STR = "--upper-bound";
-const std::string LB_ARG_STR = "--lower-bound";
-const std::string UB_ARG_SHORT_STR = "-u";
-const std::string LB_ARG_SHORT_STR = "-l";
-const std::string CONST_CORR_STR = "--calculate-const-corr";
-const std::string GROUP_FILES_STR = "--group-files";
-
-const int UB_ARG_INDEX = 0;
-const int LB_ARG_INDEX = 1;
-const int CONST_CORR_ARG_INDEX = 2;
-const int GROUP_FILES_ARG_INDEX = 3;
-
-const char ARG_VAL_DIV_CHAR = '=';
-const char VAL_VAL_DIV_CHAR = '-';
+#include <vector>
 
 // NOTE: requires strToInt.cpp (uses truncateStrAt(string, char))
 
@@ -45,6 +31,105 @@ void checkIfAlreadyGiven(int argIndex, bool* optionalArgs[], bool* usedOptionalA
             case GROUP_FILES_ARG_INDEX:
                 std::cerr << "Error: " << funcDef << ": Group files flag used more than once.\n";
                 break;
+            case AGGREGATE_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Aggregate flag used more than once.\n";
+                break;
+            case REPORT_OUTLIERS_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Report outliers flag used more than once.\n";
+                break;
+            case BASELINE_ANCHORS_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Baseline anchors specified more than once.\n";
+                break;
+            case BASELINE_DEGREE_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Baseline degree specified more than once.\n";
+                break;
+            case THREADS_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Number of threads specified more than once.\n";
+                break;
+            case ALS_BASELINE_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": ALS baseline flag used more than once.\n";
+                break;
+            case ALS_ITERATIONS_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": ALS iterations specified more than once.\n";
+                break;
+            case CONVERT_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Convert flag used more than once.\n";
+                break;
+            case REFERENCE_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Reference spectrum specified more than once.\n";
+                break;
+            case ALIGN_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Align flag used more than once.\n";
+                break;
+            case STAGE_THREADS_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Stage threads specified more than once.\n";
+                break;
+            case PIPELINE_STATS_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Pipeline stats flag used more than once.\n";
+                break;
+            case SERVE_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Serve flag used more than once.\n";
+                break;
+            case SERVE_CACHE_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Server cache size specified more than once.\n";
+                break;
+            case WATCH_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Watch directory specified more than once.\n";
+                break;
+            case CACHE_DIR_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Cache directory specified more than once.\n";
+                break;
+            case CACHE_BUDGET_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Cache budget specified more than once.\n";
+                break;
+            case IO_BACKEND_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": I/O backend specified more than once.\n";
+                break;
+            case IO_DEPTH_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": I/O depth specified more than once.\n";
+                break;
+            case INPUT_DIR_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Input directory specified more than once.\n";
+                break;
+            case GLOB_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Glob pattern specified more than once.\n";
+                break;
+            case MANIFEST_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Manifest specified more than once.\n";
+                break;
+            case INPUT_TAR_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Input tar archive specified more than once.\n";
+                break;
+            case MEMORY_BUDGET_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Memory budget specified more than once.\n";
+                break;
+            case REPORT_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Report file specified more than once.\n";
+                break;
+            case TRACE_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Trace file specified more than once.\n";
+                break;
+            case PERF_COUNTERS_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Performance counters flag specified more than once.\n";
+                break;
+            case JOBS_FILE_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Jobs file specified more than once.\n";
+                break;
+            case REGION_COLUMN_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Region column flag specified more than once.\n";
+                break;
+            case QUANTIZE_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Quantized format specified more than once.\n";
+                break;
+            case OUTPUT_FORMAT_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Output format specified more than once.\n";
+                break;
+            case SPZ_TO_CSV_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": SPZ file to convert specified more than once.\n";
+                break;
+            case SUMMATION_ARG_INDEX:
+                std::cerr << "Error: " << funcDef << ": Summation order specified more than once.\n";
+                break;
             default:
                 std::cerr << "Error: " << funcDef << ": invalid argument index.\n";
         }
@@ -87,6 +172,177 @@ bool usingOptionalArgs
             checkIfAlreadyGiven(GROUP_FILES_ARG_INDEX, optionalArgs, &usedOptionalArgs);
             optionalArgIndices[GROUP_FILES_ARG_INDEX] = i;
         }
+        else if(argName == AGGREGATE_STR)
+        {
+            checkIfAlreadyGiven(AGGREGATE_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[AGGREGATE_ARG_INDEX] = i;
+        }
+        else if(argName == REPORT_OUTLIERS_STR)
+        {
+            checkIfAlreadyGiven(REPORT_OUTLIERS_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[REPORT_OUTLIERS_ARG_INDEX] = i;
+        }
+        else if(argName == BASELINE_ANCHORS_STR)
+        {
+            checkIfAlreadyGiven(BASELINE_ANCHORS_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[BASELINE_ANCHORS_ARG_INDEX] = i;
+        }
+        else if(argName == BASELINE_DEGREE_STR)
+        {
+            checkIfAlreadyGiven(BASELINE_DEGREE_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[BASELINE_DEGREE_ARG_INDEX] = i;
+        }
+        else if(argName == THREADS_STR)
+        {
+            checkIfAlreadyGiven(THREADS_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[THREADS_ARG_INDEX] = i;
+        }
+        else if(argName == ALS_BASELINE_STR)
+        {
+            checkIfAlreadyGiven(ALS_BASELINE_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[ALS_BASELINE_ARG_INDEX] = i;
+        }
+        else if(argName == ALS_ITERATIONS_STR)
+        {
+            checkIfAlreadyGiven(ALS_ITERATIONS_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[ALS_ITERATIONS_ARG_INDEX] = i;
+        }
+        else if(argName == CONVERT_STR)
+        {
+            checkIfAlreadyGiven(CONVERT_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[CONVERT_ARG_INDEX] = i;
+        }
+        else if(argName == REFERENCE_STR)
+        {
+            checkIfAlreadyGiven(REFERENCE_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[REFERENCE_ARG_INDEX] = i;
+        }
+        else if(argName == ALIGN_STR)
+        {
+            checkIfAlreadyGiven(ALIGN_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[ALIGN_ARG_INDEX] = i;
+        }
+        else if(argName == STAGE_THREADS_STR)
+        {
+            checkIfAlreadyGiven(STAGE_THREADS_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[STAGE_THREADS_ARG_INDEX] = i;
+        }
+        else if(argName == PIPELINE_STATS_STR)
+        {
+            checkIfAlreadyGiven(PIPELINE_STATS_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[PIPELINE_STATS_ARG_INDEX] = i;
+        }
+        else if(argName == SERVE_STR)
+        {
+            checkIfAlreadyGiven(SERVE_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[SERVE_ARG_INDEX] = i;
+        }
+        else if(argName == SERVE_CACHE_STR)
+        {
+            checkIfAlreadyGiven(SERVE_CACHE_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[SERVE_CACHE_ARG_INDEX] = i;
+        }
+        else if(argName == WATCH_STR)
+        {
+            checkIfAlreadyGiven(WATCH_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[WATCH_ARG_INDEX] = i;
+        }
+        else if(argName == CACHE_DIR_STR)
+        {
+            checkIfAlreadyGiven(CACHE_DIR_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[CACHE_DIR_ARG_INDEX] = i;
+        }
+        else if(argName == CACHE_BUDGET_STR)
+        {
+            checkIfAlreadyGiven(CACHE_BUDGET_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[CACHE_BUDGET_ARG_INDEX] = i;
+        }
+        else if(argName == IO_BACKEND_STR)
+        {
+            checkIfAlreadyGiven(IO_BACKEND_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[IO_BACKEND_ARG_INDEX] = i;
+        }
+        else if(argName == IO_DEPTH_STR)
+        {
+            checkIfAlreadyGiven(IO_DEPTH_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[IO_DEPTH_ARG_INDEX] = i;
+        }
+        else if(argName == INPUT_DIR_STR)
+        {
+            checkIfAlreadyGiven(INPUT_DIR_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[INPUT_DIR_ARG_INDEX] = i;
+        }
+        else if(argName == GLOB_STR)
+        {
+            checkIfAlreadyGiven(GLOB_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[GLOB_ARG_INDEX] = i;
+        }
+        else if(argName == MANIFEST_STR)
+        {
+            checkIfAlreadyGiven(MANIFEST_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[MANIFEST_ARG_INDEX] = i;
+        }
+        else if(argName == INPUT_TAR_STR)
+        {
+            checkIfAlreadyGiven(INPUT_TAR_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[INPUT_TAR_ARG_INDEX] = i;
+        }
+        else if(argName == MEMORY_BUDGET_STR)
+        {
+            checkIfAlreadyGiven(MEMORY_BUDGET_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[MEMORY_BUDGET_ARG_INDEX] = i;
+        }
+        else if(argName == REPORT_STR)
+        {
+            checkIfAlreadyGiven(REPORT_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[REPORT_ARG_INDEX] = i;
+        }
+        else if(argName == TRACE_STR)
+        {
+            checkIfAlreadyGiven(TRACE_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[TRACE_ARG_INDEX] = i;
+        }
+        else if(argName == PERF_COUNTERS_STR)
+        {
+            checkIfAlreadyGiven(PERF_COUNTERS_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[PERF_COUNTERS_ARG_INDEX] = i;
+        }
+        else if(argName == JOBS_FILE_STR)
+        {
+            checkIfAlreadyGiven(JOBS_FILE_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[JOBS_FILE_ARG_INDEX] = i;
+        }
+        else if(argName == REGION_STR)
+        { // May be given more than once; the index is the last one's (see findArgIndices())
+            *optionalArgs[REGION_ARG_INDEX] = true;
+            usedOptionalArgs = true;
+            optionalArgIndices[REGION_ARG_INDEX] = i;
+        }
+        else if(argName == REGION_COLUMN_STR)
+        {
+            checkIfAlreadyGiven(REGION_COLUMN_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[REGION_COLUMN_ARG_INDEX] = i;
+        }
+        else if(argName == QUANTIZE_STR)
+        {
+            checkIfAlreadyGiven(QUANTIZE_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[QUANTIZE_ARG_INDEX] = i;
+        }
+        else if(argName == OUTPUT_FORMAT_STR)
+        {
+            checkIfAlreadyGiven(OUTPUT_FORMAT_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[OUTPUT_FORMAT_ARG_INDEX] = i;
+        }
+        else if(argName == SPZ_TO_CSV_STR)
+        {
+            checkIfAlreadyGiven(SPZ_TO_CSV_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[SPZ_TO_CSV_ARG_INDEX] = i;
+        }
+        else if(argName == SUMMATION_STR)
+        {
+            checkIfAlreadyGiven(SUMMATION_ARG_INDEX, optionalArgs, &usedOptionalArgs);
+            optionalArgIndices[SUMMATION_ARG_INDEX] = i;
+        }
     }
     return usedOptionalArgs;
 }
@@ -104,6 +360,40 @@ void checkArgIndex(const int NUM_OPT_ARGS, int optionalArgIndices[], int maxInde
                 case LB_ARG_INDEX: optArg = LB_ARG_STR; break;
                 case CONST_CORR_ARG_INDEX: optArg = CONST_CORR_STR; break;
                 case GROUP_FILES_ARG_INDEX: optArg = GROUP_FILES_STR; break;
+                case AGGREGATE_ARG_INDEX: optArg = AGGREGATE_STR; break;
+                case REPORT_OUTLIERS_ARG_INDEX: optArg = REPORT_OUTLIERS_STR; break;
+                case BASELINE_ANCHORS_ARG_INDEX: optArg = BASELINE_ANCHORS_STR; break;
+                case BASELINE_DEGREE_ARG_INDEX: optArg = BASELINE_DEGREE_STR; break;
+                case THREADS_ARG_INDEX: optArg = THREADS_STR; break;
+                case ALS_BASELINE_ARG_INDEX: optArg = ALS_BASELINE_STR; break;
+                case ALS_ITERATIONS_ARG_INDEX: optArg = ALS_ITERATIONS_STR; break;
+                case CONVERT_ARG_INDEX: optArg = CONVERT_STR; break;
+                case REFERENCE_ARG_INDEX: optArg = REFERENCE_STR; break;
+                case ALIGN_ARG_INDEX: optArg = ALIGN_STR; break;
+                case STAGE_THREADS_ARG_INDEX: optArg = STAGE_THREADS_STR; break;
+                case PIPELINE_STATS_ARG_INDEX: optArg = PIPELINE_STATS_STR; break;
+                case SERVE_ARG_INDEX: optArg = SERVE_STR; break;
+                case SERVE_CACHE_ARG_INDEX: optArg = SERVE_CACHE_STR; break;
+                case WATCH_ARG_INDEX: optArg = WATCH_STR; break;
+                case CACHE_DIR_ARG_INDEX: optArg = CACHE_DIR_STR; break;
+                case CACHE_BUDGET_ARG_INDEX: optArg = CACHE_BUDGET_STR; break;
+                case IO_BACKEND_ARG_INDEX: optArg = IO_BACKEND_STR; break;
+                case IO_DEPTH_ARG_INDEX: optArg = IO_DEPTH_STR; break;
+                case INPUT_DIR_ARG_INDEX: optArg = INPUT_DIR_STR; break;
+                case GLOB_ARG_INDEX: optArg = GLOB_STR; break;
+                case MANIFEST_ARG_INDEX: optArg = MANIFEST_STR; break;
+                case INPUT_TAR_ARG_INDEX: optArg = INPUT_TAR_STR; break;
+                case MEMORY_BUDGET_ARG_INDEX: optArg = MEMORY_BUDGET_STR; break;
+                case REPORT_ARG_INDEX: optArg = REPORT_STR; break;
+                case TRACE_ARG_INDEX: optArg = TRACE_STR; break;
+                case PERF_COUNTERS_ARG_INDEX: optArg = PERF_COUNTERS_STR; break;
+                case JOBS_FILE_ARG_INDEX: optArg = JOBS_FILE_STR; break;
+                case REGION_ARG_INDEX: optArg = REGION_STR; break;
+                case REGION_COLUMN_ARG_INDEX: optArg = REGION_COLUMN_STR; break;
+                case QUANTIZE_ARG_INDEX: optArg = QUANTIZE_STR; break;
+                case OUTPUT_FORMAT_ARG_INDEX: optArg = OUTPUT_FORMAT_STR; break;
+                case SPZ_TO_CSV_ARG_INDEX: optArg = SPZ_TO_CSV_STR; break;
+                case SUMMATION_ARG_INDEX: optArg = SUMMATION_STR; break;
             }
             std::cerr << "Error: " << funcDef << ": index of optional argument '" << optArg << "' is larger than expected.\n\n";
             printUsage(argv[0]);
@@ -116,6 +406,17 @@ int checkArgOrder(const int NUM_OPT_ARGS, bool* optionalArgs[], int optionalArgI
     int numOptArgsSpecified = 0;
     for(int i = 0; i < NUM_OPT_ARGS; i++)
         if(*optionalArgs[i] == true) numOptArgsSpecified++;
+    // Repeats of --region are optional arguments too
+    if(*optionalArgs[REGION_ARG_INDEX] == true)
+        numOptArgsSpecified += (int)findArgIndices(argc, argv, REGION_STR).size() - 1;
     checkArgIndex(NUM_OPT_ARGS, optionalArgIndices, numOptArgsSpecified, argc, argv);
     return numOptArgsSpecified;
 }
+
+std::vector<int> findArgIndices(int argc, char* argv[], const std::string& argName)
+{
+    std::vector<int> indices;
+    for(int i = 1; i < argc; i++)
+        if(truncateStrAt(std::string(argv[i]), ARG_VAL_DIV_CHAR) == argName) indices.push_back(i);
+    return indices;
+}
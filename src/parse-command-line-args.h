@@ -1,6 +1,94 @@
 #ifndef PARSE_CMD_H
 #define PARSE_CMD_H
 
+#include <string>
+#include <vector>
+
+const std::string UB_ARG_STR = "--upper-bound";
+const std::string LB_ARG_STR = "--lower-bound";
+const std::string UB_ARG_SHORT_STR = "-u";
+const std::string LB_ARG_SHORT_STR = "-l";
+const std::string CONST_CORR_STR = "--calculate-const-corr";
+const std::string GROUP_FILES_STR = "--group-files";
+const std::string AGGREGATE_STR = "--aggregate";
+const std::string REPORT_OUTLIERS_STR = "--report-outliers";
+const std::string BASELINE_ANCHORS_STR = "--baseline-anchors";
+const std::string BASELINE_DEGREE_STR = "--baseline-degree";
+const std::string THREADS_STR = "--threads";
+const std::string ALS_BASELINE_STR = "--als-baseline";
+const std::string ALS_ITERATIONS_STR = "--als-iterations";
+const std::string CONVERT_STR = "--convert";
+const std::string REFERENCE_STR = "--reference";
+const std::string ALIGN_STR = "--align";
+const std::string STAGE_THREADS_STR = "--stage-threads";
+const std::string PIPELINE_STATS_STR = "--pipeline-stats";
+const std::string SERVE_STR = "--serve";
+const std::string SERVE_CACHE_STR = "--serve-cache";
+const std::string WATCH_STR = "--watch";
+const std::string CACHE_DIR_STR = "--cache-dir";
+const std::string CACHE_BUDGET_STR = "--cache-budget";
+const std::string IO_BACKEND_STR = "--io-backend";
+const std::string IO_DEPTH_STR = "--io-depth";
+const std::string INPUT_DIR_STR = "--input-dir";
+const std::string GLOB_STR = "--glob";
+const std::string MANIFEST_STR = "--manifest";
+const std::string INPUT_TAR_STR = "--input-tar";
+const std::string MEMORY_BUDGET_STR = "--memory-budget";
+const std::string REPORT_STR = "--report";
+const std::string TRACE_STR = "--trace";
+const std::string PERF_COUNTERS_STR = "--perf-counters";
+const std::string JOBS_FILE_STR = "--jobs-file";
+const std::string REGION_STR = "--region";
+const std::string REGION_COLUMN_STR = "--region-column";
+const std::string QUANTIZE_STR = "--quantize";
+const std::string OUTPUT_FORMAT_STR = "--output-format";
+const std::string SPZ_TO_CSV_STR = "--spz-to-csv";
+const std::string SUMMATION_STR = "--summation";
+
+// NOTE: these indices match the ordering of optionalArgs[] in main()
+const int UB_ARG_INDEX = 0;
+const int LB_ARG_INDEX = 1;
+const int CONST_CORR_ARG_INDEX = 2;
+const int GROUP_FILES_ARG_INDEX = 3;
+const int AGGREGATE_ARG_INDEX = 4;
+const int REPORT_OUTLIERS_ARG_INDEX = 5;
+const int BASELINE_ANCHORS_ARG_INDEX = 6;
+const int BASELINE_DEGREE_ARG_INDEX = 7;
+const int THREADS_ARG_INDEX = 8;
+const int ALS_BASELINE_ARG_INDEX = 9;
+const int ALS_ITERATIONS_ARG_INDEX = 10;
+const int CONVERT_ARG_INDEX = 11;
+const int REFERENCE_ARG_INDEX = 12;
+const int ALIGN_ARG_INDEX = 13;
+const int STAGE_THREADS_ARG_INDEX = 14;
+const int PIPELINE_STATS_ARG_INDEX = 15;
+const int SERVE_ARG_INDEX = 16;
+const int SERVE_CACHE_ARG_INDEX = 17;
+const int WATCH_ARG_INDEX = 18;
+const int CACHE_DIR_ARG_INDEX = 19;
+const int CACHE_BUDGET_ARG_INDEX = 20;
+const int IO_BACKEND_ARG_INDEX = 21;
+const int IO_DEPTH_ARG_INDEX = 22;
+const int INPUT_DIR_ARG_INDEX = 23;
+const int GLOB_ARG_INDEX = 24;
+const int MANIFEST_ARG_INDEX = 25;
+const int INPUT_TAR_ARG_INDEX = 26;
+const int MEMORY_BUDGET_ARG_INDEX = 27;
+const int REPORT_ARG_INDEX = 28;
+const int TRACE_ARG_INDEX = 29;
+const int PERF_COUNTERS_ARG_INDEX = 30;
+const int JOBS_FILE_ARG_INDEX = 31;
+const int REGION_ARG_INDEX = 32;
+const int REGION_COLUMN_ARG_INDEX = 33;
+const int QUANTIZE_ARG_INDEX = 34;
+const int OUTPUT_FORMAT_ARG_INDEX = 35;
+const int SPZ_TO_CSV_ARG_INDEX = 36;
+const int SUMMATION_ARG_INDEX = 37;
+
+const char ARG_VAL_DIV_CHAR = '=';
+const char VAL_VAL_DIV_CHAR = '-';
+const char REGION_NAME_DIV_CHAR = ':';
+
 // TODO(ben): package optinal args in struct / class
 bool usingOptionalArgs(
     int argc,
@@ -18,4 +106,7 @@ int checkArgOrder(
     char* argv[]
 );
 
+// Index in argv of every use of an option that may be given more than once (--region)
+std::vector<int> findArgIndices(int argc, char* argv[], const std::string& argName);
+
 #endif // PARSE_CMD_H
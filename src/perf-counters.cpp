@@ -0,0 +1,115 @@
+#include "perf-counters.h"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+const char* const PERF_COUNTER_NAMES[NUM_PERF_COUNTERS] = {"cycles", "instructions", "llc_misses", "branch_misses"};
+
+static bool countersOpen = false;
+static std::string openError;
+
+bool perfCountersOpen()
+{
+    return countersOpen;
+}
+
+const char* perfCountersError()
+{
+    return ( openError.empty() ? nullptr : openError.c_str() );
+}
+
+#ifndef __linux__
+
+bool openPerfCounters()
+{
+    openError = "hardware counters are only read on Linux";
+    return false;
+}
+
+void readPerfCounters(long long counts[NUM_PERF_COUNTERS])
+{
+    for(int c = 0; c < NUM_PERF_COUNTERS; c++)
+        counts[c] = -1;
+    return;
+}
+
+#else // Linux
+
+#include <fstream>
+#include <cstdint>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int counterFds[NUM_PERF_COUNTERS] = {-1, -1, -1, -1};
+
+static int openCounter(uint32_t type, uint64_t config)
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;           // threads started later count too, into this counter once they exit
+    attr.exclude_kernel = 1;    // allowed up to perf_event_paranoid 2
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+bool openPerfCounters()
+{
+    counterFds[PERF_CYCLES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    int cyclesErrno = errno;
+    counterFds[PERF_INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    if(counterFds[PERF_CYCLES] < 0 || counterFds[PERF_INSTRUCTIONS] < 0)
+    {
+        int error = ( counterFds[PERF_CYCLES] < 0 ? cyclesErrno : errno );
+        openError = std::string("perf_event_open failed: ") + std::strerror(error);
+        if(error == EACCES || error == EPERM)
+        {
+            std::ifstream paranoid ("/proc/sys/kernel/perf_event_paranoid");
+            std::string level;
+            if(paranoid >> level) openError += " (kernel.perf_event_paranoid is " + level + "; 2 or less is needed)";
+        }
+        else if(error == ENOENT || error == EOPNOTSUPP || error == ENODEV)
+            openError += " (no hardware counters; a virtual machine?)";
+        for(int c = 0; c < NUM_PERF_COUNTERS; c++)
+            if(counterFds[c] >= 0)
+            {
+                close(counterFds[c]);
+                counterFds[c] = -1;
+            }
+        return false;
+    }
+    // Last-level cache read misses; some CPUs only have the generic cache-miss event
+    counterFds[PERF_LLC_MISSES] = openCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    if(counterFds[PERF_LLC_MISSES] < 0)
+        counterFds[PERF_LLC_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    counterFds[PERF_BRANCH_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    countersOpen = true;
+    return true;
+}
+
+void readPerfCounters(long long counts[NUM_PERF_COUNTERS])
+{
+    for(int c = 0; c < NUM_PERF_COUNTERS; c++)
+    {
+        counts[c] = -1;
+        uint64_t values[3]; // value, time enabled, time running
+        if(counterFds[c] < 0 || read(counterFds[c], values, sizeof(values)) != (ssize_t)sizeof(values)) continue;
+        if(values[1] == 0)
+            counts[c] = 0;
+        else if(values[2] == 0)
+            continue; // never given the hardware: unknown
+        else if(values[2] < values[1])
+            counts[c] = (long long)((double)values[0] * values[1] / values[2]);
+        else
+            counts[c] = (long long)values[0];
+    }
+    return;
+}
+
+#endif // __linux__
@@ -0,0 +1,30 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+// Hardware performance counters for the --report stages (--perf-counters), read with
+// perf_event_open on Linux. Each counts user-space events of every thread of the process,
+// including threads started after the counters were opened. Where the kernel or the CPU does
+// not allow a counter (perf_event_paranoid, virtual machines without a PMU, other systems),
+// it reads as -1 and the report has wall-clock times only.
+
+const int NUM_PERF_COUNTERS = 4;
+const int PERF_CYCLES = 0;
+const int PERF_INSTRUCTIONS = 1;
+const int PERF_LLC_MISSES = 2;
+const int PERF_BRANCH_MISSES = 3;
+
+// Names used in the report, in counter order
+extern const char* const PERF_COUNTER_NAMES[NUM_PERF_COUNTERS];
+
+// Open the counters; call from the main thread before starting other threads. Returns false,
+// with the reason in perfCountersError(), if cycles and instructions cannot both be counted.
+bool openPerfCounters();
+bool perfCountersOpen();
+// Why openPerfCounters() failed; nullptr if it did not
+const char* perfCountersError();
+
+// Current totals, scaled up if the kernel had to share the hardware between counters; -1 for
+// counters that are not available
+void readPerfCounters(long long counts[NUM_PERF_COUNTERS]);
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,119 @@
+#include "pipeline.h"
+#include "io-uring.h"
+#include "read-write.h"
+#include "trace.h"
+
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+StageStats::StageStats(const std::string& stageName, int threads)
+    : name(stageName), numThreads(threads), busyNanos(0), stallNanos(0), items(0)
+{
+}
+
+void ingestSpectra(
+    char** SPA_FILENAME,
+    float** IR_DATA,
+    int NUM_SPA_FILES,
+    int readThreads,
+    int ioUringDepth,
+    int transformThreads,
+    int queueDepth,
+    const std::function<void(int, int)>& transform,
+    StageStats* readStats,
+    StageStats* transformStats
+)
+{
+    BoundedQueue<int> readFiles(queueDepth);
+    std::atomic<int> nextFile(0);
+    std::atomic<int> readersLeft(readThreads);
+
+    auto reader = [&]()
+    {
+        for(int file = nextFile++; file < NUM_SPA_FILES; file = nextFile++)
+        {
+            long long begin = nowNanos();
+            readSPAFile(SPA_FILENAME[file], IR_DATA[file]);
+            long long end = nowNanos();
+            readStats->busyNanos += end - begin;
+            traceEvent("read", "readSPAFile", SPA_FILENAME[file], file, begin, end);
+            readStats->items++;
+            readFiles.push(file, readStats);
+        }
+        if(--readersLeft == 0) readFiles.close();
+    };
+    auto uringReader = [&]()
+    {
+        long long begin = nowNanos();
+        long long stallBefore = readStats->stallNanos.load();
+        std::string reason;
+        bool usedUring = readSPAFilesUring(SPA_FILENAME, IR_DATA, NUM_SPA_FILES, ioUringDepth,
+            [&](int file)
+            {
+                readStats->items++;
+                readFiles.push(file, readStats);
+            },
+            &reason);
+        if(!usedUring)
+        {
+            std::cerr << "Warning: io_uring is unavailable (" << reason << "); reading files synchronously.\n";
+            // Nothing has been read yet, so readThreads sync readers, this thread one of them, take over
+            readersLeft = readThreads;
+            readStats->numThreads = readThreads;
+            std::vector<std::thread> syncReaders;
+            for(int t = 1; t < readThreads; t++)
+                syncReaders.push_back(std::thread(reader));
+            reader();
+            for(size_t t = 0; t < syncReaders.size(); t++)
+                syncReaders[t].join();
+            return;
+        }
+        // The ring is waited on while reads are in flight; only queue stalls are not reading
+        readStats->busyNanos += nowNanos() - begin - (readStats->stallNanos.load() - stallBefore);
+        readFiles.close();
+    };
+    auto transformer = [&](int thread)
+    {
+        int file;
+        while(readFiles.pop(file, transformStats))
+        {
+            long long begin = nowNanos();
+            transform(file, thread);
+            long long end = nowNanos();
+            transformStats->busyNanos += end - begin;
+            traceEvent("transform", "transform", SPA_FILENAME[file], file, begin, end);
+            transformStats->items++;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    if(ioUringDepth > 0)
+    {
+        readersLeft = 1;
+        threads.push_back(std::thread(uringReader));
+    }
+    else
+        for(int t = 0; t < readThreads; t++)
+            threads.push_back(std::thread(reader));
+    for(int t = 0; t < transformThreads; t++)
+        threads.push_back(std::thread(transformer, t));
+    for(size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+    return;
+}
+
+// One line per stage: threads, items, and busy / stalled time summed over the stage's threads
+void printStageStats(const StageStats* const stats[], int numStages)
+{
+    std::cerr << "Pipeline stage    threads     items    busy (s)   stalled (s)\n";
+    for(int s = 0; s < numStages; s++)
+        std::cerr << std::left << std::setw(16) << stats[s]->name << std::right
+            << std::setw(9) << stats[s]->numThreads
+            << std::setw(10) << stats[s]->items.load()
+            << std::setw(12) << std::fixed << std::setprecision(3) << stats[s]->busyNanos.load() * 1e-9
+            << std::setw(14) << stats[s]->stallNanos.load() * 1e-9 << "\n";
+    std::cerr << std::defaultfloat;
+    return;
+}
@@ -0,0 +1,185 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "trace.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Time spent by the threads of one pipeline stage. Busy time is spent in the stage body, stall
+// time waiting on a full output queue or an empty input queue.
+struct StageStats
+{
+    std::string name;
+    int numThreads;
+    std::atomic<long long> busyNanos;
+    std::atomic<long long> stallNanos;
+    std::atomic<long long> items;
+
+    StageStats(const std::string& stageName, int threads);
+};
+
+// Bounded lock-free multi-producer/multi-consumer queue (D. Vyukov's array queue). Each slot
+// carries a sequence number telling producers and consumers whose turn it is, so push and pop
+// are one compare-and-swap on the fast path. When the queue is full or empty the caller spins,
+// yielding, and the wait is charged to the stage's stall time.
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(int minCapacity);
+
+    void push(const T& value, StageStats* stats);
+    // Returns false once close() has been called and the queue has drained
+    bool pop(T& value, StageStats* stats);
+    // Called by the last producer
+    void close();
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    bool tryPush(const T& value);
+    bool tryPop(T& value);
+
+    std::vector<Slot> slots;
+    size_t mask;
+    // Keep the producer and consumer positions on separate cache lines
+    alignas(64) std::atomic<size_t> enqueuePos;
+    alignas(64) std::atomic<size_t> dequeuePos;
+    alignas(64) std::atomic<bool> closed;
+};
+
+// Read every SPA file into IR_DATA with readThreads threads while transformThreads threads run
+// transform(file, thread) on the spectra already read. Files are handed from one stage to the
+// next through a BoundedQueue holding at most queueDepth file indices. With ioUringDepth > 0,
+// one thread reads up to ioUringDepth files at once through io_uring instead (see io-uring.h);
+// if io_uring is unavailable, readThreads threads read synchronously as without it.
+void ingestSpectra(
+    char** SPA_FILENAME,
+    float** IR_DATA,
+    int NUM_SPA_FILES,
+    int readThreads,
+    int ioUringDepth,
+    int transformThreads,
+    int queueDepth,
+    const std::function<void(int, int)>& transform,
+    StageStats* readStats,
+    StageStats* transformStats
+);
+
+void printStageStats(const StageStats* const stats[], int numStages);
+
+// BoundedQueue member definitions
+
+template <typename T>
+BoundedQueue<T>::BoundedQueue(int minCapacity)
+    : enqueuePos(0), dequeuePos(0), closed(false)
+{
+    size_t capacity = 2;
+    while(capacity < (size_t)minCapacity)
+        capacity *= 2;
+    std::vector<Slot> newSlots(capacity);
+    slots.swap(newSlots);
+    mask = capacity - 1;
+    for(size_t i = 0; i < capacity; i++)
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template <typename T>
+bool BoundedQueue<T>::tryPush(const T& value)
+{
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    for(;;)
+    {
+        Slot& slot = slots[pos & mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        long long difference = (long long)sequence - (long long)pos;
+        if(difference == 0)
+        { // Slot is free for this position; claim it
+            if(enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                slot.value = value;
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if(difference < 0)
+            return false; // full
+        else
+            pos = enqueuePos.load(std::memory_order_relaxed);
+    }
+}
+
+template <typename T>
+bool BoundedQueue<T>::tryPop(T& value)
+{
+    size_t pos = dequeuePos.load(std::memory_order_relaxed);
+    for(;;)
+    {
+        Slot& slot = slots[pos & mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        long long difference = (long long)sequence - (long long)(pos + 1);
+        if(difference == 0)
+        {
+            if(dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                value = slot.value;
+                slot.sequence.store(pos + mask + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if(difference < 0)
+            return false; // empty
+        else
+            pos = dequeuePos.load(std::memory_order_relaxed);
+    }
+}
+
+template <typename T>
+void BoundedQueue<T>::push(const T& value, StageStats* stats)
+{
+    if(tryPush(value)) return;
+    long long waitStart = nowNanos();
+    while(!tryPush(value))
+        std::this_thread::yield();
+    if(stats) stats->stallNanos += nowNanos() - waitStart;
+    return;
+}
+
+template <typename T>
+bool BoundedQueue<T>::pop(T& value, StageStats* stats)
+{
+    if(tryPop(value)) return true;
+    long long waitStart = nowNanos();
+    bool popped = false;
+    for(;;)
+    {
+        // Check closed before trying, so an item pushed just before close() is not missed
+        bool wasClosed = closed.load(std::memory_order_acquire);
+        if(tryPop(value))
+        {
+            popped = true;
+            break;
+        }
+        if(wasClosed) break;
+        std::this_thread::yield();
+    }
+    if(stats) stats->stallNanos += nowNanos() - waitStart;
+    return popped;
+}
+
+template <typename T>
+void BoundedQueue<T>::close()
+{
+    closed.store(true, std::memory_order_release);
+    return;
+}
+
+#endif // PIPELINE_H
@@ -15,6 +15,16 @@ void printUsage(char* PROG_NAME)
          << "                                   over which data will be saved.\n\n"
 	     << "    -l=N2, --lower-bound=N2        Defines the lower bound N2 of the wavenumber region\n"
          << "                                   over which data will be saved.\n\n"
+         << "    --region=N1-N2[:NAME]          Save the wavenumber region between N1 and N2, named\n"
+         << "                                   NAME (default N1-N2), instead of using -u and -l.\n"
+         << "                                   May be given more than once; each data set is then\n"
+         << "                                   saved over every region in one pass, to a file per\n"
+         << "                                   region (e.g. combinedRawData.NAME.CSV). Data in\n"
+         << "                                   overlapping regions is read and formatted once.\n\n"
+         << "    --region-column                Save all regions of a data set to one file\n"
+         << "                                   (e.g. combinedRawData.regions.CSV), with the\n"
+         << "                                   region's name in the first column. Rows in more\n"
+         << "                                   than one region appear once for each.\n\n"
          << "    --calculate-const-corr=N3-N4   Define a wavenumber region between N3 and N4 which\n"
          << "                                   will be used to calculate a constant correction.\n"
          << "                                   The corrections will try to move each spectrum\n"
@@ -22,5 +32,136 @@ void printUsage(char* PROG_NAME)
          << "                                   between spectra in this region.\n\n"
          << "    --group-files=N5               Define the number of files N5 which will be grouped\n"
          << "                                   and averaged. (Expects that user passes a multiple\n"
-         << "                                   of N5 total files.)\n\n";
+         << "                                   of N5 total files.)\n\n"
+         << "    --aggregate=MODE               Combine each group of files using MODE, one of\n"
+         << "                                   'mean' (default), 'median' or 'trimmed-mean'\n"
+         << "                                   (drops the lowest and highest value at each\n"
+         << "                                   wavenumber). Requires --group-files.\n\n"
+         << "    --report-outliers              Save, for each file, how often --aggregate dropped\n"
+         << "                                   its value as one of the lowest or highest of its\n"
+         << "                                   group (never for 'mean'). Requires --group-files.\n\n"
+         << "    --baseline-anchors=N6-N7,...   Fit a polynomial through the windows N6-N7, ... of\n"
+         << "                                   each spectrum and subtract it (saved in separate\n"
+         << "                                   file). The windows should contain no peaks.\n\n"
+         << "    --baseline-degree=N8           Degree N8 (0 to 6) of the baseline polynomial.\n"
+         << "                                   Defaults to 1, a sloped straight line.\n\n"
+         << "    --threads=N9                   Use up to N9 threads. Defaults to the number of\n"
+         << "                                   hardware threads.\n\n"
+         << "    --als-baseline=L,P             Subtract an asymmetric least squares baseline from\n"
+         << "                                   every spectrum before any other processing. L sets\n"
+         << "                                   the smoothness (e.g. 1e6) and P the asymmetry: use\n"
+         << "                                   a small P (e.g. 0.01) for absorbance and a P close\n"
+         << "                                   to 1 (e.g. 0.99) for % transmission.\n\n"
+         << "    --als-iterations=N10           Reweight the ALS baseline at most N10 times.\n"
+         << "                                   Defaults to 10.\n\n"
+         << "    --reference=FILE               Divide every spectrum by the spectrum in SPA file\n"
+         << "                                   FILE (e.g. a background), giving % transmission\n"
+         << "                                   relative to it.\n\n"
+         << "    --convert=absorbance           Convert % transmission T to absorbance,\n"
+         << "                                   A = -log10(T / 100). Applied after --reference and\n"
+         << "                                   before all other processing, so every saved file\n"
+         << "                                   holds absorbance.\n\n"
+         << "    --align=N11-N12                Correct small wavenumber shifts: each spectrum is\n"
+         << "                                   cross-correlated with the first file between N11\n"
+         << "                                   and N12 and resampled to remove the (fractional)\n"
+         << "                                   shift, which is saved to alignmentShifts.CSV.\n\n"
+         << "    --stage-threads=R,T,F          Files are read by R threads and transformed by T\n"
+         << "                                   threads while later files are still being read;\n"
+         << "                                   CSV rows are formatted by F threads while earlier\n"
+         << "                                   rows are written. Each defaults to --threads.\n\n"
+         << "    --pipeline-stats               Print the busy and stalled time of each pipeline\n"
+         << "                                   stage when done.\n\n"
+         << "    --serve=SOCKET                 Instead of reading files, answer requests on the\n"
+         << "                                   Unix domain socket SOCKET until stopped (see\n"
+         << "                                   server.h for the request format). Spectra are\n"
+         << "                                   cached between requests and re-read only when\n"
+         << "                                   their file changes. Uses --threads threads.\n\n"
+         << "    --serve-cache=N13              Keep at most N13 MiB of spectra in the server's\n"
+         << "                                   cache. Defaults to 256.\n\n"
+         << "    --watch=DIR                    Instead of reading the files given, convert the SPA\n"
+         << "                                   files in directory DIR and then keep the output\n"
+         << "                                   files up to date as new SPA files are written to\n"
+         << "                                   DIR, until stopped. Each file is read only once.\n"
+         << "                                   Cannot be used with --align or --baseline-anchors.\n\n"
+         << "    --cache-dir=DIR                Keep decoded spectra in directory DIR, shared by\n"
+         << "                                   later runs. A file that has not changed since it\n"
+         << "                                   was cached is not read again; a copy of a cached\n"
+         << "                                   file is recognized by its content.\n\n"
+         << "    --cache-budget=N14             Keep the cache directory to about N14 MiB,\n"
+         << "                                   dropping the least recently used spectra first.\n"
+         << "                                   Defaults to 1024.\n\n"
+         << "    --io-backend=sync|io_uring     How files are read. sync (the default) reads each\n"
+         << "                                   file with blocking calls on the --stage-threads\n"
+         << "                                   read threads; io_uring keeps many reads in flight\n"
+         << "                                   from one thread (Linux 5.17 or later), falling\n"
+         << "                                   back to sync where it is unavailable.\n\n"
+         << "    --io-depth=N15                 With io_uring, read at most N15 files at once.\n"
+         << "                                   Defaults to 64.\n\n"
+         << "    --input-dir=DIR                Also read every .SPA file under directory DIR and\n"
+         << "                                   its subdirectories, in natural order (numbers in\n"
+         << "                                   names compare by value: 11361_2-16 comes before\n"
+         << "                                   113121_2-22).\n\n"
+         << "    --glob=PATTERN                 Also read the files matching PATTERN, in natural\n"
+         << "                                   order; quote it so the shell does not expand it.\n"
+         << "                                   With --input-dir, read the files under DIR whose\n"
+         << "                                   names match PATTERN instead of the .SPA files.\n\n"
+         << "    --manifest=FILE                Also read the files listed in FILE, one path per\n"
+         << "                                   line, in the order given; - reads the list from\n"
+         << "                                   standard input. Files named on the command line\n"
+         << "                                   come first, then these, then --input-dir/--glob.\n\n"
+         << "    --input-tar=FILE               Read the .SPA files inside the uncompressed tar\n"
+         << "                                   archive FILE, in natural order, without extracting\n"
+         << "                                   them; columns are titled with the member names.\n"
+         << "                                   Cannot be used with other SPA files.\n\n"
+         << "    --memory-budget=SIZE           If the spectra and the data sets computed from them\n"
+         << "                                   need more than SIZE bytes (e.g. 512M or 8G), keep\n"
+         << "                                   them in scratch files in $TMPDIR (or the current\n"
+         << "                                   directory) mapped into memory, so only the parts in\n"
+         << "                                   use need to be in RAM. Results are unchanged.\n\n"
+         << "    --report=FILE                  Write a JSON report of the run to FILE: wall and\n"
+         << "                                   CPU time, spectra, bytes read and written and\n"
+         << "                                   allocations of each stage (reading, every data\n"
+         << "                                   set computed, every CSV file written), and the\n"
+         << "                                   peak resident memory.\n\n"
+         << "    --perf-counters                Also count cycles, instructions, last-level cache\n"
+         << "                                   misses and branch misses in each --report stage\n"
+         << "                                   (Linux perf_event_open), with instructions per\n"
+         << "                                   cycle and bytes per cycle. Where the kernel does\n"
+         << "                                   not allow it, the report has times only.\n\n"
+         << "    --trace=FILE                   Write a timeline of the run to FILE: when each\n"
+         << "                                   file was read and transformed, each data set\n"
+         << "                                   computed and each block of CSV rows formatted and\n"
+         << "                                   written, on which thread. Open it in\n"
+         << "                                   ui.perfetto.dev or chrome://tracing.\n\n"
+         << "    --jobs-file=FILE               Run every job in FILE on one read of the SPA files.\n"
+         << "                                   Each line is a job name followed by any of -u, -l,\n"
+         << "                                   --calculate-const-corr, --group-files and\n"
+         << "                                   --aggregate (e.g. 'ch -u=3000 -l=2800\n"
+         << "                                   --group-files=3'); lines starting with # are\n"
+         << "                                   skipped. Each job saves what a run with its options\n"
+         << "                                   would, with its name and a '.' in front of every\n"
+         << "                                   file name. Data sets needed by several jobs are\n"
+         << "                                   computed once, and the files are written in\n"
+         << "                                   parallel. Cannot be used with those options,\n"
+         << "                                   --report-outliers or --baseline-anchors.\n\n"
+         << "    --quantize=float16|int16       Keep the spectra in 16 bits per value instead of 32,\n"
+         << "                                   for screening more files than fit in memory:\n"
+         << "                                   float16 (half precision) or int16 (scaled to each\n"
+         << "                                   spectrum's range). Files are read 256 at a time and\n"
+         << "                                   every data set is computed from the stored values;\n"
+         << "                                   the largest error introduced is printed. Cannot be\n"
+         << "                                   used with --align, --baseline-anchors,\n"
+         << "                                   --report-outliers or --jobs-file.\n\n"
+         << "    --output-format=csv|spz        Save each data set as CSV (the default) or\n"
+         << "                                   losslessly compressed to a .spz file of the same\n"
+         << "                                   name, about a sixth of the size of the CSV file.\n"
+         << "                                   Cannot be used with --region-column.\n\n"
+         << "    --spz-to-csv=FILE              Instead of reading SPA files, turn the .spz file\n"
+         << "                                   FILE back into the CSV file it stands for, named\n"
+         << "                                   as the .spz file with .CSV in place of .spz.\n\n"
+         << "    --summation=MODE               How the means and correction offsets are summed:\n"
+         << "                                   'pairwise' (default), in a fixed tree of halves,\n"
+         << "                                   or 'compensated', in file order with a running\n"
+         << "                                   correction (more accurate, slower). Either way\n"
+         << "                                   the outputs do not depend on --threads.\n\n";
 }
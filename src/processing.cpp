@@ -0,0 +1,323 @@
+#include "processing.h"
+#include "scratch-matrix.h"
+#include "summation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <new>
+
+using namespace std;
+
+// Convert a wavenumber to nearest index
+int wavenumToIndex(int wavenumber, float wavenumberArray[], int size)
+{
+	//cout << "wavenumToIndex(int): passed argument 'wavenumber' = " << wavenumber << "." << endl;
+	int candidateIndex = 0;
+    // Find the value in wavenumberArray that is closest to wavenumber
+    for(int i = 0; i < size; i++)
+    {
+    	if(wavenumber < wavenumberArray[i]) 
+    		candidateIndex = i;
+    	else 
+    		break;
+    } // candidateIndex now stores the index of the wavenumberArray value which is JUST GREATER THAN wavenumber
+    float leftDistance = abs(wavenumber - wavenumberArray[candidateIndex]);
+    float rightDistance = abs(wavenumber - wavenumberArray[candidateIndex + 1]);
+    if(leftDistance == rightDistance || leftDistance < rightDistance)
+    {
+    	//cout << "Found candidateIndex: " << candidateIndex << " with corresponding value " << wavenumberArray[candidateIndex] << "." << endl;
+    	return candidateIndex;
+    }
+    else
+    {
+    	//cout << "Found candidateIndex: " << candidateIndex + 1 << " with corresponding value " << wavenumberArray[candidateIndex + 1] << "." << endl;
+    	return candidateIndex + 1; 	// Note: candidateIndex cannot ever be the last index;
+    								// this is prevented by truncation and checkBounds()
+    }
+}
+
+// Each mean is summed in the order summation.h fixes, so it does not depend on how callers
+// split the groups between threads
+spa::Status computeAverages(float** AVG_DATA, float** IR_DATA, int numGroups, int groupSize, int SIZE)
+{
+    if(groupSize < 1) return spa::ERROR_ARGUMENT;
+    const SummationMode mode = summationMode();
+    for(int j = 0; j < numGroups; j++)
+    {
+        spa::Status status = sumSpectra(AVG_DATA[j], &IR_DATA[j*groupSize], groupSize, 0, SIZE, mode);
+        if(status != spa::OK) return status;
+        for(int i = 0; i < SIZE; i++)
+            AVG_DATA[j][i] = AVG_DATA[j][i] / (float)groupSize;
+    }
+    return spa::OK;
+}
+
+// Sorting networks for the group sizes we use (3-5 replicates). Each compare-exchange is
+// a min/max pair, so a whole network is branch-free and the loops below, which apply it
+// to contiguous wavenumber lanes, compile to packed min/max instructions.
+static inline void compareExchange(float& a, float& b)
+{
+    float lo = min(a, b);
+    float hi = max(a, b);
+    a = lo;
+    b = hi;
+}
+
+template <int N> static inline void sortNetwork(float v[N]);
+
+template <> inline void sortNetwork<3>(float v[3])
+{
+    compareExchange(v[0], v[1]);
+    compareExchange(v[1], v[2]);
+    compareExchange(v[0], v[1]);
+}
+
+template <> inline void sortNetwork<4>(float v[4])
+{
+    compareExchange(v[0], v[1]);
+    compareExchange(v[2], v[3]);
+    compareExchange(v[0], v[2]);
+    compareExchange(v[1], v[3]);
+    compareExchange(v[1], v[2]);
+}
+
+template <> inline void sortNetwork<5>(float v[5])
+{
+    compareExchange(v[0], v[1]);
+    compareExchange(v[3], v[4]);
+    compareExchange(v[2], v[4]);
+    compareExchange(v[2], v[3]);
+    compareExchange(v[1], v[4]);
+    compareExchange(v[0], v[3]);
+    compareExchange(v[0], v[2]);
+    compareExchange(v[1], v[3]);
+    compareExchange(v[1], v[2]);
+}
+
+// Trimmed means of one group; the summation is a template argument so the loop vectorizes
+template <int N, SummationMode SUMMATION> static void trimmedMeanGroup(float* __restrict avg, float* col[N], int SIZE)
+{
+    for(int i = 0; i < SIZE; i++)
+    {
+        float v[N];
+        for(int k = 0; k < N; k++)
+            v[k] = col[k][i];
+        sortNetwork<N>(v);
+        float sum = sumTerms(SUMMATION, N - 2, [&](int k) { return v[k + 1]; });
+        avg[i] = sum / (float)(N - 2);
+    }
+    return;
+}
+
+// Apply the network for one group across every wavenumber
+template <int N> static void aggregateGroup(float* __restrict avg, float** group, int SIZE, AggregateMode mode)
+{
+    float* col[N];
+    for(int k = 0; k < N; k++)
+        col[k] = group[k];
+
+    if(mode == AGGREGATE_MEDIAN)
+        for(int i = 0; i < SIZE; i++)
+        {
+            float v[N];
+            for(int k = 0; k < N; k++)
+                v[k] = col[k][i];
+            sortNetwork<N>(v);
+            avg[i] = (N % 2 == 1 ? v[N / 2] : 0.5f * (v[N / 2 - 1] + v[N / 2]));
+        }
+    else if(summationMode() == SUM_COMPENSATED)
+        trimmedMeanGroup<N, SUM_COMPENSATED>(avg, col, SIZE);
+    else
+        trimmedMeanGroup<N, SUM_PAIRWISE>(avg, col, SIZE);
+    return;
+}
+
+// Fallback for group sizes without a network: insertion sort per wavenumber
+static spa::Status aggregateGroupGeneric(float* avg, float** group, int groupSize, int SIZE, AggregateMode mode)
+{
+    float* v = new (nothrow) float [groupSize];
+    if(v == nullptr) return spa::ERROR_OUT_OF_MEMORY;
+    const SummationMode summation = summationMode();
+    for(int i = 0; i < SIZE; i++)
+    {
+        for(int k = 0; k < groupSize; k++)
+        {
+            float value = group[k][i];
+            int m = k;
+            for(; m > 0 && v[m - 1] > value; m--)
+                v[m] = v[m - 1];
+            v[m] = value;
+        }
+        if(mode == AGGREGATE_MEDIAN)
+            avg[i] = (groupSize % 2 == 1 ? v[groupSize / 2] : 0.5f * (v[groupSize / 2 - 1] + v[groupSize / 2]));
+        else
+            avg[i] = sumTerms(summation, groupSize - 2, [&](int k) { return v[k + 1]; }) / (float)(groupSize - 2);
+    }
+    delete[] v;
+    return spa::OK;
+}
+
+static spa::Status computeRobustAggregate(float** AVG_DATA, float** IR_DATA, int numGroups, int groupSize, int SIZE, AggregateMode mode)
+{
+    for(int j = 0; j < numGroups; j++)
+    {
+        float** group = &IR_DATA[j*groupSize];
+        spa::Status status = spa::OK;
+        switch(groupSize)
+        {
+            case 3: aggregateGroup<3>(AVG_DATA[j], group, SIZE, mode); break;
+            case 4: aggregateGroup<4>(AVG_DATA[j], group, SIZE, mode); break;
+            case 5: aggregateGroup<5>(AVG_DATA[j], group, SIZE, mode); break;
+            default: status = aggregateGroupGeneric(AVG_DATA[j], group, groupSize, SIZE, mode);
+        }
+        if(status != spa::OK) return status;
+    }
+    return spa::OK;
+}
+
+spa::Status computeMedians(float** AVG_DATA, float** IR_DATA, int numGroups, int groupSize, int SIZE)
+{
+    if(groupSize < 3) // The median of one or two values is their mean
+        return computeAverages(AVG_DATA, IR_DATA, numGroups, groupSize, SIZE);
+    return computeRobustAggregate(AVG_DATA, IR_DATA, numGroups, groupSize, SIZE, AGGREGATE_MEDIAN);
+}
+
+spa::Status computeTrimmedMeans(float** AVG_DATA, float** IR_DATA, int numGroups, int groupSize, int SIZE)
+{
+    if(groupSize < 3) // Nothing would be left after trimming
+        return computeAverages(AVG_DATA, IR_DATA, numGroups, groupSize, SIZE);
+    return computeRobustAggregate(AVG_DATA, IR_DATA, numGroups, groupSize, SIZE, AGGREGATE_TRIMMED_MEAN);
+}
+
+spa::Status computeAggregate(float** AVG_DATA, float** IR_DATA, int numGroups, int groupSize, int SIZE, AggregateMode mode)
+{
+    switch(mode)
+    {
+        case AGGREGATE_MEDIAN: return computeMedians(AVG_DATA, IR_DATA, numGroups, groupSize, SIZE);
+        case AGGREGATE_TRIMMED_MEAN: return computeTrimmedMeans(AVG_DATA, IR_DATA, numGroups, groupSize, SIZE);
+        default: return computeAverages(AVG_DATA, IR_DATA, numGroups, groupSize, SIZE);
+    }
+}
+
+// Values the aggregate drops from each end of a group at every wavenumber: the trimmed mean
+// drops the lowest and highest, the median all but the middle one or two, and groups of
+// fewer than three are averaged
+static int numDroppedPerEnd(int groupSize, AggregateMode mode)
+{
+    if(groupSize < 3) return 0;
+    switch(mode)
+    {
+        case AGGREGATE_MEDIAN: return (groupSize - 1) / 2;
+        case AGGREGATE_TRIMMED_MEAN: return 1;
+        default: return 0;
+    }
+}
+
+// Count, for each file, at how many wavenumbers in [firstIndex, lastIndex] the aggregate mode
+// dropped its value as one of the lowest or one of the highest of its group. Ties go to the
+// earlier file.
+void countGroupRejections(int timesLowest[], int timesHighest[], float** IR_DATA, int numGroups, int groupSize,
+    int firstIndex, int lastIndex, AggregateMode mode)
+{
+    for(int j = 0; j < numGroups*groupSize; j++)
+    {
+        timesLowest[j] = 0;
+        timesHighest[j] = 0;
+    }
+    const int numDropped = numDroppedPerEnd(groupSize, mode);
+    if(numDropped == 0) return;
+    for(int j = 0; j < numGroups; j++)
+        for(int i = firstIndex; i < lastIndex + 1; i++)
+            for(int k = j*groupSize; k < (j + 1)*groupSize; k++)
+            {
+                // Files ranked before file k from the low and from the high end
+                int lowRank = 0;
+                int highRank = 0;
+                for(int m = j*groupSize; m < (j + 1)*groupSize; m++)
+                {
+                    if(m == k) continue;
+                    if(IR_DATA[m][i] < IR_DATA[k][i] || (m < k && IR_DATA[m][i] == IR_DATA[k][i])) lowRank++;
+                    if(IR_DATA[m][i] > IR_DATA[k][i] || (m < k && IR_DATA[m][i] == IR_DATA[k][i])) highRank++;
+                }
+                if(lowRank < numDropped) timesLowest[k]++;
+                if(highRank < numDropped) timesHighest[k]++;
+            }
+    return;
+}
+
+// The mean spectrum over every file. Independent of the correction window, so a run that
+// corrects over several windows (--jobs-file) computes it once.
+spa::Status computeMeanSpectrum(float meanSpectrum[], float** IR_DATA, int NUM_SPA_FILES, int SIZE)
+{
+    if(NUM_SPA_FILES < 1) return spa::ERROR_ARGUMENT;
+    // A block of rows at a time so that a matrix mapped from a scratch file is read one page
+    // per spectrum per block, the next block read ahead and the finished one let go first;
+    // each sum adds the files in the same order whatever the block
+    const int ROWS_PER_BLOCK = scratchRowsPerBlock();
+    const SummationMode mode = summationMode();
+    for(int firstRow = 0; firstRow < SIZE; firstRow += ROWS_PER_BLOCK)
+    {
+        int lastRow = min(firstRow + ROWS_PER_BLOCK, SIZE) - 1;
+        if(lastRow + 1 < SIZE) adviseRowBlock(IR_DATA, NUM_SPA_FILES, lastRow + 1, min(lastRow + ROWS_PER_BLOCK, SIZE - 1), true);
+        spa::Status status = sumSpectra(meanSpectrum + firstRow, IR_DATA, NUM_SPA_FILES, firstRow, lastRow - firstRow + 1, mode);
+        if(status != spa::OK) return status;
+        for(int i = firstRow; i <= lastRow; i++)
+            meanSpectrum[i] = meanSpectrum[i] / (float)NUM_SPA_FILES;
+        adviseRowBlock(IR_DATA, NUM_SPA_FILES, firstRow, lastRow, false);
+    }
+    return spa::OK;
+}
+
+// Mean distance of each spectrum from the mean spectrum over the correction interval
+void computeConstCorrOffsets(
+    float offsets[],
+    const float meanSpectrum[],
+    float** IR_DATA,
+    int NUM_SPA_FILES,
+    float WAVENUMBER[],
+    int SIZE,
+    int ubCorr,
+    int lbCorr
+)
+{
+    int lbCorrIndex = wavenumToIndex(ubCorr, WAVENUMBER, SIZE);
+    int ubCorrIndex = wavenumToIndex(lbCorr, WAVENUMBER, SIZE);
+    const SummationMode mode = summationMode();
+    for(int i = 0; i < NUM_SPA_FILES; i++)
+    {
+        const float* spectrum = IR_DATA[i];
+        float sum = sumTerms(mode, ubCorrIndex - lbCorrIndex + 1,
+            [&](int k) { return meanSpectrum[lbCorrIndex + k] - spectrum[lbCorrIndex + k]; });
+        offsets[i] = sum / (float)(ubCorrIndex - lbCorrIndex + 1);
+    }
+    return;
+}
+
+void applyConstCorr(float** CORR_DATA, float** IR_DATA, const float offsets[], int NUM_SPA_FILES, int SIZE)
+{
+    for(int i = 0; i < NUM_SPA_FILES; i++)
+        for(int j = 0; j < SIZE; j++)
+            CORR_DATA[i][j] = offsets[i] + IR_DATA[i][j];
+    return;
+}
+
+spa::Status computeConstCorr(float** CORR_DATA, float** IR_DATA, int NUM_SPA_FILES, float WAVENUMBER[], int SIZE, int ubCorr, int lbCorr)
+{
+    spa::Status status = spa::validateBounds(&ubCorr, &lbCorr);
+    if(status != spa::OK) return status;
+    float* baseline = new (nothrow) float [SIZE];
+    float* averageDiffOverInterval = new (nothrow) float [NUM_SPA_FILES];
+    if(baseline == nullptr || averageDiffOverInterval == nullptr)
+        status = spa::ERROR_OUT_OF_MEMORY;
+    if(status == spa::OK)
+        status = computeMeanSpectrum(baseline, IR_DATA, NUM_SPA_FILES, SIZE);
+    if(status == spa::OK)
+    {
+        computeConstCorrOffsets(averageDiffOverInterval, baseline, IR_DATA, NUM_SPA_FILES, WAVENUMBER, SIZE, ubCorr, lbCorr);
+        applyConstCorr(CORR_DATA, IR_DATA, averageDiffOverInterval, NUM_SPA_FILES, SIZE);
+    }
+
+    delete[] baseline;
+    delete[] averageDiffOverInterval;
+    return status;
+}
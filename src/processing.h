@@ -0,0 +1,54 @@
+#ifndef PROCESSING_H
+#define PROCESSING_H
+
+#include "spa.h"
+
+// libspa: combining spectra. Each group of groupSize consecutive spectra becomes one spectrum,
+// and the constant correction moves each spectrum towards the mean of all of them. The
+// spectra are float** with one spectrum per column, as spa-reader holds them.
+
+// How the spectra within a group are combined into a single spectrum
+enum AggregateMode
+{
+    AGGREGATE_MEAN,
+    AGGREGATE_MEDIAN,
+    AGGREGATE_TRIMMED_MEAN // drops the lowest and highest value at each wavenumber
+};
+
+int wavenumToIndex(int wavenumber, float wavenumberArray[], int size);
+
+// AVG_DATA[j] from IR_DATA[j*groupSize] to IR_DATA[(j + 1)*groupSize - 1]
+spa::Status computeAverages(float** AVG_DATA, float** IR_DATA, int numGroups, int groupSize, int SIZE);
+spa::Status computeMedians(float** AVG_DATA, float** IR_DATA, int numGroups, int groupSize, int SIZE);
+spa::Status computeTrimmedMeans(float** AVG_DATA, float** IR_DATA, int numGroups, int groupSize, int SIZE);
+spa::Status computeAggregate(float** AVG_DATA, float** IR_DATA, int numGroups, int groupSize, int SIZE, AggregateMode mode);
+void countGroupRejections(int timesLowest[], int timesHighest[], float** IR_DATA, int numGroups, int groupSize,
+    int firstIndex, int lastIndex, AggregateMode mode);
+
+// CORR_DATA[i] = IR_DATA[i] + (mean of all spectra - IR_DATA[i]) averaged over the correction
+// bounds
+spa::Status computeConstCorr(
+    float** CORR_DATA,
+    float** IR_DATA,
+    int NUM_SPA_FILES,
+    float WAVENUMBER[],
+    int SIZE,
+    int upperBoundCorrection,
+    int lowerBoundCorrection
+);
+// The steps of computeConstCorr(), for sharing the mean spectrum between correction windows.
+// The bounds must already have passed spa::validateBounds().
+spa::Status computeMeanSpectrum(float meanSpectrum[], float** IR_DATA, int NUM_SPA_FILES, int SIZE);
+void computeConstCorrOffsets(
+    float offsets[],
+    const float meanSpectrum[],
+    float** IR_DATA,
+    int NUM_SPA_FILES,
+    float WAVENUMBER[],
+    int SIZE,
+    int upperBoundCorrection,
+    int lowerBoundCorrection
+);
+void applyConstCorr(float** CORR_DATA, float** IR_DATA, const float offsets[], int NUM_SPA_FILES, int SIZE);
+
+#endif // PROCESSING_H
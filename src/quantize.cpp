@@ -0,0 +1,330 @@
+#include "quantize.h"
+#include "parallel.h"
+#include "summation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <vector>
+
+QuantizedFormat parseQuantizedFormat(const char* formatStr)
+{
+    const char* funcDef = "QuantizedFormat parseQuantizedFormat(const char*)";
+    if(std::strcmp(formatStr, "float16") == 0) return QUANTIZE_FLOAT16;
+    if(std::strcmp(formatStr, "int16") == 0) return QUANTIZE_INT16;
+    std::cerr << "Error: " << funcDef << ": unknown quantized format '" << formatStr << "'. Expected float16 or int16.\n";
+    std::exit(1);
+}
+
+const char* quantizedFormatName(QuantizedFormat format)
+{
+    return ( format == QUANTIZE_INT16 ? "int16" : "float16" );
+}
+
+// IEEE half precision, rounded to nearest even, as F16C's vcvtps2ph does: overflow gives
+// infinity, NaNs stay NaNs (quiet, keeping the top of the payload)
+static uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    bits &= 0x7fffffff;
+    if(bits > 0x7f800000) return sign | 0x7e00 | (uint16_t)((bits >> 13) & 0x3ff);
+    if(bits >= 0x47800000) return sign | 0x7c00;   // 65536 or more (including infinity)
+    if(bits < 0x38800000)
+    { // Below the smallest normal half (2^-14): let a float addition round the subnormal
+        const uint32_t MAGIC_BITS = (127 - 15 + 23 - 10 + 1) << 23;    // 0.5
+        float magic;
+        float absValue;
+        std::memcpy(&magic, &MAGIC_BITS, sizeof(magic));
+        std::memcpy(&absValue, &bits, sizeof(absValue));
+        absValue += magic;
+        std::memcpy(&bits, &absValue, sizeof(bits));
+        return sign | (uint16_t)(bits - MAGIC_BITS);
+    }
+    // Rebias the exponent and round the 13 dropped bits to nearest even; a carry out of the
+    // mantissa correctly bumps the exponent, up to infinity
+    const uint32_t mantissaOdd = (bits >> 13) & 1;
+    bits += ((uint32_t)(15 - 127) << 23) + 0xfff + mantissaOdd;
+    return sign | (uint16_t)(bits >> 13);
+}
+
+static float halfToFloat(uint16_t half)
+{
+    const uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1f;
+    const uint32_t mantissa = half & 0x3ff;
+    uint32_t bits;
+    if(exponent == 0x1f)
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    else if(exponent != 0)
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    else
+    { // Zero or subnormal: mantissa * 2^-24, exact in a float
+        float value = (float)mantissa * 5.9604644775390625e-8f;
+        std::memcpy(&bits, &value, sizeof(bits));
+        bits |= sign;
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+
+#include <immintrin.h>
+
+// Eight values per instruction; compiled for F16C whatever the build targets, and only called
+// once the CPU has been seen to support it
+__attribute__((target("avx,f16c")))
+static void floatsToHalvesF16C(const float values[], uint16_t halves[], int count)
+{
+    int i = 0;
+    for(; i + 8 <= count; i += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(halves + i),
+            _mm256_cvtps_ph(_mm256_loadu_ps(values + i), _MM_FROUND_TO_NEAREST_INT));
+    for(; i < count; i++)
+        halves[i] = floatToHalf(values[i]);
+    return;
+}
+
+__attribute__((target("avx,f16c")))
+static void halvesToFloatsF16C(const uint16_t halves[], float values[], int count)
+{
+    int i = 0;
+    for(; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(values + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(halves + i))));
+    for(; i < count; i++)
+        values[i] = halfToFloat(halves[i]);
+    return;
+}
+
+static bool cpuHasF16C()
+{
+    static const bool hasF16C = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+    return hasF16C;
+}
+
+#else // no F16C
+
+static void floatsToHalvesF16C(const float[], uint16_t[], int) {}
+static void halvesToFloatsF16C(const uint16_t[], float[], int) {}
+static bool cpuHasF16C() { return false; }
+
+#endif
+
+static void floatsToHalves(const float values[], uint16_t halves[], int count)
+{
+    if(cpuHasF16C())
+        floatsToHalvesF16C(values, halves, count);
+    else
+        for(int i = 0; i < count; i++)
+            halves[i] = floatToHalf(values[i]);
+    return;
+}
+
+static void halvesToFloats(const uint16_t halves[], float values[], int count)
+{
+    if(cpuHasF16C())
+        halvesToFloatsF16C(halves, values, count);
+    else
+        for(int i = 0; i < count; i++)
+            values[i] = halfToFloat(halves[i]);
+    return;
+}
+
+float quantizeValues(QuantizedFormat format, const float values[], int count, uint16_t codes[], float* offset, float* scale,
+    const int firstIndex[], const int lastIndex[], int numRanges)
+{
+    *offset = 0;
+    *scale = 1;
+    if(format == QUANTIZE_FLOAT16)
+        floatsToHalves(values, codes, count);
+    else
+    { // The range's midpoint maps to 0 and its ends to -32767 and 32767
+        float minValue = values[firstIndex[0]];
+        float maxValue = values[firstIndex[0]];
+        for(int r = 0; r < numRanges; r++)
+            for(int i = firstIndex[r]; i <= lastIndex[r]; i++)
+            {
+                minValue = std::min(minValue, values[i]);
+                maxValue = std::max(maxValue, values[i]);
+            }
+        *offset = minValue + (maxValue - minValue) / 2;
+        *scale = ( maxValue > minValue ? (maxValue - minValue) / 65534 : 1 );
+        for(int i = 0; i < count; i++)
+        {
+            float q = std::nearbyint((values[i] - *offset) / *scale);
+            q = std::min(std::max(q, -32767.0f), 32767.0f);
+            codes[i] = (uint16_t)(int16_t)q;
+        }
+    }
+    // The error of what will be decoded, not of the formula
+    float maxError = 0;
+    float decoded[256];
+    for(int r = 0; r < numRanges; r++)
+        for(int first = firstIndex[r]; first <= lastIndex[r]; first += 256)
+        {
+            int blockCount = std::min(256, lastIndex[r] + 1 - first);
+            dequantizeValues(format, codes + first, blockCount, *offset, *scale, decoded);
+            for(int i = 0; i < blockCount; i++)
+                maxError = std::max(maxError, std::fabs(decoded[i] - values[first + i]));
+        }
+    return maxError;
+}
+
+void dequantizeValues(QuantizedFormat format, const uint16_t codes[], int count, float offset, float scale, float values[])
+{
+    if(format == QUANTIZE_FLOAT16)
+        halvesToFloats(codes, values, count);
+    else // g++ -O3 vectorizes this
+        for(int i = 0; i < count; i++)
+            values[i] = offset + scale * (float)(int16_t)codes[i];
+    return;
+}
+
+QuantizedSpectra* createQuantizedSpectra(QuantizedFormat format, int numCols, int numRows, const char* ptrDef)
+{
+    const char* funcDef = "QuantizedSpectra* createQuantizedSpectra(QuantizedFormat, int, int, const char*)";
+    QuantizedSpectra* spectra = new (std::nothrow) QuantizedSpectra;
+    checkIfNull(spectra, funcDef, ptrDef);
+    spectra->format = format;
+    spectra->numCols = numCols;
+    spectra->numRows = numRows;
+    spectra->codes = new (std::nothrow) uint16_t* [numCols];
+    spectra->offsets = new (std::nothrow) float [numCols];
+    spectra->scales = new (std::nothrow) float [numCols];
+    spectra->maxErrors = new (std::nothrow) float [numCols];
+    checkIfNull(spectra->codes, funcDef, ptrDef);
+    checkIfNull(spectra->offsets, funcDef, ptrDef);
+    checkIfNull(spectra->scales, funcDef, ptrDef);
+    checkIfNull(spectra->maxErrors, funcDef, ptrDef);
+    for(int i = 0; i < numCols; i++)
+    {
+        spectra->codes[i] = new (std::nothrow) uint16_t [numRows];
+        checkIfNull(spectra->codes[i], funcDef, ptrDef);
+        spectra->maxErrors[i] = 0;
+    }
+    return spectra;
+}
+
+void deleteQuantizedSpectra(QuantizedSpectra* spectra)
+{
+    if(spectra == nullptr) return;
+    for(int i = 0; i < spectra->numCols; i++)
+        delete[] spectra->codes[i];
+    delete[] spectra->codes;
+    delete[] spectra->offsets;
+    delete[] spectra->scales;
+    delete[] spectra->maxErrors;
+    delete spectra;
+    return;
+}
+
+void quantizeSpectrum(QuantizedSpectra* spectra, int col, const float values[],
+    const int firstIndex[], const int lastIndex[], int numRanges)
+{
+    spectra->maxErrors[col] = quantizeValues(spectra->format, values, spectra->numRows, spectra->codes[col],
+        &spectra->offsets[col], &spectra->scales[col], firstIndex, lastIndex, numRanges);
+    return;
+}
+
+void decodeSpectrumRows(const QuantizedSpectra* spectra, int col, int firstRow, int numRows, float values[])
+{
+    dequantizeValues(spectra->format, spectra->codes[col] + firstRow, numRows, spectra->offsets[col], spectra->scales[col], values);
+    return;
+}
+
+float largestQuantizationError(const QuantizedSpectra* spectra)
+{
+    float maxError = 0;
+    for(int i = 0; i < spectra->numCols; i++)
+        maxError = std::max(maxError, spectra->maxErrors[i]);
+    return maxError;
+}
+
+// Spectrum col decoded, plus its correction (as applyConstCorr() adds it) if offsets is given
+static void decodeSpectrum(const QuantizedSpectra* spectra, const float offsets[], int col, float values[])
+{
+    decodeSpectrumRows(spectra, col, 0, spectra->numRows, values);
+    if(offsets != nullptr)
+        for(int i = 0; i < spectra->numRows; i++)
+            values[i] = offsets[col] + values[i];
+    return;
+}
+
+void computeQuantizedAggregate(
+    float** AVG_DATA,
+    const QuantizedSpectra* spectra,
+    const float offsets[],
+    int numGroups,
+    int groupSize,
+    AggregateMode mode,
+    int numThreads
+)
+{
+    // One group's spectra at a time per thread
+    const int SIZE = spectra->numRows;
+    std::vector<float**> workspaces(numThreads, nullptr);
+    for(int t = 0; t < numThreads; t++)
+        workspaces[t] = createFloatArray(groupSize, SIZE, "float** workspaces[t]");
+    parallelFor(numGroups, numThreads, [&](int group, int thread)
+    {
+        float** members = workspaces[thread];
+        for(int k = 0; k < groupSize; k++)
+            decodeSpectrum(spectra, offsets, group * groupSize + k, members[k]);
+        checkStatus(computeAggregate(AVG_DATA + group, members, 1, groupSize, SIZE, mode),
+            "void computeQuantizedAggregate(float**, const QuantizedSpectra*, const float [], int, int, AggregateMode, int)",
+            "float** AVG_DATA");
+    });
+    for(int t = 0; t < numThreads; t++)
+        freeFloatArray(workspaces[t], groupSize);
+    return;
+}
+
+void computeQuantizedConstCorrOffsets(
+    float offsets[],
+    const QuantizedSpectra* spectra,
+    float WAVENUMBER[],
+    int ubCorr,
+    int lbCorr
+)
+{
+    const char* funcDef = "void computeQuantizedConstCorrOffsets(float [], const QuantizedSpectra*, float [], int, int)";
+    const int SIZE = spectra->numRows;
+    const int NUM_SPA_FILES = spectra->numCols;
+    float* meanSpectrum = new (std::nothrow) float [SIZE];
+    float* spectrum = new (std::nothrow) float [SIZE];
+    checkIfNull(meanSpectrum, funcDef, "float* meanSpectrum");
+    checkIfNull(spectrum, funcDef, "float* spectrum");
+    // Summed in the order computeMeanSpectrum() uses, from a block of rows of every spectrum
+    // decoded at a time
+    const int ROWS_PER_BLOCK = 512;
+    float** block = createFloatArray(NUM_SPA_FILES, ROWS_PER_BLOCK, "float** block");
+    const SummationMode mode = summationMode();
+    for(int firstRow = 0; firstRow < SIZE; firstRow += ROWS_PER_BLOCK)
+    {
+        int numRows = std::min(ROWS_PER_BLOCK, SIZE - firstRow);
+        for(int j = 0; j < NUM_SPA_FILES; j++)
+            decodeSpectrumRows(spectra, j, firstRow, numRows, block[j]);
+        checkStatus(sumSpectra(meanSpectrum + firstRow, block, NUM_SPA_FILES, 0, numRows, mode), funcDef, "float* meanSpectrum");
+    }
+    freeFloatArray(block, NUM_SPA_FILES);
+    for(int i = 0; i < SIZE; i++)
+        meanSpectrum[i] = meanSpectrum[i] / (float)NUM_SPA_FILES;
+
+    // Only the correction window of each spectrum is looked at
+    const int firstIndex = wavenumToIndex(ubCorr, WAVENUMBER, SIZE);
+    const int lastIndex = wavenumToIndex(lbCorr, WAVENUMBER, SIZE);
+    for(int j = 0; j < NUM_SPA_FILES; j++)
+    {
+        decodeSpectrumRows(spectra, j, firstIndex, lastIndex - firstIndex + 1, spectrum + firstIndex);
+        computeConstCorrOffsets(offsets + j, meanSpectrum, &spectrum, 1, WAVENUMBER, SIZE, ubCorr, lbCorr);
+    }
+    delete[] meanSpectrum;
+    delete[] spectrum;
+    return;
+}
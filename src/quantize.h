@@ -0,0 +1,76 @@
+#ifndef QUANTIZE_H
+#define QUANTIZE_H
+
+#include "data-processing.h"
+
+#include <cstdint>
+
+// Spectra kept in 16 bits per value instead of 32 (--quantize and the server's quantized
+// binary replies), for screening runs over more files than fit in memory as floats. Two
+// encodings, both with every value's error measured when it is stored:
+//     float16  IEEE half precision, 11 significant bits: %T values up to 128 are within 1/32
+//     int16    per-spectrum scaled integers, value = offset + scale * q with q in
+//              [-32767, 32767]: the error is at most (max - min) / 131068 for each spectrum
+enum QuantizedFormat
+{
+    QUANTIZE_FLOAT16,
+    QUANTIZE_INT16
+};
+
+QuantizedFormat parseQuantizedFormat(const char* formatStr);
+const char* quantizedFormatName(QuantizedFormat format);
+
+// count values as 16-bit codes (int16 codes are stored as their bit patterns); int16 sets
+// *offset and *scale, float16 leaves them 0 and 1. Only the values in the index ranges
+// [firstIndex[r], lastIndex[r]] are used: int16 scales to their range, and values elsewhere
+// (rows that were not read) are clamped into it. Returns the largest absolute error over the
+// ranges.
+float quantizeValues(QuantizedFormat format, const float values[], int count, uint16_t codes[], float* offset, float* scale,
+    const int firstIndex[], const int lastIndex[], int numRanges);
+// The inverse; float16 is converted with F16C instructions where the CPU has them
+void dequantizeValues(QuantizedFormat format, const uint16_t codes[], int count, float offset, float scale, float values[]);
+
+// numCols spectra of numRows values, one array of codes per spectrum. Always in memory, even
+// with --memory-budget.
+struct QuantizedSpectra
+{
+    QuantizedFormat format;
+    int numCols;
+    int numRows;
+    uint16_t** codes;
+    float* offsets;
+    float* scales;
+    float* maxErrors;   // largest absolute error of each spectrum
+};
+
+QuantizedSpectra* createQuantizedSpectra(QuantizedFormat format, int numCols, int numRows, const char* ptrDef);
+void deleteQuantizedSpectra(QuantizedSpectra* spectra);
+// Store values[] as spectrum col, used over the given index ranges as in quantizeValues();
+// threads may store different spectra at once
+void quantizeSpectrum(QuantizedSpectra* spectra, int col, const float values[],
+    const int firstIndex[], const int lastIndex[], int numRanges);
+// Rows firstRow to firstRow + numRows - 1 of spectrum col
+void decodeSpectrumRows(const QuantizedSpectra* spectra, int col, int firstRow, int numRows, float values[]);
+float largestQuantizationError(const QuantizedSpectra* spectra);
+
+// computeAggregate() and computeConstCorr() for quantized spectra, each spectrum decoded when
+// needed, giving what they give for the decoded spectra. With offsets (the constant
+// correction of each spectrum) the corrected spectra are aggregated.
+void computeQuantizedAggregate(
+    float** AVG_DATA,
+    const QuantizedSpectra* spectra,
+    const float offsets[],
+    int numGroups,
+    int groupSize,
+    AggregateMode mode,
+    int numThreads
+);
+void computeQuantizedConstCorrOffsets(
+    float offsets[],
+    const QuantizedSpectra* spectra,
+    float WAVENUMBER[],
+    int upperBoundCorrection,
+    int lowerBoundCorrection
+);
+
+#endif // QUANTIZE_H
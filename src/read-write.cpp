@@ -1,37 +1,463 @@
+#include "conversion-cache.h"
+#include "csv.h"
 #include "data-processing.h"
+#include "parallel.h"
+#include "pipeline.h"
+#include "quantize.h"
 #include "read-write.h"
+#include "run-report.h"
+#include "scratch-matrix.h"
+#include "spa.h"
+#include "spectrum-codec.h"
+#include "tar-archive.h"
+#include "trace.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <map>
 #include <string>
+#include <thread>
+#include <vector>
 
 
-// Verify that the SPA file can be opened
-bool canOpenFile(char* FILENAME)
+// Index ranges of each spectrum that readSPAFile() reads; empty for whole spectra
+static std::vector<int> readFirstIndex;
+static std::vector<int> readLastIndex;
+// Ranges closer than this (in data points, 4 bytes each) are read as one: a few extra KiB
+// cost less than another read
+const int READ_RANGE_MERGE_GAP = 1024;
+
+void setSpectrumReadRanges(const int firstIndex[], const int lastIndex[], int numRanges)
+{
+	std::vector<std::pair<int, int> > ranges;
+	for(int r = 0; r < numRanges; r++)
+		ranges.push_back(std::make_pair(std::min(firstIndex[r], lastIndex[r]), std::max(firstIndex[r], lastIndex[r])));
+	std::sort(ranges.begin(), ranges.end());
+	readFirstIndex.clear();
+	readLastIndex.clear();
+	for(size_t r = 0; r < ranges.size(); r++)
+	{
+		if(!readLastIndex.empty() && ranges[r].first <= readLastIndex.back() + READ_RANGE_MERGE_GAP)
+			readLastIndex.back() = std::max(readLastIndex.back(), ranges[r].second);
+		else
+		{
+			readFirstIndex.push_back(ranges[r].first);
+			readLastIndex.push_back(ranges[r].second);
+		}
+	}
+	return;
+}
+
+void getSpectrumReadRanges(std::vector<int>& firstIndex, std::vector<int>& lastIndex)
+{
+	firstIndex = readFirstIndex;
+	lastIndex = readLastIndex;
+	if(firstIndex.empty())
+	{
+		firstIndex.push_back(0);
+		lastIndex.push_back(spa::NUM_POINTS - 1);
+	}
+	return;
+}
+
+// Zero the values outside the read ranges, so nothing downstream sees uninitialized values
+void zeroUnreadValues(float IR_Data[])
 {
-    std::ifstream file (FILENAME, std::ios::in | std::ios::binary);
-	bool ableToOpen = file.is_open();
-	if(ableToOpen) file.close();
-	return ableToOpen;
+	if(readFirstIndex.empty()) return;
+	int nextUnread = 0;
+	for(size_t r = 0; r < readFirstIndex.size(); r++)
+	{
+		std::fill(IR_Data + nextUnread, IR_Data + readFirstIndex[r], 0.0f);
+		nextUnread = readLastIndex[r] + 1;
+	}
+	std::fill(IR_Data + nextUnread, IR_Data + spa::NUM_POINTS, 0.0f);
+	return;
 }
 
-// Read the contents of the SPA file into an array
-void readSPAFile(char* SPA_FILENAME, float IR_Data[], int length, int start)
+// Read the contents of the SPA file into an array; IR_Data must hold spa::NUM_POINTS values
+void readSPAFile(char* SPA_FILENAME, float IR_Data[])
 {
-	const char* funcDef = "void readSPAFile(char*, float [], int, int)";
-    if(canOpenFile(SPA_FILENAME))
+	const char* funcDef = "void readSPAFile(char*, float [])";
+	spa::Status status;
+	const char* memberBytes;
+	size_t memberSize;
+	if(tarArchiveOpen())
+	{ // Decoded from the mapped archive
+		if(!findTarMember(SPA_FILENAME, &memberBytes, &memberSize))
+			status = spa::ERROR_OPEN;
+		else if(!readFirstIndex.empty())
+		{
+			status = spa::decodeSpectrumRanges(memberBytes, memberSize, &readFirstIndex[0], &readLastIndex[0], (int)readFirstIndex.size(), IR_Data);
+			zeroUnreadValues(IR_Data);
+		}
+		else
+			status = spa::decodeSpectrumData(memberBytes, memberSize, IR_Data);
+	}
+	else if(!readFirstIndex.empty())
+	{ // Only the planned ranges
+		status = spa::readSpectrumRanges(SPA_FILENAME, &readFirstIndex[0], &readLastIndex[0], (int)readFirstIndex.size(), IR_Data);
+		zeroUnreadValues(IR_Data);
+	}
+	else
+		status = ( conversionCacheEnabled() ?
+			readSpectrumThroughCache(SPA_FILENAME, IR_Data) : spa::readSpectrumData(SPA_FILENAME, IR_Data) );
+    if(status != spa::OK)
     {
-        std::ifstream spaInputFile (SPA_FILENAME, std::ios::in | std::ios::binary);
-	    // Go to first datum, then read data into IR_Data
-	    spaInputFile.seekg(start, std::ios::beg);
-	    spaInputFile.read(reinterpret_cast<char*>(IR_Data), length*4); // 4 bytes per datum
-	    // We must reinterpret IR_Data as a character pointer in order to correctly read in the data
-	    spaInputFile.close();
-	} else {
-        std::cerr << "Error: " << funcDef << ": Unable to open SPA file '" << SPA_FILENAME << "'." << std::endl;
+        std::cerr << "Error: " << funcDef << ": SPA file '" << SPA_FILENAME << "': " << spa::statusMessage(status) << "." << std::endl;
         std::exit(1);
+    }
+	return;
+}
+
+// Rows are formatted in blocks by the format stage and written in order by the calling thread
+const int CSV_ROWS_PER_BLOCK = 256;
+
+struct CSVOutputStages
+{
+	int formatThreads;
+	int queueDepth;
+	StageStats* formatStats;
+	StageStats* writeStats;
+};
+
+static CSVOutputStages outputStages = {1, 16, nullptr, nullptr};
+
+void setCSVOutputStages(int formatThreads, int queueDepth, StageStats* formatStats, StageStats* writeStats)
+{
+	outputStages.formatThreads = (formatThreads < 1 ? 1 : formatThreads);
+	outputStages.queueDepth = queueDepth;
+	outputStages.formatStats = formatStats;
+	outputStages.writeStats = writeStats;
+	return;
+}
+
+// Rows firstRow to lastRow (inclusive), copied to each target: the index of a file and the
+// text put in front of each row in it ("" for none)
+struct CSVRowSegment
+{
+	int firstRow;
+	int lastRow;
+	std::vector<std::pair<int, std::string> > targets;
+};
+
+// The values written to a CSV file: a float matrix, or quantized spectra decoded a block of
+// rows at a time, plus a constant per spectrum if shifts is not nullptr
+struct CSVSource
+{
+	float** data;
+	const QuantizedSpectra* quantized;
+	const float* shifts;
+};
+
+// Rows firstRow to lastRow of every quantized spectrum, as columns[j][0] to
+// columns[j][lastRow - firstRow]; the shift is added as applyConstCorr() adds it
+static void decodeRowBlock(const CSVSource& source, int numCols, int firstRow, int lastRow,
+	std::vector<float>& decoded, std::vector<float*>& columns)
+{
+	const int numRows = lastRow - firstRow + 1;
+	decoded.resize((size_t)numCols * numRows);
+	columns.resize(numCols);
+	for(int j = 0; j < numCols; j++)
+	{
+		columns[j] = &decoded[(size_t)j * numRows];
+		decodeSpectrumRows(source.quantized, j, firstRow, numRows, columns[j]);
+		if(source.shifts != nullptr)
+			for(int i = 0; i < numRows; i++)
+				columns[j][i] = source.shifts[j] + columns[j][i];
+	}
+	return;
+}
+
+// Copy a block of formatted rows to every target of its segment. Rows going to one file under
+// several names are interleaved: each row once per name, in the order of the targets.
+static void writeBlockToTargets(const std::string& text, const CSVRowSegment& segment, std::vector<std::ofstream*>& files,
+	long long* bytesWritten)
+{
+	bool prefixed = false;
+	for(size_t t = 0; t < segment.targets.size(); t++)
+		if(!segment.targets[t].second.empty()) prefixed = true;
+	if(!prefixed)
+	{
+		for(size_t t = 0; t < segment.targets.size(); t++)
+			files[segment.targets[t].first]->write(text.data(), text.size());
+		*bytesWritten += (long long)text.size() * segment.targets.size();
+		return;
+	}
+	std::vector<std::string> fileText(files.size());
+	for(size_t lineStart = 0; lineStart < text.size(); )
+	{
+		size_t lineEnd = text.find('\n', lineStart) + 1;
+		for(size_t t = 0; t < segment.targets.size(); t++)
+		{
+			std::string& out = fileText[segment.targets[t].first];
+			out += segment.targets[t].second;
+			out.append(text, lineStart, lineEnd - lineStart);
+		}
+		lineStart = lineEnd;
+	}
+	for(size_t f = 0; f < files.size(); f++)
+		if(!fileText[f].empty())
+		{
+			files[f]->write(fileText[f].data(), fileText[f].size());
+			*bytesWritten += (long long)fileText[f].size();
+		}
+	return;
+}
+
+// Write the rows of every segment, in order, to the files named, after their headings. Each
+// block of rows is formatted once, however many files it goes to: formatter threads claim
+// blocks in order and queue the text, and this thread writes the blocks back in order while
+// later ones are still being formatted.
+static void printSegmentsToCSV
+(
+	const std::vector<std::string>& csvFilenames,
+	const std::vector<std::string>& headings,
+	const std::vector<CSVRowSegment>& segments,
+	const CSVSource& source,
+	const float wavenumber[],
+	int NUM_SPA_FILES,
+	const char* reportDetail
+)
+{
+	const char* funcDef = "void printSegmentsToCSV(const std::vector<std::string>&, const std::vector<std::string>&, "
+		"const std::vector<CSVRowSegment>&, const CSVSource&, const float [], int, const char*)";
+	float** IR_Data = source.data;
+	ReportStage reportStage("csv", reportDetail);
+	std::vector<std::ofstream*> files;
+	long long bytesWritten = 0;
+	for(size_t f = 0; f < csvFilenames.size(); f++)
+	{
+		files.push_back(new std::ofstream(csvFilenames[f].c_str(), std::ios::out));
+		if(!files[f]->is_open())
+		{
+			std::cerr << "Error: " << funcDef << ": unable to open output file '" << csvFilenames[f] << "'.\n"
+				 << "    Does the file already exist?\n";
+			std::exit(1);
+		}
+		files[f]->write(headings[f].data(), headings[f].size());
+		bytesWritten += (long long)headings[f].size();
+	}
+
+	// Blocks never span two segments, so each goes to one set of targets
+	struct RowBlock
+	{
+		int segment;
+		int firstRow;
+		int lastRow;
+	};
+	std::vector<RowBlock> rowBlocks;
+	for(size_t s = 0; s < segments.size(); s++)
+		for(int firstRow = segments[s].firstRow; firstRow <= segments[s].lastRow; firstRow += CSV_ROWS_PER_BLOCK)
+		{
+			RowBlock rowBlock = {(int)s, firstRow, std::min(firstRow + CSV_ROWS_PER_BLOCK - 1, segments[s].lastRow)};
+			rowBlocks.push_back(rowBlock);
+		}
+	const int numBlocks = (int)rowBlocks.size();
+	struct FormattedBlock
+	{
+		int index;
+		std::string* text;
+	};
+	BoundedQueue<FormattedBlock> formattedBlocks(outputStages.queueDepth);
+	std::atomic<int> nextBlock(0);
+	std::atomic<int> formattersLeft(outputStages.formatThreads);
+	StageStats* formatStats = outputStages.formatStats;
+	StageStats* writeStats = outputStages.writeStats;
+	const int pageRows = scratchRowsPerBlock();
+
+	auto formatter = [&]()
+	{
+		std::vector<float> decoded;
+		std::vector<float*> columns;
+		for(int b = nextBlock++; b < numBlocks; b = nextBlock++)
+		{
+			long long begin = nowNanos();
+			const RowBlock& rowBlock = rowBlocks[b];
+			const CSVRowSegment& segment = segments[rowBlock.segment];
+			const int firstRow = rowBlock.firstRow;
+			const int lastRow = rowBlock.lastRow;
+			const int pageBlock = (firstRow - segment.firstRow) / pageRows;
+			if(IR_Data != nullptr
+				&& (firstRow == segment.firstRow || (firstRow - CSV_ROWS_PER_BLOCK - segment.firstRow) / pageRows != pageBlock))
+			{ // Entering the next page of every column (if mapped from a scratch file): read the one
+			  // after it ahead, and let the one before it go
+				int nextFirst = segment.firstRow + (pageBlock + 1) * pageRows;
+				if(nextFirst <= segment.lastRow)
+					adviseRowBlock(IR_Data, NUM_SPA_FILES, nextFirst, std::min(nextFirst + pageRows - 1, segment.lastRow), true);
+				if(pageBlock > 0)
+					adviseRowBlock(IR_Data, NUM_SPA_FILES, segment.firstRow + (pageBlock - 1) * pageRows,
+						segment.firstRow + pageBlock * pageRows - 1, false);
+			}
+			FormattedBlock block = {b, new std::string()};
+			block.text->reserve((size_t)(lastRow - firstRow + 1) * (NUM_SPA_FILES + 1) * 10);
+			if(source.quantized == nullptr)
+				formatCSVRows(*block.text, IR_Data, wavenumber, NUM_SPA_FILES, firstRow, lastRow);
+			else
+			{
+				decodeRowBlock(source, NUM_SPA_FILES, firstRow, lastRow, decoded, columns);
+				formatCSVRows(*block.text, &columns[0], wavenumber + firstRow, NUM_SPA_FILES, 0, lastRow - firstRow);
+			}
+			long long end = nowNanos();
+			if(formatStats)
+			{
+				formatStats->busyNanos += end - begin;
+				formatStats->items++;
+			}
+			traceEvent("csv", "format rows", nullptr, b, begin, end);
+			formattedBlocks.push(block, formatStats);
+		}
+		if(--formattersLeft == 0) formattedBlocks.close();
+	};
+	std::vector<std::thread> formatters;
+	for(int t = 0; t < outputStages.formatThreads; t++)
+		formatters.push_back(std::thread(formatter));
+
+	std::map<int, std::string*> waiting; // blocks that arrived ahead of their turn
+	int nextToWrite = 0;
+	FormattedBlock block;
+	while(formattedBlocks.pop(block, writeStats))
+	{
+		waiting[block.index] = block.text;
+		for(auto next = waiting.find(nextToWrite); next != waiting.end(); next = waiting.find(nextToWrite))
+		{
+			long long begin = nowNanos();
+			writeBlockToTargets(*next->second, segments[rowBlocks[nextToWrite].segment], files, &bytesWritten);
+			long long end = nowNanos();
+			if(writeStats)
+			{
+				writeStats->busyNanos += end - begin;
+				writeStats->items++;
+			}
+			traceEvent("csv", "write rows", nullptr, nextToWrite, begin, end);
+			delete next->second;
+			waiting.erase(next);
+			nextToWrite++;
+		}
+	}
+	for(size_t t = 0; t < formatters.size(); t++)
+		formatters[t].join();
+	for(size_t f = 0; f < files.size(); f++)
+	{
+		files[f]->close();
+		if(!*files[f])
+		{
+			std::cerr << "Error: " << funcDef << ": unable to write output file '" << csvFilenames[f] << "'.\n";
+			std::exit(1);
+		}
+		delete files[f];
+	}
+	reportStage.addFiles(NUM_SPA_FILES);
+	reportStage.addBytesWritten(bytesWritten);
+	return;
+}
+
+static void printSourceRowsToCSV
+(
+	const char* CSV_FILENAME,
+	char** colTitles,
+	const CSVSource& source,
+	const float wavenumber[],
+	int numCols,
+	int firstIndex,
+	int lastIndex
+)
+{
+	std::vector<std::string> csvFilenames(1, CSV_FILENAME);
+	std::vector<std::string> headings(1);
+	formatCSVHeading(headings[0], colTitles, numCols);
+	CSVRowSegment segment;
+	segment.firstRow = firstIndex;
+	segment.lastRow = lastIndex;
+	segment.targets.push_back(std::make_pair(0, std::string()));
+	printSegmentsToCSV(csvFilenames, headings, std::vector<CSVRowSegment>(1, segment), source, wavenumber, numCols, CSV_FILENAME);
+	return;
+}
+
+// Print rows firstIndex to lastIndex (inclusive) of every spectrum, one column per spectrum
+void printRowsToCSV
+(
+	const char* CSV_FILENAME,
+	char** SPA_FILENAME,
+	float** IR_Data,
+	float wavenumber[],
+	int NUM_SPA_FILES,
+	int firstIndex,
+	int lastIndex
+)
+{
+	CSVSource source = {IR_Data, nullptr, nullptr};
+	printSourceRowsToCSV(CSV_FILENAME, SPA_FILENAME, source, wavenumber, NUM_SPA_FILES, firstIndex, lastIndex);
+	return;
+}
+
+// Print every region in one pass over the rows: the rows of all regions are split where any
+// region starts or ends, so rows in several regions are formatted once and copied to each
+static void printSourceRegionsToCSV
+(
+	const std::string& prefix,
+	char** colTitles,
+	const CSVSource& source,
+	int numCols,
+	const float wavenumber[],
+	const std::vector<CSVRegion>& regions,
+	bool oneFile
+)
+{
+	std::vector<std::string> csvFilenames;
+	std::vector<std::string> headings;
+	if(oneFile)
+	{
+		csvFilenames.push_back(prefix + ".regions.CSV");
+		headings.push_back("Region, ");
+		formatCSVHeading(headings[0], colTitles, numCols);
+	}
+	else
+		for(size_t r = 0; r < regions.size(); r++)
+		{
+			csvFilenames.push_back(prefix + "." + regions[r].name + ".CSV");
+			headings.push_back(std::string());
+			formatCSVHeading(headings[r], colTitles, numCols);
+		}
+
+	std::vector<int> boundaries; // first row of each segment, and one past the last row
+	for(size_t r = 0; r < regions.size(); r++)
+	{
+		boundaries.push_back(regions[r].firstIndex);
+		boundaries.push_back(regions[r].lastIndex + 1);
 	}
+	std::sort(boundaries.begin(), boundaries.end());
+	boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+	std::vector<CSVRowSegment> segments;
+	for(size_t b = 0; b + 1 < boundaries.size(); b++)
+	{
+		CSVRowSegment segment;
+		segment.firstRow = boundaries[b];
+		segment.lastRow = boundaries[b + 1] - 1;
+		for(size_t r = 0; r < regions.size(); r++)
+			if(regions[r].firstIndex <= segment.firstRow && segment.lastRow <= regions[r].lastIndex)
+				segment.targets.push_back(( oneFile ? std::make_pair(0, regions[r].name + ", ") : std::make_pair((int)r, std::string()) ));
+		if(!segment.targets.empty()) segments.push_back(segment);
+	}
+	printSegmentsToCSV(csvFilenames, headings, segments, source, wavenumber, numCols, prefix.c_str());
+	return;
+}
+
+void printRegionsToCSV
+(
+	const std::string& prefix,
+	char** colTitles,
+	float** data,
+	int numCols,
+	const float wavenumber[],
+	const std::vector<CSVRegion>& regions,
+	bool oneFile
+)
+{
+	CSVSource source = {data, nullptr, nullptr};
+	printSourceRegionsToCSV(prefix, colTitles, source, numCols, wavenumber, regions, oneFile);
 	return;
 }
 
@@ -47,29 +473,7 @@ void printToCSV
 	int SIZE
 )
 {
-	const char* funcDef = "void printToCSV(const char*, char**, float**, float [], int, int)";
-    std::ofstream csvOutputFile (CSV_FILENAME, std::ios::out);
-    if(csvOutputFile.is_open()){
-		// Headings
-		csvOutputFile << "Wavenumber, ";
-		for(int i = 0; i < NUM_SPA_FILES - 1; i++)
-			csvOutputFile << SPA_FILENAME[i] << ", ";
-		csvOutputFile << SPA_FILENAME[NUM_SPA_FILES - 1] << std::endl;
-
-		// Data
-		for(int i = 0; i < SIZE; i++)
-		{
-			csvOutputFile << wavenumber[i] << ", ";
-			for(int j = 0; j < NUM_SPA_FILES - 1; j++)
-				csvOutputFile << IR_Data[j][i] << ", ";
-			csvOutputFile << IR_Data[NUM_SPA_FILES - 1][i] << std::endl;
-		}
-		csvOutputFile.close();
-	} else {
-        std::cerr << "Error: " << funcDef << ": unable to open output file '" << CSV_FILENAME << "'.\n"
-			 << "    Does the file already exist?\n";
-        std::exit(1);
-	}
+	printRowsToCSV(CSV_FILENAME, SPA_FILENAME, IR_Data, wavenumber, NUM_SPA_FILES, 0, SIZE - 1);
 	return;
 }
 
@@ -86,41 +490,11 @@ void printToCSV
 	bool upperBoundSpecified
 )
 {
-	const char* funcDef = "void printToCSV(const char*, char**, float**, float [], int, int, int, bool)";
 	int boundIndex = wavenumToIndex(bound, wavenumber, SIZE);
-    std::ofstream csvOutputFile (CSV_FILENAME, std::ios::out);
-	if(csvOutputFile.is_open())
-	{
-		// Headings
-		csvOutputFile << "Wavenumber, ";
-		for(int i = 0; i < NUM_SPA_FILES - 1; i++)
-			csvOutputFile << SPA_FILENAME[i] << ", ";
-		csvOutputFile << SPA_FILENAME[NUM_SPA_FILES - 1] << std::endl;
-		// Data
-		if(upperBoundSpecified)
-			for(int i = boundIndex; i < SIZE; i++)
-			{
-				csvOutputFile << wavenumber[i] << ", ";
-				for(int j = 0; j < NUM_SPA_FILES - 1; j++)
-					csvOutputFile << IR_Data[j][i] << ", ";
-				csvOutputFile << IR_Data[NUM_SPA_FILES - 1][i] << std::endl;
-			}
-		else
-			for(int i = 0; i < boundIndex + 1; i++)
-			{
-				csvOutputFile << wavenumber[i] << ", ";
-				for(int j = 0; j < NUM_SPA_FILES - 1; j++)
-					csvOutputFile << IR_Data[j][i] << ", ";
-				csvOutputFile << IR_Data[NUM_SPA_FILES - 1][i] << std::endl;
-			}
-		csvOutputFile.close();
-	}
+	if(upperBoundSpecified)
+		printRowsToCSV(CSV_FILENAME, SPA_FILENAME, IR_Data, wavenumber, NUM_SPA_FILES, boundIndex, SIZE - 1);
 	else
-	{
-        std::cerr << "Error: " << funcDef << ": unable to open output file '" << CSV_FILENAME << "'.\n"
-			 << "    Does the file already exist?\n";
-        std::exit(1);
-	}
+		printRowsToCSV(CSV_FILENAME, SPA_FILENAME, IR_Data, wavenumber, NUM_SPA_FILES, 0, boundIndex);
 	return;
 }
 
@@ -137,40 +511,220 @@ void printToCSV
 	int lowerBound
 )
 {
-	const char* funcDef = "void printToCSV(const char*, char**, float**, float [], int, int, int, int)";
 	int lowerIndex = wavenumToIndex(upperBound, wavenumber, length);
 	int upperIndex = wavenumToIndex(lowerBound, wavenumber, length);
+	printRowsToCSV(CSV_FILENAME, SPA_FILENAME, IR_Data, wavenumber, NUM_SPA_FILES, lowerIndex, upperIndex);
+	return;
+}
+
+// Print, for each file, how often the group aggregate dropped it as one of the lowest or highest
+// members of its group
+void printOutlierReport
+(
+	const char* CSV_FILENAME,
+	char** SPA_FILENAME,
+	int timesLowest[],
+	int timesHighest[],
+	int NUM_SPA_FILES,
+	int groupSize,
+	int numPoints
+)
+{
+	const char* funcDef = "void printOutlierReport(const char*, char**, int [], int [], int, int, int)";
     std::ofstream csvOutputFile (CSV_FILENAME, std::ios::out);
 	if(csvOutputFile.is_open())
 	{
-		// Headings
-		csvOutputFile << "Wavenumber, ";
-		for(int i = 0; i < NUM_SPA_FILES - 1; i++)
-			csvOutputFile << SPA_FILENAME[i] << ", ";
-		csvOutputFile << SPA_FILENAME[NUM_SPA_FILES - 1] << std::endl;
+		csvOutputFile << "Filename, Group, Times rejected low, Times rejected high, Fraction rejected" << std::endl;
+		for(int i = 0; i < NUM_SPA_FILES; i++)
+			csvOutputFile << SPA_FILENAME[i] << ", " << i / groupSize + 1 << ", "
+				<< timesLowest[i] << ", " << timesHighest[i] << ", "
+				<< (float)(timesLowest[i] + timesHighest[i]) / (float)numPoints << std::endl;
+		csvOutputFile.close();
+	}
+	else
+	{
+        std::cerr << "Error: " << funcDef << ": unable to open output file '" << CSV_FILENAME << "'.\n";
+        std::exit(1);
+	}
+	return;
+}
 
-		// Data
-		for(int i = lowerIndex; i < upperIndex + 1; i++)
-		{
-			csvOutputFile << wavenumber[i] << ", ";
-			for(int j = 0; j < NUM_SPA_FILES - 1; j++)
-				csvOutputFile << IR_Data[j][i] << ", ";
-			csvOutputFile << IR_Data[NUM_SPA_FILES - 1][i] << std::endl;
-		}
+// Print the shift removed from each file, in data points and in inverse cm
+void printAlignmentShifts
+(
+	const char* CSV_FILENAME,
+	char** SPA_FILENAME,
+	float shifts[],
+	float STEP_SIZE,
+	int NUM_SPA_FILES
+)
+{
+	const char* funcDef = "void printAlignmentShifts(const char*, char**, float [], float, int)";
+    std::ofstream csvOutputFile (CSV_FILENAME, std::ios::out);
+	if(csvOutputFile.is_open())
+	{
+		csvOutputFile << "Filename, Shift (points), Shift (cm-1)" << std::endl;
+		for(int i = 0; i < NUM_SPA_FILES; i++)
+			csvOutputFile << SPA_FILENAME[i] << ", " << shifts[i] << ", " << shifts[i] * STEP_SIZE << std::endl;
 		csvOutputFile.close();
 	}
 	else
 	{
-        std::cerr << "Error: " << funcDef << ": unable to open output file '" << CSV_FILENAME << "'.\n"
-			 << "    Does the file already exist?\n";
+        std::cerr << "Error: " << funcDef << ": unable to open output file '" << CSV_FILENAME << "'.\n";
         std::exit(1);
 	}
 	return;
 }
 
-const char* createCSVFilename(const char* filename, std::string ubStr, std::string lbStr)
+std::string createCSVFilename(const char* filename, std::string ubStr, std::string lbStr)
 {
     std::string str = filename;
-	return str.append(".").append(ubStr).append("-").append(lbStr).append(".CSV").c_str();
+	return str.append(".").append(ubStr).append("-").append(lbStr).append(".CSV");
 }
 
+// The --region regions printDataSet() writes instead of the bounds; empty for none
+static std::vector<CSVRegion> outputRegions;
+static bool regionsInOneFile = false;
+
+void setCSVRegions(const std::vector<CSVRegion>& regions, bool oneFile)
+{
+	outputRegions = regions;
+	regionsInOneFile = oneFile;
+	return;
+}
+
+// Whether printDataSet() saves .spz files (--output-format=spz) instead of CSV
+static bool spzOutput = false;
+
+void setSpzOutput(bool spz)
+{
+	spzOutput = spz;
+	return;
+}
+
+// Rows firstIndex to lastIndex of every column, encoded by the format threads (each decoding
+// its column first if the source is quantized) and saved as one .spz file
+static void printSourceRowsToSpz(const std::string& spzFilename, char** colTitles, const CSVSource& source, int numCols,
+	int firstIndex, int lastIndex)
+{
+	ReportStage reportStage("spz", spzFilename.c_str());
+	const int numRows = lastIndex - firstIndex + 1;
+	std::vector<std::vector<unsigned char> > encoded(numCols);
+	std::vector<std::vector<float> > decoded(outputStages.formatThreads, std::vector<float>(( source.quantized ? numRows : 0 )));
+	parallelFor(numCols, outputStages.formatThreads, [&](int j, int thread)
+	{
+		const float* column = ( source.data == nullptr ? nullptr : source.data[j] + firstIndex );
+		if(source.quantized != nullptr)
+		{
+			float* values = &decoded[thread][0];
+			decodeSpectrumRows(source.quantized, j, firstIndex, numRows, values);
+			if(source.shifts != nullptr)
+				for(int i = 0; i < numRows; i++)
+					values[i] = source.shifts[j] + values[i];
+			column = values;
+		}
+		encodeSpectrum(column, numRows, encoded[j]);
+	});
+	reportStage.addFiles(numCols);
+	reportStage.addBytesWritten(writeSpzDataSet(spzFilename.c_str(), colTitles, encoded, firstIndex, numRows));
+	return;
+}
+
+static void printDataSetFrom(
+    const std::string& prefix,
+    char** colTitles,
+    const CSVSource& source,
+    int numCols,
+    float WAVENUMBER[],
+    bool upperBoundSpecified,
+    bool lowerBoundSpecified,
+    int upperBound,
+    int lowerBound,
+    const std::string& ubStr,
+    const std::string& lbStr
+)
+{
+    if(!outputRegions.empty() && spzOutput)
+    { // SCENARIO: regions given (instead of bounds), a .spz file each
+        for(size_t r = 0; r < outputRegions.size(); r++)
+            printSourceRowsToSpz(prefix + "." + outputRegions[r].name + ".spz", colTitles, source, numCols,
+                outputRegions[r].firstIndex, outputRegions[r].lastIndex);
+        return;
+    }
+    if(!outputRegions.empty())
+    { // SCENARIO: regions given (instead of bounds)
+        printSourceRegionsToCSV(prefix, colTitles, source, numCols, WAVENUMBER, outputRegions, regionsInOneFile);
+        return;
+    }
+    std::string csvFilename;
+    int firstIndex = 0;
+    int lastIndex = spa::NUM_POINTS - 1;
+    if(upperBoundSpecified && lowerBoundSpecified)
+    { // SCENARIO: both bounds given
+        csvFilename = createCSVFilename(prefix.c_str(), ubStr, lbStr);
+        firstIndex = wavenumToIndex(upperBound, WAVENUMBER, spa::NUM_POINTS);
+        lastIndex = wavenumToIndex(lowerBound, WAVENUMBER, spa::NUM_POINTS);
+    }
+    else if(upperBoundSpecified || lowerBoundSpecified)
+    { // SCENARIO: one bound given
+        std::string boundStr = ( upperBoundSpecified ? (std::string(".upperBound.") + ubStr) : (std::string(".lowerBound.") + lbStr) );
+        int boundIndex = wavenumToIndex(( upperBoundSpecified ? upperBound : lowerBound ), WAVENUMBER, spa::NUM_POINTS);
+        csvFilename = prefix + boundStr + std::string(".CSV");
+        if(upperBoundSpecified)
+            firstIndex = boundIndex;
+        else
+            lastIndex = boundIndex;
+    }
+    else
+    { // SCENARIO: no bounds given
+        csvFilename = prefix + std::string(".fullSpectrum.CSV");
+    }
+    if(spzOutput) // the same name, ending in .spz instead of .CSV
+        printSourceRowsToSpz(csvFilename.substr(0, csvFilename.size() - 4) + ".spz", colTitles, source, numCols, firstIndex, lastIndex);
+    else
+        printSourceRowsToCSV(csvFilename.c_str(), colTitles, source, WAVENUMBER, numCols, firstIndex, lastIndex);
+    return;
+}
+
+// Write one data set to CSV, keeping only the region given by the bounds (if any)
+void printDataSet(
+    const std::string& prefix,
+    char** colTitles,
+    float** data,
+    int numCols,
+    float WAVENUMBER[],
+    bool upperBoundSpecified,
+    bool lowerBoundSpecified,
+    int upperBound,
+    int lowerBound,
+    const std::string& ubStr,
+    const std::string& lbStr
+)
+{
+    CSVSource source = {data, nullptr, nullptr};
+    printDataSetFrom(prefix, colTitles, source, numCols, WAVENUMBER, upperBoundSpecified, lowerBoundSpecified,
+        upperBound, lowerBound, ubStr, lbStr);
+    return;
+}
+
+// printDataSet() for quantized spectra, plus shifts[j] on every value of spectrum j if shifts
+// is not nullptr; blocks of rows are decoded as they are formatted
+void printQuantizedDataSet(
+    const std::string& prefix,
+    char** colTitles,
+    const QuantizedSpectra* spectra,
+    const float shifts[],
+    float WAVENUMBER[],
+    bool upperBoundSpecified,
+    bool lowerBoundSpecified,
+    int upperBound,
+    int lowerBound,
+    const std::string& ubStr,
+    const std::string& lbStr
+)
+{
+    CSVSource source = {nullptr, spectra, shifts};
+    printDataSetFrom(prefix, colTitles, source, spectra->numCols, WAVENUMBER, upperBoundSpecified, lowerBoundSpecified,
+        upperBound, lowerBound, ubStr, lbStr);
+    return;
+}
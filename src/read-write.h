@@ -1,9 +1,30 @@
 #ifndef READ_WRITE_H
 #define READ_WRITE_H
 
+#include "csv.h"
+
 #include <string>
+#include <vector>
 // TODO(ben): make capitalization consistent
 
+struct StageStats;
+struct QuantizedSpectra;
+
+// Thread count and queue depth of the format stage used by every printToCSV() below, and
+// where to record its timings (nullptr for none). Defaults to one formatting thread.
+void setCSVOutputStages(int formatThreads, int queueDepth, StageStats* formatStats, StageStats* writeStats);
+
+// rows firstIndex to lastIndex (inclusive)
+void printRowsToCSV(
+    const char* CSV_FILENAME,
+    char** SPA_FILENAME,
+    float** IR_Data,
+    float wavenumber[],
+    int NUM_SPA_FILES,
+    int firstIndex,
+    int lastIndex
+);
+
 // no bounds specified
 void printToCSV(
     const char* CSV_FILENAME, // TODO(ben): use strings
@@ -14,16 +35,16 @@ void printToCSV(
     int SIZE
 );
 
-// upper-bound specified
+// upper- or lower-bound specified
 void printToCSV(
     const char* CSV_FILENAME,
     char** SPA_FILENAME,
     float** IR_Data,
     float wavenumber[],
     int NUM_SPA_FILES,
-    int length,
-    int upperBound,
-    int lowerBound
+    int SIZE,
+    int bound,
+    bool upperBoundSpecified
 );
 
 // upper- and lower-bound specified
@@ -33,13 +54,102 @@ void printToCSV(
     float** IR_Data,
     float wavenumber[],
     int NUM_SPA_FILES,
+    int length,
     int upperBound,
     int lowerBound
 );
 
+// A --region: rows firstIndex to lastIndex (inclusive) of every spectrum, and its name
+struct CSVRegion
+{
+    std::string name;
+    int firstIndex;
+    int lastIndex;
+};
+
+// every region of one data set in a single pass over its rows, each to <prefix>.<name>.CSV
+// or, with oneFile, all to <prefix>.regions.CSV with the region's name in the first column;
+// rows in more than one region are formatted once
+void printRegionsToCSV(
+    const std::string& prefix,
+    char** colTitles,
+    float** data,
+    int numCols,
+    const float wavenumber[],
+    const std::vector<CSVRegion>& regions,
+    bool oneFile
+);
+
+// From now on printDataSet() writes these regions with printRegionsToCSV() instead of the
+// region given by its bounds; no regions goes back to the bounds
+void setCSVRegions(const std::vector<CSVRegion>& regions, bool oneFile);
+
+// From now on printDataSet() saves each data set losslessly compressed (spectrum-codec.h), to
+// the file name it would have used with .spz in place of .CSV
+void setSpzOutput(bool spz);
+
+// one data set, keeping only the region given by the bounds (if any); the file name is built
+// from prefix and the bounds as given on the command line (ubStr, lbStr)
+void printDataSet(
+    const std::string& prefix,
+    char** colTitles,
+    float** data,
+    int numCols,
+    float WAVENUMBER[],
+    bool upperBoundSpecified,
+    bool lowerBoundSpecified,
+    int upperBound,
+    int lowerBound,
+    const std::string& ubStr,
+    const std::string& lbStr
+);
+
+// printDataSet() for quantized spectra (--quantize), decoded a block of rows at a time as they
+// are formatted; shifts[j] is added to every value of spectrum j unless shifts is nullptr
+void printQuantizedDataSet(
+    const std::string& prefix,
+    char** colTitles,
+    const QuantizedSpectra* spectra,
+    const float shifts[],
+    float WAVENUMBER[],
+    bool upperBoundSpecified,
+    bool lowerBoundSpecified,
+    int upperBound,
+    int lowerBound,
+    const std::string& ubStr,
+    const std::string& lbStr
+);
+
+// per-file counts of values rejected by robust group aggregation
+void printOutlierReport(
+    const char* CSV_FILENAME,
+    char** SPA_FILENAME,
+    int timesLowest[],
+    int timesHighest[],
+    int NUM_SPA_FILES,
+    int groupSize,
+    int numPoints
+);
+
+// shift (in data points) removed from each spectrum by alignment
+void printAlignmentShifts(
+    const char* CSV_FILENAME,
+    char** SPA_FILENAME,
+    float shifts[],
+    float STEP_SIZE,
+    int NUM_SPA_FILES
+);
+
 // TODO(ben): create struct / calss for passing information to functions
-void readSPAFile(char* SPA_FILENAME, float IR_Data[], int length, int start);
-const char* createCSVFilename(
+void readSPAFile(char* SPA_FILENAME, float IR_Data[]);
+// From now on readSPAFile() reads only these index ranges (inclusive, merged when close) and
+// sets the other values to 0; numRanges = 0 goes back to reading whole spectra
+void setSpectrumReadRanges(const int firstIndex[], const int lastIndex[], int numRanges);
+// The ranges readSPAFile() reads ([0, spa::NUM_POINTS - 1] when none were set), for other
+// readers of SPA files, which then call zeroUnreadValues() on each spectrum they read
+void getSpectrumReadRanges(std::vector<int>& firstIndex, std::vector<int>& lastIndex);
+void zeroUnreadValues(float IR_Data[]);
+std::string createCSVFilename(
     const char* filename,
     std::string upperBoundStr,
     std::string lowerBoundStr
@@ -0,0 +1,336 @@
+#include "run-report.h"
+#include "trace.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+struct StageRecord
+{
+    std::string name;
+    std::string detail;
+    long long wallNanos;
+    long long cpuNanos;
+    long long files;
+    long long bytesRead;
+    long long bytesWritten;
+    long long allocations;
+    long long allocatedBytes;
+    long long peakRssBytes;     // of the process, when the stage ended
+    long long counters[NUM_PERF_COUNTERS];  // -1 where not counted
+};
+
+static bool reportEnabled = false;
+static long long reportBeginWallNanos = 0;
+static long long reportBeginCpuNanos = 0;
+static long long reportBeginCounters[NUM_PERF_COUNTERS];
+static std::mutex recordsMutex;
+static std::vector<StageRecord> records;
+
+// Counted by operator new below while the report is enabled
+static std::atomic<long long> allocationCount(0);
+static std::atomic<long long> allocatedBytes(0);
+
+// CPU time of every thread of the process
+static long long processCpuNanos()
+{
+#ifdef _WIN32
+    return (long long)((double)std::clock() * 1e9 / CLOCKS_PER_SEC);
+#else
+    timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+#endif
+}
+
+// High-water mark of the resident set so far; 0 where unknown
+static long long peakRssBytes()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return (long long)usage.ru_maxrss * 1024; // KiB on Linux
+#endif
+}
+
+void enableRunReport()
+{
+    reportEnabled = true;
+    reportBeginWallNanos = nowNanos();
+    reportBeginCpuNanos = processCpuNanos();
+    readPerfCounters(reportBeginCounters);
+    return;
+}
+
+bool runReportEnabled()
+{
+    return reportEnabled;
+}
+
+ReportStage::ReportStage(const char* name, const char* detail)
+    : record(-1), traceName(nullptr), beginWallNanos(0), beginCpuNanos(0), beginAllocations(0), beginAllocatedBytes(0)
+{
+    for(int c = 0; c < NUM_PERF_COUNTERS; c++)
+        beginCounters[c] = -1;
+    if(traceEnabled())
+    {
+        traceName = name;
+        traceLabel = detail;
+        beginWallNanos = nowNanos();
+    }
+    if(!reportEnabled) return;
+    StageRecord newRecord = {name, detail, 0, 0, 0, 0, 0, 0, 0, 0, {-1, -1, -1, -1}};
+    {
+        std::lock_guard<std::mutex> lock(recordsMutex);
+        record = (int)records.size();
+        records.push_back(newRecord);
+    }
+    beginAllocations = allocationCount.load(std::memory_order_relaxed);
+    beginAllocatedBytes = allocatedBytes.load(std::memory_order_relaxed);
+    if(perfCountersOpen()) readPerfCounters(beginCounters);
+    beginCpuNanos = processCpuNanos();
+    beginWallNanos = nowNanos();
+}
+
+ReportStage::~ReportStage()
+{
+    if(traceName != nullptr) traceEvent("stage", traceName, traceLabel.c_str(), -1, beginWallNanos, nowNanos());
+    if(record < 0) return;
+    long long wallNanos = nowNanos() - beginWallNanos;
+    long long cpuNanos = processCpuNanos() - beginCpuNanos;
+    long long counters[NUM_PERF_COUNTERS] = {-1, -1, -1, -1};
+    if(perfCountersOpen()) readPerfCounters(counters);
+    std::lock_guard<std::mutex> lock(recordsMutex);
+    StageRecord& stage = records[record];
+    for(int c = 0; c < NUM_PERF_COUNTERS; c++)
+        stage.counters[c] = ( counters[c] >= 0 && beginCounters[c] >= 0 ? counters[c] - beginCounters[c] : -1 );
+    stage.wallNanos = wallNanos;
+    stage.cpuNanos = cpuNanos;
+    stage.allocations = allocationCount.load(std::memory_order_relaxed) - beginAllocations;
+    stage.allocatedBytes = allocatedBytes.load(std::memory_order_relaxed) - beginAllocatedBytes;
+    stage.peakRssBytes = peakRssBytes();
+}
+
+void ReportStage::addFiles(long long count)
+{
+    if(record < 0) return;
+    std::lock_guard<std::mutex> lock(recordsMutex);
+    records[record].files += count;
+    return;
+}
+
+void ReportStage::addBytesRead(long long bytes)
+{
+    if(record < 0) return;
+    std::lock_guard<std::mutex> lock(recordsMutex);
+    records[record].bytesRead += bytes;
+    return;
+}
+
+void ReportStage::addBytesWritten(long long bytes)
+{
+    if(record < 0) return;
+    std::lock_guard<std::mutex> lock(recordsMutex);
+    records[record].bytesWritten += bytes;
+    return;
+}
+
+static std::string jsonString(const std::string& text)
+{
+    std::string quoted = "\"";
+    for(size_t i = 0; i < text.size(); i++)
+    {
+        unsigned char c = (unsigned char)text[i];
+        if(c == '"' || c == '\\')
+        {
+            quoted += '\\';
+            quoted += text[i];
+        }
+        else if(c < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            quoted += escaped;
+        }
+        else
+            quoted += text[i];
+    }
+    return quoted + "\"";
+}
+
+// Counted events, with instructions per cycle and bytes read and written per cycle
+static void writeCounters(std::ostream& output, const char* separator, const long long counters[], long long bytes)
+{
+    output << separator << "\"counters\": {";
+    bool first = true;
+    for(int c = 0; c < NUM_PERF_COUNTERS; c++)
+        if(counters[c] >= 0)
+        {
+            output << (first ? "" : ", ") << "\"" << PERF_COUNTER_NAMES[c] << "\": " << counters[c];
+            first = false;
+        }
+    const long long cycles = counters[PERF_CYCLES];
+    if(cycles > 0 && counters[PERF_INSTRUCTIONS] >= 0)
+        output << ", \"ipc\": " << (double)counters[PERF_INSTRUCTIONS] / cycles;
+    if(cycles > 0 && bytes > 0)
+        output << ", \"bytes_per_cycle\": " << (double)bytes / cycles;
+    output << "}";
+    return;
+}
+
+// Rates are left out of stages too short to time
+static void writeRates(std::ostream& output, const char* separator, long long files, long long bytes, long long wallNanos)
+{
+    if(wallNanos <= 0) return;
+    double seconds = wallNanos * 1e-9;
+    output << separator << "\"files_per_s\": " << files / seconds << separator << "\"mb_per_s\": " << bytes / seconds / 1e6;
+    return;
+}
+
+void writeRunReport(const std::string& path, int numFiles, int numThreads,
+    const StageStats* const pipelineStats[], int numPipelineStages)
+{
+    const char* funcDef = "void writeRunReport(const std::string&, int, int, const StageStats* const [], int)";
+    long long wallNanos = nowNanos() - reportBeginWallNanos;
+    long long cpuNanos = processCpuNanos() - reportBeginCpuNanos;
+    std::vector<StageRecord> stages;
+    {
+        std::lock_guard<std::mutex> lock(recordsMutex);
+        stages = records;
+    }
+    long long bytesRead = 0;
+    long long bytesWritten = 0;
+    for(size_t s = 0; s < stages.size(); s++)
+    {
+        bytesRead += stages[s].bytesRead;
+        bytesWritten += stages[s].bytesWritten;
+    }
+
+    std::ofstream output (path.c_str());
+    if(!output.is_open())
+    {
+        std::cerr << "Error: " << funcDef << ": unable to open report file '" << path << "'.\n";
+        std::exit(1);
+    }
+    output << std::setprecision(6)
+        << "{\n  \"files\": " << numFiles
+        << ",\n  \"threads\": " << numThreads
+        << ",\n  \"wall_s\": " << wallNanos * 1e-9
+        << ",\n  \"cpu_s\": " << cpuNanos * 1e-9
+        << ",\n  \"bytes_read\": " << bytesRead
+        << ",\n  \"bytes_written\": " << bytesWritten;
+    writeRates(output, ",\n  ", numFiles, bytesRead + bytesWritten, wallNanos);
+    if(perfCountersOpen())
+    {
+        long long counters[NUM_PERF_COUNTERS];
+        readPerfCounters(counters);
+        for(int c = 0; c < NUM_PERF_COUNTERS; c++)
+            counters[c] = ( counters[c] >= 0 && reportBeginCounters[c] >= 0 ? counters[c] - reportBeginCounters[c] : -1 );
+        writeCounters(output, ",\n  ", counters, bytesRead + bytesWritten);
+    }
+    else if(perfCountersError() != nullptr)
+        output << ",\n  \"counters_unavailable\": " << jsonString(perfCountersError());
+    output << ",\n  \"peak_rss_bytes\": " << peakRssBytes()
+        << ",\n  \"allocations\": " << allocationCount.load()
+        << ",\n  \"allocated_bytes\": " << allocatedBytes.load()
+        << ",\n  \"stages\": [\n";
+    for(size_t s = 0; s < stages.size(); s++)
+    {
+        const StageRecord& stage = stages[s];
+        output << "    {\"name\": " << jsonString(stage.name) << ", \"detail\": " << jsonString(stage.detail)
+            << ", \"wall_s\": " << stage.wallNanos * 1e-9 << ", \"cpu_s\": " << stage.cpuNanos * 1e-9
+            << ", \"files\": " << stage.files << ", \"bytes_read\": " << stage.bytesRead
+            << ", \"bytes_written\": " << stage.bytesWritten;
+        writeRates(output, ", ", stage.files, stage.bytesRead + stage.bytesWritten, stage.wallNanos);
+        output << ", \"allocations\": " << stage.allocations << ", \"allocated_bytes\": " << stage.allocatedBytes
+            << ", \"peak_rss_bytes\": " << stage.peakRssBytes;
+        if(perfCountersOpen()) writeCounters(output, ", ", stage.counters, stage.bytesRead + stage.bytesWritten);
+        output << "}" << (s + 1 < stages.size() ? "," : "") << "\n";
+    }
+    output << "  ],\n  \"pipeline\": [\n";
+    for(int s = 0; s < numPipelineStages; s++)
+    {
+        const StageStats* stage = pipelineStats[s];
+        output << "    {\"name\": " << jsonString(stage->name) << ", \"threads\": " << stage->numThreads
+            << ", \"items\": " << stage->items.load() << ", \"busy_s\": " << stage->busyNanos.load() * 1e-9
+            << ", \"stalled_s\": " << stage->stallNanos.load() * 1e-9 << "}" << (s + 1 < numPipelineStages ? "," : "") << "\n";
+    }
+    output << "  ]\n}\n";
+    output.close();
+    if(!output)
+    {
+        std::cerr << "Error: " << funcDef << ": unable to write report file '" << path << "'.\n";
+        std::exit(1);
+    }
+    return;
+}
+
+// Counting replacements for the global operator new. The count is only kept while the report
+// is enabled, so a run without --report pays one test of a flag per allocation.
+
+static void* countedAllocation(std::size_t size)
+{
+    if(reportEnabled)
+    {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocatedBytes.fetch_add((long long)size, std::memory_order_relaxed);
+    }
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new(std::size_t size)
+{
+    void* pointer = countedAllocation(size);
+    if(pointer == nullptr) throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](std::size_t size)
+{
+    void* pointer = countedAllocation(size);
+    if(pointer == nullptr) throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAllocation(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAllocation(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
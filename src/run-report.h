@@ -0,0 +1,49 @@
+#ifndef RUN_REPORT_H
+#define RUN_REPORT_H
+
+#include "perf-counters.h"
+#include "pipeline.h"
+
+#include <string>
+
+// The --report JSON: where a run spent its time. Each stage (reading the files, computing a
+// data set, writing a CSV file) records its wall and CPU time, the spectra and bytes it
+// handled, and the allocations made while it ran. Until enableRunReport() is called a stage
+// costs one test of a flag, and operator new one more. Stages are also --trace events, and
+// with --perf-counters (opened before enableRunReport()) they count hardware events too.
+
+void enableRunReport();
+bool runReportEnabled();
+
+// Measures a stage from construction to destruction. name is one of a few fixed names
+// ("read", "aggregate", "csv", ...); detail says which (a file name, a data set).
+class ReportStage
+{
+public:
+    explicit ReportStage(const char* name, const char* detail = "");
+    ~ReportStage();
+
+    void addFiles(long long count);
+    void addBytesRead(long long bytes);
+    void addBytesWritten(long long bytes);
+
+private:
+    ReportStage(const ReportStage&);
+    ReportStage& operator=(const ReportStage&);
+
+    int record;     // index of the stage in the report; -1 while the report is disabled
+    const char* traceName;  // nullptr while the trace is disabled
+    std::string traceLabel;
+    long long beginWallNanos;
+    long long beginCpuNanos;
+    long long beginAllocations;
+    long long beginAllocatedBytes;
+    long long beginCounters[NUM_PERF_COUNTERS];
+};
+
+// Write the stages recorded so far, and the busy and stalled time of the pipeline stages, to
+// path as JSON. Exits on failure.
+void writeRunReport(const std::string& path, int numFiles, int numThreads,
+    const StageStats* const pipelineStats[], int numPipelineStages);
+
+#endif // RUN_REPORT_H
@@ -0,0 +1,180 @@
+#include "scratch-matrix.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// Where the matrix of each createScratchFloatArray() lies
+struct ScratchMapping
+{
+    char* base;
+    size_t numBytes;
+    size_t columnStride;    // bytes from one column to the next, a whole number of pages
+};
+
+static std::string scratchDirectory;
+static std::mutex mappingsMutex;
+static std::map<float**, ScratchMapping> mappings;
+
+bool scratchMatricesInUse()
+{
+    return !scratchDirectory.empty();
+}
+
+static bool findMapping(float** array, ScratchMapping* mapping)
+{
+    std::lock_guard<std::mutex> lock(mappingsMutex);
+    std::map<float**, ScratchMapping>::const_iterator found = mappings.find(array);
+    if(found == mappings.end()) return false;
+    *mapping = found->second;
+    return true;
+}
+
+#ifdef _WIN32
+
+bool useScratchMatrices(const std::string&) { return false; }
+float** createScratchFloatArray(int, int) { return nullptr; }
+bool freeScratchFloatArray(float**) { return false; }
+void adviseRowBlock(float**, int, int, int, bool) {}
+int scratchRowsPerBlock() { return 1024; }
+
+#else // POSIX
+
+#include <atomic>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+static size_t pageBytes()
+{
+    static const size_t bytes = (size_t)sysconf(_SC_PAGESIZE);
+    return bytes;
+}
+
+int scratchRowsPerBlock()
+{
+    return (int)(pageBytes() / sizeof(float));
+}
+
+bool useScratchMatrices(const std::string& directory)
+{
+    scratchDirectory = ( directory.empty() ? "." : directory );
+    return true;
+}
+
+float** createScratchFloatArray(int numCols, int numRows)
+{
+    ScratchMapping mapping;
+    mapping.columnStride = ((size_t)numRows * sizeof(float) + pageBytes() - 1) / pageBytes() * pageBytes();
+    mapping.numBytes = mapping.columnStride * (size_t)(numCols > 0 ? numCols : 1);
+
+    std::string path = scratchDirectory + "/spa-reader-scratch-XXXXXX";
+    std::vector<char> pathChars(path.begin(), path.end());
+    pathChars.push_back('\0');
+    int fd = mkstemp(&pathChars[0]);
+    if(fd < 0) return nullptr;
+    unlink(&pathChars[0]); // gone once unmapped, however the program ends
+    // Reserve the blocks now: running out of space while writing a mapped page is SIGBUS
+    int status = posix_fallocate(fd, 0, (off_t)mapping.numBytes);
+    void* base = ( status == 0 ? mmap(nullptr, mapping.numBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED );
+    if(status == 0 && base == MAP_FAILED) status = errno;
+    close(fd);
+    if(status != 0)
+    {
+        if(base != MAP_FAILED) munmap(base, mapping.numBytes);
+        errno = status;
+        return nullptr;
+    }
+    mapping.base = static_cast<char*>(base);
+
+    float** floatArray = new (std::nothrow) float* [numCols];
+    if(floatArray == nullptr)
+    {
+        munmap(mapping.base, mapping.numBytes);
+        errno = ENOMEM;
+        return nullptr;
+    }
+    for(int i = 0; i < numCols; i++)
+        floatArray[i] = reinterpret_cast<float*>(mapping.base + (size_t)i * mapping.columnStride);
+    std::lock_guard<std::mutex> lock(mappingsMutex);
+    mappings[floatArray] = mapping;
+    return floatArray;
+}
+
+bool freeScratchFloatArray(float** array)
+{
+    ScratchMapping mapping;
+    if(!findMapping(array, &mapping)) return false;
+    {
+        std::lock_guard<std::mutex> lock(mappingsMutex);
+        mappings.erase(array);
+    }
+    munmap(mapping.base, mapping.numBytes);
+    delete[] array;
+    return true;
+}
+
+// Give the same advice for every range in as few system calls as possible: process_madvise()
+// (Linux 5.10, WILLNEED from 5.12) takes up to IOV_MAX ranges a call, so a block of rows of
+// 100,000 columns is about a hundred calls instead of 100,000 madvise() calls
+static void adviseRanges(std::vector<struct iovec>& ranges, int advice)
+{
+#if defined(SYS_process_madvise) && defined(SYS_pidfd_open)
+    static const int selfPidfd = (int)syscall(SYS_pidfd_open, getpid(), 0);
+    static std::atomic<bool> processMadviseWorks(selfPidfd >= 0);
+    static const size_t MAX_RANGES = (size_t)( sysconf(_SC_IOV_MAX) > 0 ? sysconf(_SC_IOV_MAX) : 1024 );
+    size_t first = 0;
+    while(processMadviseWorks && first < ranges.size())
+    {
+        size_t count = std::min(MAX_RANGES, ranges.size() - first);
+        if(syscall(SYS_process_madvise, selfPidfd, &ranges[first], count, advice, 0) < 0)
+        { // e.g. an older kernel; madvise() the rest
+            processMadviseWorks = false;
+            break;
+        }
+        first += count;
+    }
+#else
+    size_t first = 0;
+#endif
+    for(; first < ranges.size(); first++)
+        madvise(ranges[first].iov_base, ranges[first].iov_len, advice);
+    return;
+}
+
+void adviseRowBlock(float** array, int numCols, int firstRow, int lastRow, bool willNeed)
+{
+    ScratchMapping mapping;
+    if(!findMapping(array, &mapping)) return;
+    size_t begin = (size_t)firstRow * sizeof(float) / pageBytes() * pageBytes();
+    size_t end = (size_t)(lastRow + 1) * sizeof(float);
+    // Pages done with become the first to be reclaimed, but stay valid
+    int advice = MADV_WILLNEED;
+    if(!willNeed)
+    {
+#ifdef MADV_COLD
+        advice = MADV_COLD;
+#else
+        return;
+#endif
+    }
+    // Each column's rows are a range of their own; see scratch-matrix.h
+    std::vector<struct iovec> ranges(numCols);
+    for(int i = 0; i < numCols; i++)
+    {
+        ranges[i].iov_base = mapping.base + (size_t)i * mapping.columnStride + begin;
+        ranges[i].iov_len = end - begin;
+    }
+    adviseRanges(ranges, advice);
+    return;
+}
+
+#endif // _WIN32
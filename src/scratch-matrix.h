@@ -0,0 +1,30 @@
+#ifndef SCRATCH_MATRIX_H
+#define SCRATCH_MATRIX_H
+
+#include <string>
+
+// Spectrum matrices too large for memory (--memory-budget), backed by a scratch file mapped
+// into memory instead of allocated, so they are still float** with one spectrum per column.
+// Each column starts on a page of its own, so a page never holds two spectra: filling one
+// spectrum (one file read) never faults in another's pages, and a block of rows is one page
+// range per column. The file is deleted as soon as it is mapped, so nothing is left behind.
+
+// From now on, createFloatArray() maps its matrices from scratch files in directory. Returns
+// false, changing nothing, if this build cannot map scratch files.
+bool useScratchMatrices(const std::string& directory);
+bool scratchMatricesInUse();
+
+// nullptr, with errno set, if the scratch file cannot be created or mapped
+float** createScratchFloatArray(int numCols, int numRows);
+// Unmaps array and returns true if it came from createScratchFloatArray()
+bool freeScratchFloatArray(float** array);
+
+// Rows firstRow to lastRow of every column are about to be traversed (willNeed) or are done
+// with (!willNeed), so the kernel can read them ahead or reclaim them first. Does nothing
+// unless array is a scratch matrix.
+void adviseRowBlock(float** array, int numCols, int firstRow, int lastRow, bool willNeed);
+
+// Rows per block in row-block traversals: one page of each column
+int scratchRowsPerBlock();
+
+#endif // SCRATCH_MATRIX_H
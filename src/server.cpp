@@ -0,0 +1,457 @@
+#include "server.h"
+#include "csv.h"
+#include "data-processing.h"
+#include "quantize.h"
+#include "read-write.h"
+#include "spa.h"
+#include "spectrum-cache.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+
+void serveRequests(const char*, int, size_t)
+{
+    std::cerr << "Error: void serveRequests(const char*, int, size_t): --serve needs Unix domain sockets, "
+        << "which this build does not support.\n";
+    std::exit(1);
+}
+
+#else // POSIX
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Larger requests are refused rather than buffered
+const uint32_t MAX_REQUEST_BYTES = 1 << 20;
+// Spectra per request; each takes about 220 KB while the request is answered, twice with const-corr
+const int MAX_REQUEST_FILES = 1024;
+// CSV rows sent per frame
+const int SERVER_ROWS_PER_FRAME = 256;
+
+// Accepted connections waiting for a worker. Workers sleep here while the server is idle.
+struct ConnectionQueue
+{
+    std::mutex lock;
+    std::condition_variable ready;
+    std::deque<int> sockets;
+
+    void push(int socket)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            sockets.push_back(socket);
+        }
+        ready.notify_one();
+    }
+
+    int pop()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        ready.wait(guard, [this]() { return !sockets.empty(); });
+        int socket = sockets.front();
+        sockets.pop_front();
+        return socket;
+    }
+};
+
+struct ServerRequest
+{
+    std::vector<std::string> files;
+    bool upperBoundSpecified = false;
+    bool lowerBoundSpecified = false;
+    int upperBound = 0;
+    int lowerBound = 0;
+    int groupSize = 1;
+    AggregateMode aggregateMode = AGGREGATE_MEAN;
+    bool useConstCorr = false;
+    int ubCorr = 0;
+    int lbCorr = 0;
+    bool binary = false;
+    bool quantize = false;
+    QuantizedFormat quantizedFormat = QUANTIZE_FLOAT16;
+};
+
+static bool readAll(int socket, char* buffer, size_t length)
+{
+    while(length > 0)
+    {
+        ssize_t got = recv(socket, buffer, length, 0);
+        if(got < 0 && errno == EINTR) continue;
+        if(got <= 0) return false;
+        buffer += got;
+        length -= got;
+    }
+    return true;
+}
+
+static bool sendAll(int socket, const char* buffer, size_t length)
+{
+    while(length > 0)
+    {
+        ssize_t sent = send(socket, buffer, length, MSG_NOSIGNAL); // a departed client is not fatal
+        if(sent < 0 && errno == EINTR) continue;
+        if(sent <= 0) return false;
+        buffer += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+static bool sendFrame(int socket, const void* payload, size_t length)
+{
+    unsigned char header[4] = {
+        (unsigned char)length, (unsigned char)(length >> 8), (unsigned char)(length >> 16), (unsigned char)(length >> 24) };
+    return sendAll(socket, reinterpret_cast<const char*>(header), 4)
+        && sendAll(socket, static_cast<const char*>(payload), length);
+}
+
+static bool sendError(int socket, const std::string& reason)
+{
+    std::string status = "ERROR: " + reason;
+    return sendFrame(socket, status.data(), status.size()) && sendFrame(socket, "", 0);
+}
+
+// Fill request from its text; returns an empty string or the reason it is invalid
+static std::string parseRequest(const std::string& text, ServerRequest* request)
+{
+    size_t lineStart = 0;
+    while(lineStart < text.size())
+    {
+        size_t lineEnd = text.find('\n', lineStart);
+        if(lineEnd == std::string::npos) lineEnd = text.size();
+        std::string line = text.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+        if(!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+        if(line.empty()) continue;
+
+        size_t divider = line.find('=');
+        if(divider == std::string::npos) return "expected name=value, got '" + line + "'";
+        std::string name = line.substr(0, divider);
+        std::string value = line.substr(divider + 1);
+        if(name == "file")
+            request->files.push_back(value);
+        else if(name == "ub" || name == "lb")
+        {
+            bool upper = (name == "ub");
+            if(spa::parseInt(value, upper ? &request->upperBound : &request->lowerBound) != spa::OK)
+                return name + " '" + value + "' is not a number";
+            (upper ? request->upperBoundSpecified : request->lowerBoundSpecified) = true;
+        }
+        else if(name == "group")
+        {
+            if(spa::parseInt(value, &request->groupSize) != spa::OK || request->groupSize < 1)
+                return "group '" + value + "' is not a positive number";
+        }
+        else if(name == "aggregate")
+        {
+            if(value == "mean") request->aggregateMode = AGGREGATE_MEAN;
+            else if(value == "median") request->aggregateMode = AGGREGATE_MEDIAN;
+            else if(value == "trimmed-mean") request->aggregateMode = AGGREGATE_TRIMMED_MEAN;
+            else return "unknown aggregate '" + value + "'";
+        }
+        else if(name == "const-corr")
+        {
+            size_t dash = value.find('-', 1);
+            if(dash == std::string::npos
+                || spa::parseInt(value.substr(0, dash), &request->ubCorr) != spa::OK
+                || spa::parseInt(value.substr(dash + 1), &request->lbCorr) != spa::OK)
+                return "expected const-corr=<bound>-<bound>, got '" + value + "'";
+            request->useConstCorr = true;
+        }
+        else if(name == "format")
+        {
+            if(value == "csv") request->binary = false;
+            else if(value == "binary") request->binary = true;
+            else return "unknown format '" + value + "'";
+        }
+        else if(name == "quantize")
+        {
+            if(value == "float16") request->quantizedFormat = QUANTIZE_FLOAT16;
+            else if(value == "int16") request->quantizedFormat = QUANTIZE_INT16;
+            else return "unknown quantized format '" + value + "'";
+            request->quantize = true;
+        }
+        else
+            return "unknown field '" + name + "'";
+    }
+
+    // Same checks as the command line, reported instead of exiting
+    if(request->files.empty()) return "no files requested";
+    if(request->files.size() > (size_t)MAX_REQUEST_FILES) return "more than " + std::to_string(MAX_REQUEST_FILES) + " files requested";
+    if(request->files.size() % request->groupSize != 0) return "number of files cannot be divided by group size";
+    if(request->groupSize < 2 && request->aggregateMode != AGGREGATE_MEAN) return "aggregate given without group";
+    if(request->quantize && !request->binary) return "quantize given without format=binary";
+    if(request->upperBoundSpecified && request->lowerBoundSpecified)
+    {
+        if(spa::validateBounds(&request->upperBound, &request->lowerBound) != spa::OK) return "invalid window";
+    }
+    else if(request->upperBoundSpecified || request->lowerBoundSpecified)
+    {
+        if(spa::validateBound(request->upperBoundSpecified ? request->upperBound : request->lowerBound) != spa::OK)
+            return "invalid window";
+    }
+    if(request->useConstCorr && spa::validateBounds(&request->ubCorr, &request->lbCorr) != spa::OK)
+        return "invalid const-corr window";
+    return "";
+}
+
+// createFloatArray() without exiting: nullptr if the memory is not there
+static float** tryCreateFloatArray(int numCols, int numRows)
+{
+    float** floatArray = new (std::nothrow) float* [numCols];
+    if(floatArray == nullptr) return nullptr;
+    for(int i = 0; i < numCols; i++)
+    {
+        floatArray[i] = new (std::nothrow) float [numRows];
+        if(floatArray[i] == nullptr)
+        {
+            freeFloatArray(floatArray, i);
+            return nullptr;
+        }
+    }
+    return floatArray;
+}
+
+// Answer one request; returns false once the client can no longer be written to. Running out
+// of memory fails the request, not the server.
+static bool answerRequest(int socket, const ServerRequest& request, SpectrumCache& cache, float wavenumber[])
+{
+    const int SIZE = spa::NUM_POINTS;
+    const int numFiles = (int)request.files.size();
+
+    // Hold on to the spectra for the whole request, even if the cache evicts them meanwhile
+    std::vector<spa::Spectrum> spectra(numFiles);
+    for(int i = 0; i < numFiles; i++)
+    {
+        spa::Status status = cache.get(request.files[i], &spectra[i]);
+        if(status != spa::OK)
+            return sendError(socket, "file '" + request.files[i] + "': " + spa::statusMessage(status));
+    }
+    // The processing functions take float**; they only read the cached values
+    std::vector<float*> IR_DATA(numFiles);
+    for(int i = 0; i < numFiles; i++)
+        IR_DATA[i] = const_cast<float*>(spectra[i].values().data());
+
+    int firstIndex = 0;
+    int lastIndex = SIZE - 1;
+    if(request.upperBoundSpecified) firstIndex = spa::wavenumberToIndex((float)request.upperBound).value();
+    if(request.lowerBoundSpecified) lastIndex = spa::wavenumberToIndex((float)request.lowerBound).value();
+    const int numRows = lastIndex - firstIndex + 1;
+
+    float** data = &IR_DATA[0];
+    float** CORR_DATA = nullptr;
+    if(request.useConstCorr)
+    {
+        CORR_DATA = tryCreateFloatArray(numFiles, SIZE);
+        spa::Status status = ( CORR_DATA == nullptr ? spa::ERROR_OUT_OF_MEMORY
+            : computeConstCorr(CORR_DATA, data, numFiles, wavenumber, SIZE, request.ubCorr, request.lbCorr) );
+        if(status != spa::OK)
+        {
+            freeFloatArray(CORR_DATA, numFiles);
+            return sendError(socket, spa::statusMessage(status));
+        }
+        data = CORR_DATA;
+    }
+
+    // Column titles are the file names, or the first file name of each group
+    int numCols = numFiles;
+    std::vector<char*> colTitles;
+    for(int i = 0; i < numFiles; i += request.groupSize)
+        colTitles.push_back(const_cast<char*>(request.files[i].c_str()));
+    std::vector<float*> windowData(numFiles);
+    for(int i = 0; i < numFiles; i++)
+        windowData[i] = data[i] + firstIndex;
+    float** AVG_DATA = nullptr;
+    if(request.groupSize > 1)
+    { // Only the window is aggregated
+        numCols = numFiles / request.groupSize;
+        AVG_DATA = tryCreateFloatArray(numCols, numRows);
+        spa::Status status = ( AVG_DATA == nullptr ? spa::ERROR_OUT_OF_MEMORY
+            : computeAggregate(AVG_DATA, &windowData[0], numCols, request.groupSize, numRows, request.aggregateMode) );
+        if(status != spa::OK)
+        {
+            freeFloatArray(CORR_DATA, numFiles);
+            freeFloatArray(AVG_DATA, numCols);
+            return sendError(socket, spa::statusMessage(status));
+        }
+        for(int i = 0; i < numCols; i++)
+            windowData[i] = AVG_DATA[i];
+    }
+
+    // Every quantized column is stored first, so the counts frame can hold the largest error
+    const size_t headerBytes = ( request.quantizedFormat == QUANTIZE_INT16 ? 2 * sizeof(float) : 0 );
+    std::vector<std::vector<unsigned char> > columns;
+    if(request.binary && request.quantize)
+    {
+        try
+        {
+            columns.assign(numCols, std::vector<unsigned char>(headerBytes + numRows * sizeof(uint16_t)));
+        }
+        catch(const std::bad_alloc&)
+        {
+            freeFloatArray(CORR_DATA, numFiles);
+            freeFloatArray(AVG_DATA, numCols);
+            return sendError(socket, spa::statusMessage(spa::ERROR_OUT_OF_MEMORY));
+        }
+    }
+
+    bool sent = sendFrame(socket, "OK", 2);
+    if(request.binary && request.quantize)
+    {
+        float maxError = 0;
+        for(int i = 0; i < numCols; i++)
+        {
+            float offsetScale[2];
+            uint16_t* codes = reinterpret_cast<uint16_t*>(&columns[i][headerBytes]);
+            const int firstRow = 0;
+            const int lastRow = numRows - 1;
+            maxError = std::max(maxError, quantizeValues(request.quantizedFormat, windowData[i], numRows, codes,
+                &offsetScale[0], &offsetScale[1], &firstRow, &lastRow, 1));
+            std::memcpy(&columns[i][0], offsetScale, headerBytes);
+        }
+        uint32_t counts[3] = {(uint32_t)numCols, (uint32_t)numRows, 0};
+        std::memcpy(&counts[2], &maxError, sizeof(float));
+        std::string titles;
+        for(int i = 0; i < numCols; i++)
+            titles += std::string(colTitles[i]) + "\n";
+        sent = sent && sendFrame(socket, counts, sizeof(counts))
+            && sendFrame(socket, titles.data(), titles.size())
+            && sendFrame(socket, wavenumber + firstIndex, numRows * sizeof(float));
+        for(int i = 0; sent && i < numCols; i++)
+            sent = sendFrame(socket, &columns[i][0], columns[i].size());
+    }
+    else if(request.binary)
+    {
+        uint32_t counts[2] = {(uint32_t)numCols, (uint32_t)numRows};
+        std::string titles;
+        for(int i = 0; i < numCols; i++)
+            titles += std::string(colTitles[i]) + "\n";
+        sent = sent && sendFrame(socket, counts, sizeof(counts))
+            && sendFrame(socket, titles.data(), titles.size())
+            && sendFrame(socket, wavenumber + firstIndex, numRows * sizeof(float));
+        for(int i = 0; sent && i < numCols; i++)
+            sent = sendFrame(socket, windowData[i], numRows * sizeof(float));
+    }
+    else
+    {
+        std::string block;
+        formatCSVHeading(block, &colTitles[0], numCols);
+        sent = sent && sendFrame(socket, block.data(), block.size());
+        for(int row = 0; sent && row < numRows; row += SERVER_ROWS_PER_FRAME)
+        {
+            block.clear();
+            int lastRow = std::min(row + SERVER_ROWS_PER_FRAME, numRows) - 1;
+            formatCSVRows(block, &windowData[0], wavenumber + firstIndex, numCols, row, lastRow);
+            sent = sendFrame(socket, block.data(), block.size());
+        }
+    }
+    sent = sent && sendFrame(socket, "", 0);
+
+    freeFloatArray(CORR_DATA, numFiles);
+    freeFloatArray(AVG_DATA, numCols);
+    return sent;
+}
+
+// Answer requests on one connection until the client closes it
+static void handleConnection(int socket, SpectrumCache& cache, float wavenumber[])
+{
+    unsigned char header[4];
+    while(readAll(socket, reinterpret_cast<char*>(header), 4))
+    {
+        uint32_t length = header[0] | (header[1] << 8) | (header[2] << 16) | ((uint32_t)header[3] << 24);
+        if(length > MAX_REQUEST_BYTES)
+        { // Cannot skip that much input reliably; give up on the connection
+            sendError(socket, "request too large");
+            return;
+        }
+        std::string text(length, '\0');
+        if(length > 0 && !readAll(socket, &text[0], length)) return;
+
+        ServerRequest request;
+        std::string problem = parseRequest(text, &request);
+        bool sent = ( problem.empty() ? answerRequest(socket, request, cache, wavenumber) : sendError(socket, problem) );
+        if(!sent) return;
+    }
+    return;
+}
+
+void serveRequests(const char* socketPath, int numThreads, size_t cacheBytes)
+{
+    const char* funcDef = "void serveRequests(const char*, int, size_t)";
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(std::strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        std::cerr << "Error: " << funcDef << ": socket path '" << socketPath << "' is too long.\n";
+        std::exit(1);
+    }
+    std::strcpy(address.sun_path, socketPath);
+
+    // A socket left behind by an earlier server is replaced; anything else is left alone
+    struct stat info;
+    if(lstat(socketPath, &info) == 0)
+    {
+        if(!S_ISSOCK(info.st_mode))
+        {
+            std::cerr << "Error: " << funcDef << ": '" << socketPath << "' exists and is not a socket.\n";
+            std::exit(1);
+        }
+        unlink(socketPath);
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listener < 0
+        || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || listen(listener, 64) != 0)
+    {
+        std::cerr << "Error: " << funcDef << ": unable to listen on '" << socketPath << "': " << std::strerror(errno) << ".\n";
+        std::exit(1);
+    }
+
+    spa::Span<const float> axis = spa::wavenumberAxis();
+    std::vector<float> wavenumber(axis.begin(), axis.end());
+    SpectrumCache cache(cacheBytes);
+    ConnectionQueue connections;
+    std::vector<std::thread> workers;
+    for(int t = 0; t < numThreads; t++)
+        workers.push_back(std::thread([&]()
+        {
+            for(;;)
+            {
+                int connection = connections.pop();
+                handleConnection(connection, cache, &wavenumber[0]);
+                close(connection);
+            }
+        }));
+
+    std::cerr << "Serving on '" << socketPath << "' with " << numThreads << " threads.\n";
+    for(;;)
+    {
+        int connection = accept(listener, nullptr, nullptr);
+        if(connection >= 0)
+            connections.push(connection);
+        else if(errno != EINTR && errno != ECONNABORTED)
+        {
+            std::cerr << "Error: " << funcDef << ": accept() failed: " << std::strerror(errno) << ".\n";
+            std::exit(1);
+        }
+    }
+}
+
+#endif // _WIN32
@@ -0,0 +1,33 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <cstddef>
+
+// spa-reader --serve=<socket path>: answer requests on a Unix domain socket instead of reading
+// the files named on the command line. Connections are handled by numThreads threads which
+// share one SpectrumCache of at most cacheBytes, so a spectrum asked for again is not re-read
+// unless its file has changed. Does not return.
+//
+// Every message is framed as a 4-byte little-endian length followed by that many bytes. A
+// request is one frame of text, one 'name=value' per line:
+//
+//     file=<SPA path>          once per spectrum, in column order (relative to the server);
+//                              at most 1024 per request
+//     ub=<N1>, lb=<N2>         optional window, as -u / -l
+//     group=<N5>               optional, as --group-files
+//     aggregate=<mode>         mean (default), median or trimmed-mean
+//     const-corr=<N3>-<N4>     optional, as --calculate-const-corr
+//     format=csv|binary        csv (default)
+//     quantize=float16|int16   optional with format=binary: 16-bit values (see quantize.h)
+//
+// The reply is a frame holding "OK" or "ERROR: <reason>", then the data frames, then an empty
+// frame. A request the server has no memory for is answered "ERROR: out of memory". CSV data is the text spa-reader would have saved, a block of rows per frame. Binary
+// data is a frame of two 4-byte counts (columns, rows), a frame of column titles separated by
+// '\n', a frame of the rows' wavenumbers and a frame per column, all 4-byte floats. Quantized
+// binary data has a third 4-byte value in the counts frame, the largest absolute error as a
+// float, and each column frame holds 2-byte codes: IEEE halves for float16; for int16, the
+// column's float offset and scale come first, and each value is offset + scale * code with
+// the code read as a signed integer. A client may send further requests on the same connection.
+void serveRequests(const char* socketPath, int numThreads, size_t cacheBytes);
+
+#endif // SERVER_H
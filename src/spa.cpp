@@ -0,0 +1,239 @@
+#include "spa.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace spa
+{
+
+const char* statusMessage(Status status)
+{
+    switch(status)
+    {
+        case OK: return "success";
+        case ERROR_OPEN: return "unable to open file";
+        case ERROR_READ: return "file is too short or could not be read";
+        case ERROR_BOUNDS: return "wavenumber bounds are equal or outside the spectrum";
+        case ERROR_PARSE: return "not a number";
+        case ERROR_OUT_OF_MEMORY: return "out of memory";
+        case ERROR_WRITE: return "unable to write file";
+        case ERROR_ARGUMENT: return "invalid argument";
+        case ERROR_ANCHORS: return "anchor windows do not determine the baseline polynomial";
+    }
+    return "unknown error";
+}
+
+Span<const float> wavenumberAxis()
+{
+    // Built once, on first use; C++11 makes the initialization thread-safe
+    static const std::vector<float> axis = []()
+    {
+        const float STEP_SIZE = (MAX_WAVENUMBER - MIN_WAVENUMBER) / (NUM_POINTS - 1);
+        std::vector<float> wavenumbers(NUM_POINTS);
+        for(int i = 0; i < NUM_POINTS; i++)
+            wavenumbers[i] = MAX_WAVENUMBER - (STEP_SIZE * i);
+        return wavenumbers;
+    }();
+    return Span<const float>(&axis[0], axis.size());
+}
+
+Result<int> wavenumberToIndex(float wavenumber)
+{
+    if(!(wavenumber <= MAX_WAVENUMBER && wavenumber >= MIN_WAVENUMBER)) return ERROR_BOUNDS;
+    Span<const float> axis = wavenumberAxis();
+    const float STEP_SIZE = (MAX_WAVENUMBER - MIN_WAVENUMBER) / (NUM_POINTS - 1);
+    // Estimate, then settle on the last point whose wavenumber is above the one wanted
+    int candidate = (int)((MAX_WAVENUMBER - wavenumber) / STEP_SIZE);
+    if(candidate > NUM_POINTS - 2) candidate = NUM_POINTS - 2;
+    if(candidate < 0) candidate = 0;
+    while(candidate > 0 && !(wavenumber < axis[candidate]))
+        candidate--;
+    while(candidate < NUM_POINTS - 2 && wavenumber < axis[candidate + 1])
+        candidate++;
+    float leftDistance = std::fabs(wavenumber - axis[candidate]);
+    float rightDistance = std::fabs(wavenumber - axis[candidate + 1]);
+    return ( leftDistance <= rightDistance ? candidate : candidate + 1 );
+}
+
+Status validateBounds(int* upperBound, int* lowerBound)
+{
+    if(*upperBound == *lowerBound) return ERROR_BOUNDS;
+    if(*upperBound < *lowerBound)
+    {
+        int temp = *upperBound;
+        *upperBound = *lowerBound;
+        *lowerBound = temp;
+    }
+    if(*upperBound > MAX_WAVENUMBER || *lowerBound < MIN_WAVENUMBER) return ERROR_BOUNDS;
+    return OK;
+}
+
+Status validateBound(int bound)
+{
+    if(bound >= MAX_WAVENUMBER || bound <= MIN_WAVENUMBER) return ERROR_BOUNDS;
+    return OK;
+}
+
+Status parseInt(const std::string& text, int* value)
+{
+    // Like strToInt(): an optional '-', digits, and anything after a '.' is dropped
+    std::string digits = text.substr(0, text.find('.'));
+    bool negative = (!digits.empty() && digits[0] == '-');
+    if(negative) digits = digits.substr(1);
+    int number = 0;
+    for(size_t i = 0; i < digits.length(); i++)
+    {
+        if(digits[i] < '0' || digits[i] > '9') return ERROR_PARSE;
+        number = 10 * number + (digits[i] - '0');
+    }
+    *value = ( negative ? -number : number );
+    return OK;
+}
+
+Status parseDouble(const std::string& text, double* value)
+{
+    if(text.empty()) return ERROR_PARSE;
+    char* end = nullptr;
+    errno = 0;
+    double number = std::strtod(text.c_str(), &end);
+    if(*end != '\0' || errno == ERANGE) return ERROR_PARSE;
+    *value = number;
+    return OK;
+}
+
+Status readSpectrumData(const char* path, float values[])
+{
+    std::ifstream spaInputFile (path, std::ios::in | std::ios::binary);
+    if(!spaInputFile.is_open()) return ERROR_OPEN;
+    // Go to first datum, then read data straight into values (4 bytes per datum)
+    spaInputFile.seekg(DATA_START, std::ios::beg);
+    spaInputFile.read(reinterpret_cast<char*>(values), NUM_POINTS * 4);
+    if(spaInputFile.gcount() != NUM_POINTS * 4) return ERROR_READ;
+    return OK;
+}
+
+Status readSpectrumRanges(const char* path, const int firstIndex[], const int lastIndex[], int numRanges, float values[])
+{
+    for(int r = 0; r < numRanges; r++)
+        if(firstIndex[r] < 0 || lastIndex[r] >= NUM_POINTS || firstIndex[r] > lastIndex[r]) return ERROR_BOUNDS;
+#ifdef _WIN32
+    std::ifstream spaInputFile (path, std::ios::in | std::ios::binary);
+    if(!spaInputFile.is_open()) return ERROR_OPEN;
+    for(int r = 0; r < numRanges; r++)
+    {
+        std::streamsize length = (std::streamsize)(lastIndex[r] - firstIndex[r] + 1) * 4;
+        spaInputFile.seekg(DATA_START + 4 * (std::streamoff)firstIndex[r], std::ios::beg);
+        spaInputFile.read(reinterpret_cast<char*>(values + firstIndex[r]), length);
+        if(spaInputFile.gcount() != length) return ERROR_READ;
+    }
+#else
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return ERROR_OPEN;
+    for(int r = 0; r < numRanges; r++)
+    {
+        char* destination = reinterpret_cast<char*>(values + firstIndex[r]);
+        size_t length = (size_t)(lastIndex[r] - firstIndex[r] + 1) * 4;
+        off_t offset = DATA_START + 4 * (off_t)firstIndex[r];
+        while(length > 0)
+        {
+            ssize_t got = pread(fd, destination, length, offset);
+            if(got < 0 && errno == EINTR) continue;
+            if(got <= 0)
+            {
+                close(fd);
+                return ERROR_READ;
+            }
+            destination += got;
+            offset += got;
+            length -= got;
+        }
+    }
+    close(fd);
+#endif
+    return OK;
+}
+
+Status decodeSpectrumData(const void* bytes, size_t numBytes, float values[])
+{
+    if(numBytes < (size_t)DATA_END + 1) return ERROR_READ;
+    std::memcpy(values, static_cast<const char*>(bytes) + DATA_START, NUM_POINTS * 4);
+    return OK;
+}
+
+Status decodeSpectrumRanges(const void* bytes, size_t numBytes, const int firstIndex[], const int lastIndex[], int numRanges, float values[])
+{
+    for(int r = 0; r < numRanges; r++)
+        if(firstIndex[r] < 0 || lastIndex[r] >= NUM_POINTS || firstIndex[r] > lastIndex[r]) return ERROR_BOUNDS;
+    for(int r = 0; r < numRanges; r++)
+    {
+        size_t end = DATA_START + 4 * ((size_t)lastIndex[r] + 1);
+        if(numBytes < end) return ERROR_READ;
+        std::memcpy(values + firstIndex[r], static_cast<const char*>(bytes) + DATA_START + 4 * (size_t)firstIndex[r],
+            (size_t)(lastIndex[r] - firstIndex[r] + 1) * 4);
+    }
+    return OK;
+}
+
+Span<const float> Spectrum::values() const
+{
+    if(!data) return Span<const float>();
+    return Span<const float>(&(*data)[0], data->size());
+}
+
+Result<Span<const float> > Spectrum::region(int upperBound, int lowerBound) const
+{
+    if(!data) return ERROR_READ;
+    Status status = validateBounds(&upperBound, &lowerBound);
+    if(status != OK) return status;
+    int firstIndex = wavenumberToIndex((float)upperBound).value();
+    int lastIndex = wavenumberToIndex((float)lowerBound).value();
+    return values().subspan(firstIndex, lastIndex - firstIndex + 1);
+}
+
+// Allocate the storage for one spectrum without throwing
+static Status allocateSpectrum(std::shared_ptr<std::vector<float> >* data)
+{
+    std::vector<float>* values = new (std::nothrow) std::vector<float>();
+    if(values == nullptr) return ERROR_OUT_OF_MEMORY;
+    data->reset(values);
+    try
+    {
+        values->resize(NUM_POINTS);
+    }
+    catch(const std::bad_alloc&)
+    {
+        return ERROR_OUT_OF_MEMORY;
+    }
+    return OK;
+}
+
+Result<SpaFile> SpaFile::open(const std::string& path)
+{
+    SpaFile file;
+    file.filePath = path;
+    Status status = allocateSpectrum(&file.decoded.data);
+    if(status == OK) status = readSpectrumData(path.c_str(), &(*file.decoded.data)[0]);
+    if(status != OK) return status;
+    return file;
+}
+
+Result<SpaFile> SpaFile::fromBytes(const std::string& name, const void* bytes, size_t numBytes)
+{
+    SpaFile file;
+    file.filePath = name;
+    Status status = allocateSpectrum(&file.decoded.data);
+    if(status == OK) status = decodeSpectrumData(bytes, numBytes, &(*file.decoded.data)[0]);
+    if(status != OK) return status;
+    return file;
+}
+
+} // namespace spa
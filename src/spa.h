@@ -0,0 +1,142 @@
+#ifndef SPA_H
+#define SPA_H
+
+// libspa: read and process SPA files without the spa-reader command line. Nothing in the
+// library exits the process or writes to std::cerr; every operation that can fail returns a
+// Status or a Result.
+//
+// This header reads and decodes SPA files and covers the wavenumber layout, bounds and number
+// parsing. The rest of the library: the per-spectrum transforms (transforms.h), group
+// aggregation and the constant correction (processing.h), the baselines
+// (baseline-correction.h), alignment (alignment.h) and CSV output (csv.h).
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace spa
+{
+
+// Layout of the SPA files written by our Nicolet iS10 (see SPA-Files/readme.md)
+const int DATA_START = 0x49C;     // address of first byte of first datum
+const int DATA_END = 0x036927;    // address of last byte of last datum
+const int NUM_POINTS = (DATA_END - DATA_START + 1) / 4;
+const float MAX_WAVENUMBER = 3999.9907f;  // inverse cm
+const float MIN_WAVENUMBER = 649.9812f;   // inverse cm
+
+enum Status
+{
+    OK = 0,
+    ERROR_OPEN,          // file could not be opened
+    ERROR_READ,          // file is shorter than the SPA layout or reading failed
+    ERROR_BOUNDS,        // wavenumber bounds are equal or outside the spectrum
+    ERROR_PARSE,         // text is not a number
+    ERROR_OUT_OF_MEMORY,
+    ERROR_WRITE,         // output file could not be created or written
+    ERROR_ARGUMENT,      // a count, size or degree the operation cannot use
+    ERROR_ANCHORS        // baseline anchor windows do not determine the polynomial
+};
+
+const char* statusMessage(Status status);
+
+// Either a value or the reason there is none, in the spirit of std::expected
+template <typename T>
+class Result
+{
+public:
+    Result(const T& result) : code(OK), result(result) {}
+    Result(Status status) : code(status), result() {}
+
+    bool ok() const { return code == OK; }
+    Status status() const { return code; }
+    const T& value() const { return result; }
+    T& value() { return result; }
+
+private:
+    Status code;
+    T result;
+};
+
+// Non-owning view of contiguous values; valid while the object that handed it out is alive
+template <typename T>
+class Span
+{
+public:
+    Span() : first(nullptr), count(0) {}
+    Span(T* data, size_t size) : first(data), count(size) {}
+
+    T* data() const { return first; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T& operator[](size_t i) const { return first[i]; }
+    T* begin() const { return first; }
+    T* end() const { return first + count; }
+    Span subspan(size_t offset, size_t length) const { return Span(first + offset, length); }
+
+private:
+    T* first;
+    size_t count;
+};
+
+// Wavenumber of every point, from MAX_WAVENUMBER down to MIN_WAVENUMBER; shared by all spectra
+Span<const float> wavenumberAxis();
+
+// Index of the point nearest to wavenumber (ties go to the higher wavenumber)
+Result<int> wavenumberToIndex(float wavenumber);
+
+// Order the bounds so upperBound > lowerBound and check both lie inside the spectrum
+Status validateBounds(int* upperBound, int* lowerBound);
+// Check a single bound lies strictly inside the spectrum
+Status validateBound(int bound);
+
+// Parse a whole number such as "1850" or "-3"; decimals are truncated as strToInt() does
+Status parseInt(const std::string& text, int* value);
+// Parse a decimal number such as "0.01" or "1e5"
+Status parseDouble(const std::string& text, double* value);
+
+// Read the NUM_POINTS values of an SPA file straight into values[]
+Status readSpectrumData(const char* path, float values[]);
+// Read only values[firstIndex[r]] to values[lastIndex[r]] (inclusive) for each of numRanges
+// sorted, non-overlapping ranges, one positioned read per range; other values are untouched
+Status readSpectrumRanges(const char* path, const int firstIndex[], const int lastIndex[], int numRanges, float values[]);
+// Decode the values from an SPA file already in memory (e.g. a mapped file or archive member)
+Status decodeSpectrumData(const void* bytes, size_t numBytes, float values[]);
+// Decode only the given ranges, as readSpectrumRanges() reads them; other values are untouched
+Status decodeSpectrumRanges(const void* bytes, size_t numBytes, const int firstIndex[], const int lastIndex[], int numRanges, float values[]);
+
+// One decoded spectrum. Copies share the data, so handing a Spectrum around is cheap.
+class Spectrum
+{
+public:
+    Spectrum() {}
+
+    Span<const float> values() const;
+    Span<const float> wavenumbers() const { return wavenumberAxis(); }
+    // Values between two wavenumbers (inclusive, either order), without copying
+    Result<Span<const float> > region(int upperBound, int lowerBound) const;
+
+private:
+    friend class SpaFile;
+    std::shared_ptr<std::vector<float> > data;
+};
+
+class SpaFile
+{
+public:
+    SpaFile() {}
+
+    static Result<SpaFile> open(const std::string& path);
+    static Result<SpaFile> fromBytes(const std::string& name, const void* bytes, size_t numBytes);
+
+    const std::string& path() const { return filePath; }
+    const Spectrum& spectrum() const { return decoded; }
+
+private:
+    std::string filePath;
+    Spectrum decoded;
+};
+
+} // namespace spa
+
+#endif // SPA_H
@@ -0,0 +1,86 @@
+#include "spectrum-cache.h"
+
+#include <sys/stat.h>
+
+// Every cached spectrum holds the same number of values
+static const size_t SPECTRUM_BYTES = spa::NUM_POINTS * sizeof(float);
+
+SpectrumCache::SpectrumCache(size_t maxBytes)
+    : maxBytes(maxBytes), bytes(0), numHits(0), numMisses(0)
+{
+}
+
+bool SpectrumCache::FileVersion::operator==(const FileVersion& other) const
+{
+    return device == other.device && inode == other.inode
+        && size == other.size && modifiedNanos == other.modifiedNanos;
+}
+
+bool SpectrumCache::currentVersion(const std::string& path, FileVersion* version)
+{
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0) return false;
+    version->device = info.st_dev;
+    version->inode = info.st_ino;
+    version->size = info.st_size;
+#ifdef _WIN32
+    version->modifiedNanos = info.st_mtime * 1000000000LL;
+#else
+    version->modifiedNanos = info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+spa::Status SpectrumCache::get(const std::string& path, spa::Spectrum* spectrum)
+{
+    FileVersion version;
+    if(!currentVersion(path, &version)) return spa::ERROR_OPEN;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto found = index.find(path);
+        if(found != index.end() && found->second->version == version)
+        {
+            entries.splice(entries.begin(), entries, found->second);
+            *spectrum = found->second->spectrum;
+            numHits++;
+            return spa::OK;
+        }
+    }
+
+    numMisses++;
+    spa::Result<spa::SpaFile> file = spa::SpaFile::open(path);
+    if(!file.ok()) return file.status();
+    Entry entry = {path, version, file.value().spectrum()};
+    *spectrum = entry.spectrum;
+    std::lock_guard<std::mutex> guard(lock);
+    insert(entry);
+    return spa::OK;
+}
+
+void SpectrumCache::insert(const Entry& entry)
+{
+    auto found = index.find(entry.path);
+    if(found != index.end())
+    { // Stale version, or another thread read the same file meanwhile
+        entries.erase(found->second);
+        index.erase(found);
+        bytes -= SPECTRUM_BYTES;
+    }
+    entries.push_front(entry);
+    index[entry.path] = entries.begin();
+    bytes += SPECTRUM_BYTES;
+    // Spectra still used by a request stay alive until it lets go of them
+    while(bytes > maxBytes && !entries.empty())
+    {
+        index.erase(entries.back().path);
+        entries.pop_back();
+        bytes -= SPECTRUM_BYTES;
+    }
+    return;
+}
+
+size_t SpectrumCache::bytesHeld() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return bytes;
+}
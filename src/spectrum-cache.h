@@ -0,0 +1,60 @@
+#ifndef SPECTRUM_CACHE_H
+#define SPECTRUM_CACHE_H
+
+#include "spa.h"
+
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Decoded spectra kept in memory between requests, least recently used first out once the
+// values held exceed maxBytes. An entry is only used while the file's device, inode, size and
+// modification time are unchanged, so a file rewritten in place or replaced by a rename is
+// read again. Safe to share between threads; files are read outside the lock, so a slow read
+// does not hold up hits on other files.
+class SpectrumCache
+{
+public:
+    explicit SpectrumCache(size_t maxBytes);
+
+    // Cached spectrum of the SPA file at path, reading it on a miss
+    spa::Status get(const std::string& path, spa::Spectrum* spectrum);
+
+    size_t bytesHeld() const;
+    long long hits() const { return numHits.load(); }
+    long long misses() const { return numMisses.load(); }
+
+private:
+    struct FileVersion
+    {
+        unsigned long long device;
+        unsigned long long inode;
+        long long size;
+        long long modifiedNanos;
+
+        bool operator==(const FileVersion& other) const;
+    };
+
+    struct Entry
+    {
+        std::string path;
+        FileVersion version;
+        spa::Spectrum spectrum;
+    };
+
+    static bool currentVersion(const std::string& path, FileVersion* version);
+    void insert(const Entry& entry); // caller holds lock
+
+    const size_t maxBytes;
+    size_t bytes;
+    mutable std::mutex lock;
+    std::list<Entry> entries; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    std::atomic<long long> numHits;
+    std::atomic<long long> numMisses;
+};
+
+#endif // SPECTRUM_CACHE_H
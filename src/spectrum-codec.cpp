@@ -0,0 +1,336 @@
+#include "spectrum-codec.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+const int BLOCK_VALUES = 256;
+const int BLOCK_LANES = 8;
+const int LANE_VALUES = BLOCK_VALUES / BLOCK_LANES;
+const int HEADER_BYTES = 8;
+const uint32_t SPZ_VERSION = 1;
+
+// Small residuals of either sign become small unsigned numbers: 0, -1, 1, -2, ... -> 0, 1, 2, 3, ...
+static inline uint32_t zigzag(uint32_t residual)
+{
+    return (residual << 1) ^ (uint32_t)((int32_t)residual >> 31);
+}
+
+static inline uint32_t unzigzag(uint32_t code)
+{
+    return (code >> 1) ^ (0u - (code & 1));
+}
+
+// Little-endian hosts, as for the SPA data
+static inline void put32(std::vector<unsigned char>& bytes, uint32_t value)
+{
+    unsigned char word[4];
+    std::memcpy(word, &value, 4);
+    bytes.insert(bytes.end(), word, word + 4);
+}
+
+static inline uint32_t get32(const unsigned char* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, 4);
+    return value;
+}
+
+void encodeSpectrum(const float values[], int count, std::vector<unsigned char>& encoded)
+{
+    const int numBlocks = (count + BLOCK_VALUES - 1) / BLOCK_VALUES;
+    std::vector<uint32_t> residuals((size_t)numBlocks * BLOCK_VALUES, 0);
+    uint32_t previous = 0;
+    uint32_t previousDiff = 0;
+    if(count > 0) std::memcpy(&previous, values, 4);
+    const uint32_t first = previous;
+    for(int i = 0; i < count; i++)
+    { // Wrapping unsigned arithmetic, undone exactly by the decoder
+        uint32_t bits;
+        std::memcpy(&bits, values + i, 4);
+        uint32_t diff = bits - previous;
+        residuals[i] = zigzag(diff - previousDiff);
+        previous = bits;
+        previousDiff = diff;
+    }
+
+    put32(encoded, (uint32_t)count);
+    put32(encoded, first);
+    std::vector<int> widths(numBlocks);
+    for(int b = 0; b < numBlocks; b++)
+    {
+        uint32_t all = 0;
+        for(int i = 0; i < BLOCK_VALUES; i++)
+            all |= residuals[(size_t)b * BLOCK_VALUES + i];
+        int width = 0;
+        for(; width < 32 && (all >> width) != 0; width++) {}
+        widths[b] = width;
+        encoded.push_back((unsigned char)width);
+    }
+    std::vector<uint32_t> words;
+    for(int b = 0; b < numBlocks; b++)
+    {
+        const int width = widths[b];
+        const uint32_t* block = &residuals[(size_t)b * BLOCK_VALUES];
+        words.assign((size_t)BLOCK_LANES * width, 0);
+        for(int k = 0; width > 0 && k < LANE_VALUES; k++)
+        {
+            const int bit = k * width;
+            const int word = bit >> 5;
+            const int shift = bit & 31;
+            for(int lane = 0; lane < BLOCK_LANES; lane++)
+            {
+                uint32_t value = block[k * BLOCK_LANES + lane];
+                words[word * BLOCK_LANES + lane] |= value << shift;
+                if(shift + width > 32) words[(word + 1) * BLOCK_LANES + lane] |= value >> (32 - shift);
+            }
+        }
+        for(size_t w = 0; w < words.size(); w++)
+            put32(encoded, words[w]);
+    }
+    return;
+}
+
+// Check the header and block widths; sets where the widths and the first block start
+static bool parseEncoded(const unsigned char* data, size_t length, int count, const unsigned char** widths,
+    const unsigned char** blocks)
+{
+    if(length < (size_t)HEADER_BYTES || count < 0 || get32(data) != (uint32_t)count) return false;
+    const size_t numBlocks = ((size_t)count + BLOCK_VALUES - 1) / BLOCK_VALUES;
+    if(length < HEADER_BYTES + numBlocks) return false;
+    size_t expected = HEADER_BYTES + numBlocks;
+    for(size_t b = 0; b < numBlocks; b++)
+    {
+        if(data[HEADER_BYTES + b] > 32) return false;
+        expected += (size_t)4 * BLOCK_LANES * data[HEADER_BYTES + b];
+    }
+    if(length != expected) return false;
+    *widths = data + HEADER_BYTES;
+    *blocks = data + HEADER_BYTES + numBlocks;
+    return true;
+}
+
+bool decodeSpectrumScalar(const unsigned char* data, size_t length, float values[], int count)
+{
+    const unsigned char* widths;
+    const unsigned char* words;
+    if(!parseEncoded(data, length, count, &widths, &words)) return false;
+    uint32_t previous = get32(data + 4);
+    uint32_t previousDiff = 0;
+    uint32_t residuals[BLOCK_VALUES];
+    for(int first = 0; first < count; first += BLOCK_VALUES)
+    {
+        const int width = widths[first / BLOCK_VALUES];
+        const uint32_t mask = ( width == 32 ? 0xffffffffu : (1u << width) - 1 );
+        for(int k = 0; k < LANE_VALUES; k++)
+        {
+            const int bit = k * width;
+            const int word = bit >> 5;
+            const int shift = bit & 31;
+            for(int lane = 0; lane < BLOCK_LANES; lane++)
+            {
+                uint32_t value = 0;
+                if(width > 0)
+                {
+                    value = get32(words + 4 * (word * BLOCK_LANES + lane)) >> shift;
+                    if(shift + width > 32) value |= get32(words + 4 * ((word + 1) * BLOCK_LANES + lane)) << (32 - shift);
+                }
+                residuals[k * BLOCK_LANES + lane] = value & mask;
+            }
+        }
+        const int numValues = ( count - first < BLOCK_VALUES ? count - first : BLOCK_VALUES );
+        for(int i = 0; i < numValues; i++)
+        {
+            previousDiff += unzigzag(residuals[i]);
+            previous += previousDiff;
+            std::memcpy(values + first + i, &previous, 4);
+        }
+        words += (size_t)4 * BLOCK_LANES * width;
+    }
+    return true;
+}
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+
+#include <immintrin.h>
+
+// Running sum of the eight lanes, plus carry (the sum so far in every lane)
+__attribute__((target("avx2")))
+static inline __m256i prefixSum8(__m256i v, __m256i carry)
+{
+    v = _mm256_add_epi32(v, _mm256_slli_si256(v, 4));
+    v = _mm256_add_epi32(v, _mm256_slli_si256(v, 8));
+    // Each half is summed on its own so far; add the low half's total to the high half
+    __m256i lowTotal = _mm256_shuffle_epi32(v, 0xff);
+    v = _mm256_add_epi32(v, _mm256_permute2x128_si256(lowTotal, lowTotal, 0x08));
+    return _mm256_add_epi32(v, carry);
+}
+
+// Eight consecutive residuals per step: one load (two where they straddle a word), one shift,
+// then both running sums in registers. Compiled for AVX2 whatever the build targets, and only
+// called once the CPU has been seen to support it.
+__attribute__((target("avx2")))
+static void decodeBlocksAVX2(const unsigned char* widths, const unsigned char* words, uint32_t first, float values[], int count)
+{
+    const __m256i last = _mm256_set1_epi32(BLOCK_LANES - 1);
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256i bits = _mm256_set1_epi32((int)first);
+    __m256i diffs = _mm256_setzero_si256();
+    float partial[BLOCK_VALUES];
+    for(int firstValue = 0; firstValue < count; firstValue += BLOCK_VALUES)
+    {
+        const int width = widths[firstValue / BLOCK_VALUES];
+        const __m256i mask = _mm256_set1_epi32(( width == 32 ? -1 : (int)((1u << width) - 1) ));
+        // The last block may be partial; it is decoded aside and copied
+        float* out = ( count - firstValue < BLOCK_VALUES ? partial : values + firstValue );
+        for(int k = 0; k < LANE_VALUES; k++)
+        {
+            __m256i codes = _mm256_setzero_si256();
+            if(width > 0)
+            {
+                const int bit = k * width;
+                const int word = bit >> 5;
+                const int shift = bit & 31;
+                codes = _mm256_srl_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + 4 * word * BLOCK_LANES)),
+                    _mm_cvtsi32_si128(shift));
+                if(shift + width > 32)
+                    codes = _mm256_or_si256(codes, _mm256_sll_epi32(
+                        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + 4 * (word + 1) * BLOCK_LANES)),
+                        _mm_cvtsi32_si128(32 - shift)));
+                codes = _mm256_and_si256(codes, mask);
+            }
+            __m256i residuals = _mm256_xor_si256(_mm256_srli_epi32(codes, 1),
+                _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(codes, one)));
+            diffs = prefixSum8(residuals, diffs);
+            bits = prefixSum8(diffs, bits);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k * BLOCK_LANES), bits);
+            diffs = _mm256_permutevar8x32_epi32(diffs, last);
+            bits = _mm256_permutevar8x32_epi32(bits, last);
+        }
+        if(out == partial) std::memcpy(values + firstValue, partial, (size_t)(count - firstValue) * sizeof(float));
+        words += (size_t)4 * BLOCK_LANES * width;
+    }
+    return;
+}
+
+bool spectrumCodecUsesSimd()
+{
+    static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+    return hasAVX2;
+}
+
+#else // no AVX2
+
+static void decodeBlocksAVX2(const unsigned char*, const unsigned char*, uint32_t, float[], int) {}
+bool spectrumCodecUsesSimd() { return false; }
+
+#endif
+
+bool decodeSpectrum(const unsigned char* data, size_t length, float values[], int count)
+{
+    if(!spectrumCodecUsesSimd()) return decodeSpectrumScalar(data, length, values, count);
+    const unsigned char* widths;
+    const unsigned char* words;
+    if(!parseEncoded(data, length, count, &widths, &words)) return false;
+    decodeBlocksAVX2(widths, words, get32(data + 4), values, count);
+    return true;
+}
+
+long long writeSpzDataSet(const char* path, char** colTitles, const std::vector<std::vector<unsigned char> >& encoded,
+    int firstIndex, int numRows)
+{
+    const char* funcDef = "long long writeSpzDataSet(const char*, char**, const std::vector<std::vector<unsigned char> >&, int, int)";
+    const int numCols = (int)encoded.size();
+    std::string titles;
+    for(int j = 0; j < numCols; j++)
+        titles += std::string(colTitles[j]) + "\n";
+    std::vector<unsigned char> header(4);
+    std::memcpy(&header[0], "SPZ1", 4);
+    put32(header, SPZ_VERSION);
+    put32(header, (uint32_t)numCols);
+    put32(header, (uint32_t)firstIndex);
+    put32(header, (uint32_t)numRows);
+    put32(header, (uint32_t)titles.size());
+
+    std::ofstream file (path, std::ios::out | std::ios::binary);
+    if(!file.is_open())
+    {
+        std::cerr << "Error: " << funcDef << ": unable to open '" << path << "'.\n";
+        std::exit(1);
+    }
+    file.write(reinterpret_cast<const char*>(&header[0]), header.size());
+    file.write(titles.data(), titles.size());
+    long long bytesWritten = (long long)(header.size() + titles.size());
+    for(int j = 0; j < numCols; j++)
+    {
+        std::vector<unsigned char> size;
+        put32(size, (uint32_t)encoded[j].size());
+        file.write(reinterpret_cast<const char*>(&size[0]), size.size());
+        file.write(reinterpret_cast<const char*>(&encoded[j][0]), encoded[j].size());
+        bytesWritten += (long long)(size.size() + encoded[j].size());
+    }
+    file.close();
+    if(!file)
+    {
+        std::cerr << "Error: " << funcDef << ": unable to write '" << path << "'.\n";
+        std::exit(1);
+    }
+    return bytesWritten;
+}
+
+void readSpzDataSet(const char* path, int numPoints, SpzDataSet* dataSet)
+{
+    const char* funcDef = "void readSpzDataSet(const char*, int, SpzDataSet*)";
+    std::ifstream file (path, std::ios::in | std::ios::binary);
+    if(!file.is_open())
+    {
+        std::cerr << "Error: " << funcDef << ": unable to open '" << path << "'.\n";
+        std::exit(1);
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    const std::string bytes = contents.str();
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(bytes.data());
+    const unsigned char* end = p + bytes.size();
+    bool valid = bytes.size() >= 24 && std::memcmp(p, "SPZ1", 4) == 0 && get32(p + 4) == SPZ_VERSION;
+    const uint32_t numCols = ( valid ? get32(p + 8) : 0 );
+    const uint32_t firstIndex = ( valid ? get32(p + 12) : 0 );
+    const uint32_t numRows = ( valid ? get32(p + 16) : 0 );
+    const uint32_t titleBytes = ( valid ? get32(p + 20) : 0 );
+    valid = valid && numRows > 0 && firstIndex < (uint32_t)numPoints && numRows <= (uint32_t)numPoints - firstIndex
+        && titleBytes <= (size_t)(end - p) - 24;
+    if(valid)
+    {
+        p += 24;
+        dataSet->titles.clear();
+        std::string titles(reinterpret_cast<const char*>(p), titleBytes);
+        for(size_t start = 0; start < titles.size(); )
+        {
+            size_t newline = titles.find('\n', start);
+            if(newline == std::string::npos) break;
+            dataSet->titles.push_back(titles.substr(start, newline - start));
+            start = newline + 1;
+        }
+        valid = dataSet->titles.size() == numCols;
+        p += titleBytes;
+    }
+    dataSet->firstIndex = (int)firstIndex;
+    dataSet->numRows = (int)numRows;
+    dataSet->columns.assign(( valid ? numCols : 0 ), std::vector<float>(numRows));
+    for(uint32_t j = 0; valid && j < numCols; j++)
+    {
+        uint32_t size = ( end - p >= 4 ? get32(p) : 0 );
+        valid = end - p >= 4 && size <= (size_t)(end - p) - 4
+            && decodeSpectrum(p + 4, size, &dataSet->columns[j][0], (int)numRows);
+        p += 4 + ( valid ? size : 0 );
+    }
+    if(!valid || p != end)
+    {
+        std::cerr << "Error: " << funcDef << ": '" << path << "' is not a data set saved by --output-format=spz.\n";
+        std::exit(1);
+    }
+    return;
+}
@@ -1,7 +1,10 @@
+#include "spa.h"
+
 #include <string>
 #include <cstdlib>
 #include <iostream>
 #include <cmath>
+#include <vector>
 
 using namespace std;
 
@@ -89,4 +92,47 @@ int strToInt(string numberAsString)
 		}
 	}
 	return integer;
-}
\ No newline at end of file
+}
+
+// Split str into the pieces between each occurrence of dividingChar
+vector<string> splitStrAt(string str, char dividingChar)
+{
+	vector<string> pieces;
+	int length = str.length();
+	int pieceStart = 0;
+	for(int i = 0; i < length; i++)
+		if(str[i] == dividingChar)
+		{
+			pieces.push_back(str.substr(pieceStart, i - pieceStart));
+			pieceStart = i + 1;
+		}
+	pieces.push_back(str.substr(pieceStart));
+	return pieces;
+}
+
+// Convert a decimal number such as "0.01", "-3" or "1e5"
+double strToDouble(string numberAsString)
+{
+	double number = 0;
+	if(spa::parseDouble(numberAsString, &number) != spa::OK)
+	{
+		cerr << "Error: strToDouble(string): '" << numberAsString << "' is not a number." << endl;
+		exit(1);
+	}
+	return number;
+}
+
+// A size in bytes such as "512M": a number, then optionally K, M or G (powers of 1024)
+long long strToBytes(string sizeAsString)
+{
+	long long multiplier = 1;
+	char suffix = ( sizeAsString.empty() ? '\0' : sizeAsString[sizeAsString.length() - 1] );
+	switch(suffix)
+	{
+		case 'K': case 'k': multiplier = 1LL << 10; break;
+		case 'M': case 'm': multiplier = 1LL << 20; break;
+		case 'G': case 'g': multiplier = 1LL << 30; break;
+	}
+	if(multiplier != 1) sizeAsString = sizeAsString.substr(0, sizeAsString.length() - 1);
+	return (long long)(strToDouble(sizeAsString) * (double)multiplier);
+}
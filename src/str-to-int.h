@@ -2,9 +2,13 @@
 #define STR_TO_INT_H
 
 #include <string>
+#include <vector>
 
 std::string truncateStrAt(std::string, char endChar);
 std::string getStrAfter(std::string, char startChar);
 int strToInt(std::string);
+double strToDouble(std::string);
+long long strToBytes(std::string);
+std::vector<std::string> splitStrAt(std::string, char dividingChar);
 
 #endif // STR_TO_INT_H
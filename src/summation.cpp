@@ -0,0 +1,108 @@
+#include "summation.h"
+
+#include <cmath>
+#include <cstring>
+#include <new>
+
+// Set once by main() before any thread starts
+static SummationMode currentMode = SUM_PAIRWISE;
+
+spa::Status parseSummationMode(const char* modeStr, SummationMode* mode)
+{
+    if(std::strcmp(modeStr, "pairwise") == 0) *mode = SUM_PAIRWISE;
+    else if(std::strcmp(modeStr, "compensated") == 0) *mode = SUM_COMPENSATED;
+    else return spa::ERROR_PARSE;
+    return spa::OK;
+}
+
+void setSummationMode(SummationMode mode)
+{
+    currentMode = mode;
+    return;
+}
+
+SummationMode summationMode()
+{
+    return currentMode;
+}
+
+// Levels of partial sums held at once while summing count spectra pairwise
+static int pairwiseDepth(int count)
+{
+    int depth = 0;
+    for(; count > PAIRWISE_LEAF_TERMS; count -= count / 2)
+        depth++;
+    return depth;
+}
+
+// The tree of pairwiseSum(), applied to whole rows: the right half of each split is summed into
+// scratch, and its own splits into the levels after it
+static void pairwiseSumSpectra(float* __restrict sums, float** spectra, int count, int firstRow, int numRows, float* scratch)
+{
+    if(count <= PAIRWISE_LEAF_TERMS)
+    {
+        const float* first = spectra[0] + firstRow;
+        for(int i = 0; i < numRows; i++)
+            sums[i] = first[i];
+        for(int k = 1; k < count; k++)
+        {
+            const float* __restrict spectrum = spectra[k] + firstRow;
+            for(int i = 0; i < numRows; i++)
+                sums[i] += spectrum[i];
+        }
+        return;
+    }
+    int half = count / 2;
+    pairwiseSumSpectra(sums, spectra, half, firstRow, numRows, scratch);
+    pairwiseSumSpectra(scratch, spectra + half, count - half, firstRow, numRows, scratch + numRows);
+    for(int i = 0; i < numRows; i++)
+        sums[i] += scratch[i];
+    return;
+}
+
+spa::Status sumSpectra(float sums[], float** spectra, int count, int firstRow, int numRows, SummationMode mode)
+{
+    if(count <= 0 || numRows <= 0)
+    {
+        for(int i = 0; i < numRows; i++)
+            sums[i] = 0;
+        return spa::OK;
+    }
+    if(mode == SUM_PAIRWISE && count <= PAIRWISE_LEAF_TERMS)
+    {
+        pairwiseSumSpectra(sums, spectra, count, firstRow, numRows, nullptr);
+        return spa::OK;
+    }
+
+    const int scratchRows = ( mode == SUM_COMPENSATED ? 1 : pairwiseDepth(count) );
+    float* scratch = new (std::nothrow) float [(size_t)scratchRows * numRows];
+    if(scratch == nullptr) return spa::ERROR_OUT_OF_MEMORY;
+    if(mode == SUM_COMPENSATED)
+    { // compensatedSum() for every row at once, scratch holding the corrections
+        for(int i = 0; i < numRows; i++)
+        {
+            sums[i] = 0;
+            scratch[i] = 0;
+        }
+        for(int k = 0; k < count; k++)
+        {
+            const float* spectrum = spectra[k] + firstRow;
+            for(int i = 0; i < numRows; i++)
+            {
+                float value = spectrum[i];
+                float total = sums[i] + value;
+                if(std::fabs(sums[i]) >= std::fabs(value))
+                    scratch[i] += (sums[i] - total) + value;
+                else
+                    scratch[i] += (value - total) + sums[i];
+                sums[i] = total;
+            }
+        }
+        for(int i = 0; i < numRows; i++)
+            sums[i] = sums[i] + scratch[i];
+    }
+    else
+        pairwiseSumSpectra(sums, spectra, count, firstRow, numRows, scratch);
+    delete[] scratch;
+    return spa::OK;
+}
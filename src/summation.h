@@ -0,0 +1,89 @@
+#ifndef SUMMATION_H
+#define SUMMATION_H
+
+#include "spa.h"
+
+#include <cmath>
+
+// The sums behind every average (group means, trimmed means, the mean spectrum and the
+// constant correction offsets) are taken in an order fixed by the number of terms alone, so
+// the outputs do not depend on --threads, on how the work is split between threads or on the
+// SIMD width the compiler picks. Two orders (--summation):
+//     pairwise     up to 8 terms added in order; more are split into the halves [0, n/2) and
+//                  [n/2, n), each summed the same way, and the two sums added. The rounding
+//                  error grows with log n instead of n.
+//     compensated  every term in order, with Neumaier's running correction: the error does
+//                  not grow with n, for about four times the work.
+enum SummationMode
+{
+    SUM_PAIRWISE,
+    SUM_COMPENSATED
+};
+
+// "pairwise" or "compensated"; ERROR_PARSE for anything else
+spa::Status parseSummationMode(const char* modeStr, SummationMode* mode);
+void setSummationMode(SummationMode mode);
+SummationMode summationMode();
+
+// Terms added in order at the leaves of the pairwise tree
+const int PAIRWISE_LEAF_TERMS = 8;
+
+// term(first) + ... + term(first + count - 1), count at most PAIRWISE_LEAF_TERMS
+template <typename Term> inline float pairwiseLeafSum(int first, int count, const Term& term)
+{
+    float sum = term(first);
+    for(int k = first + 1; k < first + count; k++)
+        sum += term(k);
+    return sum;
+}
+
+// term(first) + ... + term(first + count - 1)
+template <typename Term> float pairwiseSum(int first, int count, const Term& term)
+{
+    if(count <= 0) return 0;
+    if(count <= PAIRWISE_LEAF_TERMS) return pairwiseLeafSum(first, count, term);
+    int half = count / 2;
+    if(count <= 2 * PAIRWISE_LEAF_TERMS)
+    { // Both halves are leaves, summed side by side so their additions overlap
+        float left = term(first);
+        float right = term(first + half);
+        for(int k = 1; k < half; k++)
+        {
+            left += term(first + k);
+            right += term(first + half + k);
+        }
+        if(count - half > half) right += term(first + count - 1);
+        return left + right;
+    }
+    return pairwiseSum(first, half, term) + pairwiseSum(first + half, count - half, term);
+}
+
+template <typename Term> float compensatedSum(int count, const Term& term)
+{
+    float sum = 0;
+    float correction = 0;
+    for(int k = 0; k < count; k++)
+    {
+        float value = term(k);
+        float total = sum + value;
+        if(std::fabs(sum) >= std::fabs(value))
+            correction += (sum - total) + value;
+        else
+            correction += (value - total) + sum;
+        sum = total;
+    }
+    return sum + correction;
+}
+
+// term(0) + ... + term(count - 1) in mode's order
+template <typename Term> inline float sumTerms(SummationMode mode, int count, const Term& term)
+{
+    return ( mode == SUM_COMPENSATED ? compensatedSum(count, term) : pairwiseSum(0, count, term) );
+}
+
+// sums[i] = spectra[0][firstRow + i] + ... + spectra[count - 1][firstRow + i] for i below
+// numRows, each added in the order sumTerms() uses. Whole runs of rows are added at once, so
+// the loops vectorize without changing any sum.
+spa::Status sumSpectra(float sums[], float** spectra, int count, int firstRow, int numRows, SummationMode mode);
+
+#endif // SUMMATION_H
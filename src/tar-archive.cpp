@@ -0,0 +1,204 @@
+#include "tar-archive.h"
+#include "input-files.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const size_t TAR_BLOCK = 512;
+
+// Where a member's data lies in the archive
+struct TarMember
+{
+    size_t offset;
+    size_t size;
+};
+
+static const char* archiveBytes = nullptr;
+static size_t archiveSize = 0;
+static std::vector<char> archiveCopy; // the archive, where it cannot be mapped
+static std::unordered_map<std::string, TarMember> members;
+
+bool tarArchiveOpen()
+{
+    return archiveBytes != nullptr;
+}
+
+bool findTarMember(const char* name, const char** bytes, size_t* numBytes)
+{
+    std::unordered_map<std::string, TarMember>::const_iterator member = members.find(name);
+    if(member == members.end()) return false;
+    *bytes = archiveBytes + member->second.offset;
+    *numBytes = member->second.size;
+    return true;
+}
+
+// Header numbers are octal text, or big-endian binary when the first byte has its top bit set
+static bool parseTarNumber(const char* field, size_t length, unsigned long long* value)
+{
+    *value = 0;
+    const unsigned char* digits = reinterpret_cast<const unsigned char*>(field);
+    if(digits[0] & 0x80)
+    {
+        for(size_t i = 0; i < length; i++)
+            *value = (*value << 8) | ( i == 0 ? (digits[i] & 0x7f) : digits[i] );
+        return true;
+    }
+    size_t i = 0;
+    while(i < length && digits[i] == ' ')
+        i++;
+    for(; i < length && digits[i] >= '0' && digits[i] <= '7'; i++)
+        *value = (*value << 3) | (digits[i] - '0');
+    return i == length || digits[i] == ' ' || digits[i] == '\0';
+}
+
+// The checksum counts its own field as spaces
+static bool checksumMatches(const char* header)
+{
+    unsigned long long expected;
+    if(!parseTarNumber(header + 148, 8, &expected)) return false;
+    unsigned long long sum = 0;
+    for(size_t i = 0; i < TAR_BLOCK; i++)
+        sum += ( i >= 148 && i < 156 ? ' ' : (unsigned char)header[i] );
+    return sum == expected;
+}
+
+static std::string fieldString(const char* field, size_t length)
+{
+    return std::string(field, std::find(field, field + length, '\0'));
+}
+
+// The path record of a pax extended header ("<length> path=<name>\n" among others), if any
+static bool paxPath(const char* data, size_t size, std::string* path)
+{
+    bool found = false;
+    size_t position = 0;
+    while(position < size)
+    {
+        size_t length = 0;
+        size_t i = position;
+        for(; i < size && std::isdigit((unsigned char)data[i]); i++)
+            length = length * 10 + (data[i] - '0');
+        if(length == 0 || position + length > size || i >= size || data[i] != ' ') break;
+        std::string record(data + i + 1, data + position + length - 1); // drop the newline
+        if(record.compare(0, 5, "path=") == 0)
+        {
+            *path = record.substr(5);
+            found = true;
+        }
+        position += length;
+    }
+    return found;
+}
+
+static void mapArchive(const char* path)
+{
+    const char* funcDef = "void openTarArchive(const char*, std::vector<std::string>&)";
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if(fd < 0 || fstat(fd, &info) != 0)
+    {
+        std::cerr << "Error: " << funcDef << ": unable to open tar archive '" << path << "': " << std::strerror(errno) << ".\n";
+        std::exit(1);
+    }
+    archiveSize = (size_t)info.st_size;
+    void* mapped = ( archiveSize > 0 ? mmap(nullptr, archiveSize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED );
+    close(fd);
+    if(mapped != MAP_FAILED)
+    { // Members are decoded roughly in archive order, by several threads
+        madvise(mapped, archiveSize, MADV_SEQUENTIAL);
+        archiveBytes = static_cast<const char*>(mapped);
+        return;
+    }
+#endif
+    std::ifstream archive (path, std::ios::in | std::ios::binary | std::ios::ate);
+    if(!archive.is_open())
+    {
+        std::cerr << "Error: " << funcDef << ": unable to open tar archive '" << path << "'.\n";
+        std::exit(1);
+    }
+    archiveCopy.resize((size_t)archive.tellg() + 1); // never empty, so there is a first byte to point at
+    archive.seekg(0, std::ios::beg);
+    archive.read(&archiveCopy[0], archiveCopy.size() - 1);
+    archiveSize = archiveCopy.size() - 1;
+    archiveBytes = &archiveCopy[0];
+    return;
+}
+
+void openTarArchive(const char* path, std::vector<std::string>& memberNames)
+{
+    const char* funcDef = "void openTarArchive(const char*, std::vector<std::string>&)";
+    mapArchive(path);
+
+    std::string nextName; // from a GNU long name or pax header, for the member that follows
+    size_t firstNew = memberNames.size();
+    size_t position = 0;
+    while(position + TAR_BLOCK <= archiveSize)
+    {
+        const char* header = archiveBytes + position;
+        if(header[0] == '\0') break; // end-of-archive blocks
+        unsigned long long size;
+        if(!checksumMatches(header) || !parseTarNumber(header + 124, 12, &size))
+        {
+            std::cerr << "Error: " << funcDef << ": '" << path << "' is not an uncompressed tar archive "
+                << "(bad header at byte " << position << ").\n";
+            std::exit(1);
+        }
+        size_t dataOffset = position + TAR_BLOCK;
+        if(size > archiveSize - dataOffset)
+        {
+            std::cerr << "Error: " << funcDef << ": tar archive '" << path << "' is truncated.\n";
+            std::exit(1);
+        }
+        position = dataOffset + (size + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+
+        const char type = header[156];
+        const char* data = archiveBytes + dataOffset;
+        if(type == 'L')
+        { // GNU long name of the next member
+            nextName = fieldString(data, size);
+            continue;
+        }
+        if(type == 'x')
+        {
+            std::string name;
+            if(paxPath(data, size, &name)) nextName = name;
+            continue;
+        }
+
+        std::string name = nextName;
+        nextName.clear();
+        if(name.empty())
+        {
+            name = fieldString(header, 100);
+            std::string prefix = ( std::memcmp(header + 257, "ustar", 5) == 0 ? fieldString(header + 345, 155) : "" );
+            if(!prefix.empty()) name = prefix + "/" + name;
+        }
+        if(name.compare(0, 2, "./") == 0) name.erase(0, 2);
+        if((type != '0' && type != '\0' && type != '7') || !hasSPAExtension(name)) continue; // only regular files
+
+        TarMember member = {dataOffset, (size_t)size};
+        if(members.count(name) == 0) memberNames.push_back(name);
+        members[name] = member;
+    }
+    if(memberNames.size() == firstNew)
+    {
+        std::cerr << "Error: " << funcDef << ": tar archive '" << path << "' has no .SPA members.\n";
+        std::exit(1);
+    }
+    std::sort(memberNames.begin() + firstNew, memberNames.end(), naturalLess);
+    return;
+}
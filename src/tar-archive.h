@@ -0,0 +1,21 @@
+#ifndef TAR_ARCHIVE_H
+#define TAR_ARCHIVE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// SPA files read straight out of an uncompressed tar archive (--input-tar), without extracting
+// them. The archive is mapped once; its headers (ustar, with GNU long names and pax paths) are
+// walked to find each .SPA member's data, and readSPAFile() decodes spectra from those bytes.
+
+// Map the archive at path and append the names of its .SPA members, in natural order (see
+// naturalLess()), to memberNames. A member stored more than once counts once, with its last
+// copy, as when the archive is extracted. An archive without .SPA members is an error.
+void openTarArchive(const char* path, std::vector<std::string>& memberNames);
+bool tarArchiveOpen();
+
+// The data of the member named name, which stays mapped until the program exits
+bool findTarMember(const char* name, const char** bytes, size_t* numBytes);
+
+#endif // TAR_ARCHIVE_H
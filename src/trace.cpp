@@ -0,0 +1,182 @@
+#include "trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+const size_t TRACE_LABEL_CHARS = 48;
+
+struct TraceEventRecord
+{
+    const char* category;
+    const char* name;
+    long long beginNanos;
+    long long endNanos;
+    int index;
+    char label[TRACE_LABEL_CHARS];  // empty if none
+};
+
+// One thread's events. Only the owning thread writes to it; writeTrace() reads it after that
+// thread has finished.
+struct ThreadTrace
+{
+    int threadId;
+    std::vector<TraceEventRecord> events;   // grows to TRACE_EVENTS_PER_THREAD, then wraps
+    size_t numRecorded;
+};
+
+static std::atomic<bool> traceOn(false);
+static long long traceBeginNanos = 0;
+static std::mutex threadsMutex;     // taken once per thread, when it records its first event
+static std::vector<ThreadTrace*> threadTraces;
+static thread_local ThreadTrace* currentThreadTrace = nullptr;
+
+static ThreadTrace* threadTrace()
+{
+    if(currentThreadTrace == nullptr)
+    {
+        ThreadTrace* trace = new ThreadTrace;
+        trace->numRecorded = 0;
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        trace->threadId = (int)threadTraces.size() + 1;
+        threadTraces.push_back(trace);
+        currentThreadTrace = trace;
+    }
+    return currentThreadTrace;
+}
+
+long long nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void enableTrace()
+{
+    traceBeginNanos = nowNanos();
+    traceOn.store(true, std::memory_order_release);
+    threadTrace(); // the calling thread is thread 1, "main"
+    return;
+}
+
+bool traceEnabled()
+{
+    return traceOn.load(std::memory_order_relaxed);
+}
+
+void traceEvent(const char* category, const char* name, const char* label, int index,
+    long long beginNanos, long long endNanos)
+{
+    if(!traceEnabled()) return;
+    ThreadTrace* trace = threadTrace();
+    TraceEventRecord event;
+    event.category = category;
+    event.name = name;
+    event.beginNanos = beginNanos;
+    event.endNanos = endNanos;
+    event.index = index;
+    event.label[0] = '\0';
+    if(label != nullptr)
+    { // The end of a path names the file
+        size_t length = std::strlen(label);
+        const char* start = ( length < TRACE_LABEL_CHARS ? label : label + length - (TRACE_LABEL_CHARS - 1) );
+        std::strncpy(event.label, start, TRACE_LABEL_CHARS - 1);
+        event.label[TRACE_LABEL_CHARS - 1] = '\0';
+    }
+    if(trace->events.size() < TRACE_EVENTS_PER_THREAD)
+        trace->events.push_back(event);
+    else
+        trace->events[trace->numRecorded % TRACE_EVENTS_PER_THREAD] = event;
+    trace->numRecorded++;
+    return;
+}
+
+TraceScope::TraceScope(const char* eventCategory, const char* eventName, const char* eventLabel, int eventIndex)
+    : category(nullptr), name(eventName), label(eventLabel), index(eventIndex), beginNanos(0)
+{
+    if(!traceEnabled()) return;
+    category = eventCategory;
+    beginNanos = nowNanos();
+}
+
+TraceScope::~TraceScope()
+{
+    if(category != nullptr) traceEvent(category, name, label, index, beginNanos, nowNanos());
+}
+
+static void writeJSONString(std::ostream& output, const char* text)
+{
+    output << '"';
+    for(const char* c = text; *c != '\0'; c++)
+    {
+        if(*c == '"' || *c == '\\')
+            output << '\\' << *c;
+        else if((unsigned char)*c < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)*c);
+            output << escaped;
+        }
+        else
+            output << *c;
+    }
+    output << '"';
+    return;
+}
+
+spa::Status writeTrace(const std::string& path, size_t* numDropped)
+{
+    *numDropped = 0;
+    std::ofstream output (path.c_str());
+    if(!output.is_open()) return spa::ERROR_OPEN;
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    bool first = true;
+    output << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    for(size_t t = 0; t < threadTraces.size(); t++)
+    {
+        const ThreadTrace* trace = threadTraces[t];
+        output << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+            << trace->threadId << ", \"args\": {\"name\": \"";
+        if(trace->threadId == 1)
+            output << "main";
+        else
+            output << "thread " << trace->threadId;
+        output << "\"}}";
+        first = false;
+        // Oldest first: a full ring's oldest event is the next to be overwritten
+        size_t numEvents = trace->events.size();
+        size_t oldest = ( trace->numRecorded > numEvents ? trace->numRecorded % numEvents : 0 );
+        *numDropped += trace->numRecorded - numEvents;
+        for(size_t e = 0; e < numEvents; e++)
+        {
+            const TraceEventRecord& event = trace->events[(oldest + e) % numEvents];
+            char times[96];
+            snprintf(times, sizeof(times), "\"ts\": %.3f, \"dur\": %.3f",
+                (event.beginNanos - traceBeginNanos) / 1e3, (event.endNanos - event.beginNanos) / 1e3);
+            output << ",\n{\"name\": ";
+            writeJSONString(output, event.name);
+            output << ", \"cat\": ";
+            writeJSONString(output, event.category);
+            output << ", \"ph\": \"X\", " << times << ", \"pid\": 1, \"tid\": " << trace->threadId;
+            if(event.label[0] != '\0' || event.index >= 0)
+            {
+                output << ", \"args\": {";
+                if(event.label[0] != '\0')
+                {
+                    output << "\"label\": ";
+                    writeJSONString(output, event.label);
+                }
+                if(event.index >= 0) output << (event.label[0] != '\0' ? ", " : "") << "\"index\": " << event.index;
+                output << "}";
+            }
+            output << "}";
+        }
+    }
+    output << "\n]}\n";
+    output.close();
+    return ( output ? spa::OK : spa::ERROR_WRITE );
+}
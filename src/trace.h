@@ -0,0 +1,51 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "spa.h"
+
+#include <cstddef>
+#include <string>
+
+// The --trace timeline: a begin and end time for each file read, each spectrum transformed,
+// each data set computed and each block of CSV rows formatted and written, on the thread that
+// did it. Each thread records into a ring buffer of its own, so recording takes no lock; once
+// a ring is full its oldest events are overwritten. writeTrace() saves the events in the
+// Chrome trace event format, which chrome://tracing and ui.perfetto.dev open.
+
+const size_t TRACE_EVENTS_PER_THREAD = 1 << 16;  // about 6 MiB once full
+
+// Steady-clock time, for measuring durations and stamping trace events
+long long nowNanos();
+
+void enableTrace();
+bool traceEnabled();
+
+// Record an event that began at beginNanos and ended at endNanos (nowNanos() times). label
+// (copied, and cut to its last few dozen characters) names the file or data set, or is
+// nullptr; index is a block or group number, or -1.
+void traceEvent(const char* category, const char* name, const char* label, int index,
+    long long beginNanos, long long endNanos);
+
+// Records an event from construction to destruction. category and name must be literals.
+class TraceScope
+{
+public:
+    TraceScope(const char* category, const char* name, const char* label = nullptr, int index = -1);
+    ~TraceScope();
+
+private:
+    TraceScope(const TraceScope&);
+    TraceScope& operator=(const TraceScope&);
+
+    const char* category;   // nullptr while the trace is disabled
+    const char* name;
+    const char* label;
+    int index;
+    long long beginNanos;
+};
+
+// Write every thread's events to path; call once the other threads have finished.
+// *numDropped is set to the number of events lost to full rings.
+spa::Status writeTrace(const std::string& path, size_t* numDropped);
+
+#endif // TRACE_H
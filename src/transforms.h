@@ -0,0 +1,20 @@
+#ifndef TRANSFORMS_H
+#define TRANSFORMS_H
+
+// Vectorizable base-10 logarithm of n values (out may equal in). Non-positive and denormal inputs
+// are clamped to the smallest normal float. The absolute error is below 1.7e-7 for inputs in
+// [1e-3, 1e3] and below 1e-6 for inputs in [1e-30, 1e30]; see transforms.cpp.
+void log10Array(float out[], const float in[], int n);
+
+// Divide each spectrum by the reference spectrum, giving % transmission relative to it
+void ratioSpectrumToReference(float spectrum[], const float reference[], int SIZE);
+void ratioToReference(float** IR_DATA, int NUM_SPA_FILES, int SIZE, const float reference[], int numThreads);
+
+// Convert % transmission to absorbance, A = -log10(T / 100) = 2 - log10(T)
+void convertSpectrumToAbsorbance(float spectrum[], int SIZE);
+void convertToAbsorbance(float** IR_DATA, int NUM_SPA_FILES, int SIZE, int numThreads);
+
+// Index of the first value a reference spectrum cannot be divided by (not positive), or -1
+int findNonPositive(const float reference[], int SIZE);
+
+#endif // TRANSFORMS_H
@@ -0,0 +1,239 @@
+#include "watch.h"
+#include "baseline-correction.h"
+#include "data-processing.h"
+#include "input-files.h"
+#include "parallel.h"
+#include "pipeline.h"
+#include "read-write.h"
+#include "spa.h"
+#include "transforms.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+
+void watchDirectory(const char*, const WatchOptions&, float [])
+{
+    std::cerr << "Error: void watchDirectory(const char*, const WatchOptions&, float []): --watch needs inotify, "
+        << "which this build does not support.\n";
+    std::exit(1);
+}
+
+#else // Linux
+
+#include <dirent.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// A file the watcher has noticed, and when (for the latency report)
+struct NoticedFile
+{
+    std::string path;
+    long long noticedNanos;
+};
+
+// Everything read so far. Spectra are never re-read: each batch appends to these.
+struct WatchState
+{
+    std::deque<std::string> paths;  // a deque, so titles[] stays valid as paths grow
+    std::vector<char*> titles;
+    std::set<std::string> seen;
+    std::vector<float*> IR_DATA;
+    std::vector<char*> groupTitles;
+    std::vector<float*> AVG_DATA;       // completed groups only
+    std::vector<float*> CORR_DATA;
+    std::vector<float*> AVG_CORR_DATA;
+    std::vector<AlsWorkspace*> alsWorkspaces;
+};
+
+// SPA files already in directory, in name order
+static std::vector<std::string> listSPAFiles(const std::string& directory)
+{
+    std::vector<std::string> names;
+    DIR* dir = opendir(directory.c_str());
+    if(dir == nullptr) return names;
+    for(dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+        if(hasSPAExtension(entry->d_name)) names.push_back(entry->d_name);
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+static float* createSpectrum(const char* ptrDef)
+{
+    float* spectrum = new (std::nothrow) float [spa::NUM_POINTS];
+    checkIfNull(spectrum, "float* createSpectrum(const char*)", ptrDef);
+    return spectrum;
+}
+
+// Read, transform and append the new files, then rewrite every output from memory
+static void addFiles(WatchState& state, const std::vector<NoticedFile>& files, const WatchOptions& options, float WAVENUMBER[])
+{
+    const char* funcDef = "static void addFiles(WatchState&, const std::vector<NoticedFile>&, const WatchOptions&, float [])";
+    const int SIZE = spa::NUM_POINTS;
+    const int numNew = (int)files.size();
+    std::vector<float*> spectra(numNew);
+    std::vector<spa::Status> status(numNew);
+    parallelFor(numNew, options.numThreads, [&](int i, int thread)
+    {
+        spectra[i] = createSpectrum("float* spectra[i]");
+        status[i] = spa::readSpectrumData(files[i].path.c_str(), spectra[i]);
+        if(status[i] != spa::OK) return;
+        if(options.reference) ratioSpectrumToReference(spectra[i], options.reference, SIZE);
+        if(options.convertToAbsorbance) convertSpectrumToAbsorbance(spectra[i], SIZE);
+        if(options.useAlsBaseline)
+            subtractAlsBaseline(spectra[i], state.alsWorkspaces[thread], options.alsLambda, options.alsAsymmetry, options.alsIterations);
+    });
+    int numAdded = 0;
+    for(int i = 0; i < numNew; i++)
+    {
+        if(status[i] != spa::OK)
+        { // Keep watching; the file may be rewritten and closed again
+            std::cerr << "Warning: skipping SPA file '" << files[i].path << "': " << spa::statusMessage(status[i]) << ".\n";
+            state.seen.erase(files[i].path);
+            delete[] spectra[i];
+            continue;
+        }
+        state.paths.push_back(files[i].path);
+        state.titles.push_back(&state.paths.back()[0]);
+        state.IR_DATA.push_back(spectra[i]);
+        numAdded++;
+    }
+    if(numAdded == 0) return;
+
+    const int numFiles = (int)state.IR_DATA.size();
+    const std::string AGG_PREFIX = aggregatePrefix(options.aggregateMode);
+    printDataSet("combinedRawData", &state.titles[0], &state.IR_DATA[0], numFiles, WAVENUMBER,
+        options.upperBoundSpecified, options.lowerBoundSpecified, options.upperBound, options.lowerBound, options.ubStr, options.lbStr);
+
+    // Groups completed by this batch; earlier groups cannot change
+    const int numGroups = ( options.groupFiles ? numFiles / options.groupSize : 0 );
+    const int firstNewGroup = (int)state.AVG_DATA.size();
+    for(int g = firstNewGroup; g < numGroups; g++)
+    {
+        state.AVG_DATA.push_back(createSpectrum("float* AVG_DATA[g]"));
+        state.groupTitles.push_back(state.titles[g * options.groupSize]);
+    }
+    if(numGroups > firstNewGroup)
+        checkStatus(computeAggregate(&state.AVG_DATA[firstNewGroup], &state.IR_DATA[firstNewGroup * options.groupSize],
+            numGroups - firstNewGroup, options.groupSize, SIZE, options.aggregateMode), funcDef, AGG_PREFIX + "Data");
+    if(numGroups > 0)
+        printDataSet(AGG_PREFIX + "Data", &state.groupTitles[0], &state.AVG_DATA[0], numGroups, WAVENUMBER,
+            options.upperBoundSpecified, options.lowerBoundSpecified, options.upperBound, options.lowerBound, options.ubStr, options.lbStr);
+
+    // The constant correction is relative to the mean of all spectra, so every file changes
+    if(options.useConstCorr)
+    {
+        while((int)state.CORR_DATA.size() < numFiles)
+            state.CORR_DATA.push_back(createSpectrum("float* CORR_DATA[i]"));
+        checkStatus(computeConstCorr(&state.CORR_DATA[0], &state.IR_DATA[0], numFiles, WAVENUMBER, SIZE, options.ubCorr, options.lbCorr),
+            funcDef, "constCorrData");
+        printDataSet("constCorrData", &state.titles[0], &state.CORR_DATA[0], numFiles, WAVENUMBER,
+            options.upperBoundSpecified, options.lowerBoundSpecified, options.upperBound, options.lowerBound, options.ubStr, options.lbStr);
+        if(numGroups > 0)
+        {
+            while((int)state.AVG_CORR_DATA.size() < numGroups)
+                state.AVG_CORR_DATA.push_back(createSpectrum("float* AVG_CORR_DATA[g]"));
+            checkStatus(computeAggregate(&state.AVG_CORR_DATA[0], &state.CORR_DATA[0], numGroups, options.groupSize, SIZE, options.aggregateMode),
+                funcDef, AGG_PREFIX + "CorrData");
+            printDataSet(AGG_PREFIX + "CorrData", &state.groupTitles[0], &state.AVG_CORR_DATA[0], numGroups, WAVENUMBER,
+                options.upperBoundSpecified, options.lowerBoundSpecified, options.upperBound, options.lowerBound, options.ubStr, options.lbStr);
+        }
+    }
+
+    if(options.reportOutliers && numGroups > firstNewGroup)
+    { // Over the complete groups, as main() does
+        int firstIndex = ( options.upperBoundSpecified ? wavenumToIndex(options.upperBound, WAVENUMBER, SIZE) : 0 );
+        int lastIndex = ( options.lowerBoundSpecified ? wavenumToIndex(options.lowerBound, WAVENUMBER, SIZE) : SIZE - 1 );
+        const int numGroupedFiles = numGroups * options.groupSize;
+        std::vector<int> timesLowest(numGroupedFiles);
+        std::vector<int> timesHighest(numGroupedFiles);
+        countGroupRejections(&timesLowest[0], &timesHighest[0], &state.IR_DATA[0], numGroups, options.groupSize,
+            firstIndex, lastIndex, options.aggregateMode);
+        printOutlierReport((std::string("outlierReport.") + AGG_PREFIX + std::string(".CSV")).c_str(), &state.titles[0],
+            &timesLowest[0], &timesHighest[0], numGroupedFiles, options.groupSize, lastIndex - firstIndex + 1);
+    }
+
+    long long updated = nowNanos();
+    for(int i = 0; i < numNew; i++)
+        if(status[i] == spa::OK && files[i].noticedNanos > 0)
+            std::cerr << "Added '" << files[i].path << "': outputs updated " << std::fixed << std::setprecision(1)
+                << (updated - files[i].noticedNanos) * 1e-6 << " ms after it was closed.\n" << std::defaultfloat;
+    std::cerr << numFiles << " files, " << numGroups << " complete groups.\n";
+    return;
+}
+
+void watchDirectory(const char* directory, const WatchOptions& options, float WAVENUMBER[])
+{
+    const char* funcDef = "void watchDirectory(const char*, const WatchOptions&, float [])";
+    // Watch before listing, so a file written in between is not missed (seen[] drops the repeat)
+    int inotifyFd = inotify_init1(IN_CLOEXEC);
+    if(inotifyFd < 0 || inotify_add_watch(inotifyFd, directory, IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR) < 0)
+    {
+        std::cerr << "Error: " << funcDef << ": unable to watch directory '" << directory << "': " << std::strerror(errno) << ".\n";
+        std::exit(1);
+    }
+    std::string prefix = std::string(directory) + "/";
+
+    WatchState state;
+    if(options.useAlsBaseline)
+        for(int t = 0; t < options.numThreads; t++)
+        {
+            state.alsWorkspaces.push_back(createAlsWorkspace(spa::NUM_POINTS));
+            checkIfNull(state.alsWorkspaces.back(), funcDef, "AlsWorkspace* state.alsWorkspaces[t]");
+        }
+
+    std::vector<NoticedFile> batch;
+    std::vector<std::string> existing = listSPAFiles(directory);
+    for(size_t i = 0; i < existing.size(); i++)
+    {
+        NoticedFile file = {prefix + existing[i], 0}; // no latency to report
+        state.seen.insert(file.path);
+        batch.push_back(file);
+    }
+    addFiles(state, batch, options, WAVENUMBER);
+    std::cerr << "Watching '" << directory << "' for new SPA files.\n";
+
+    // Whatever arrived while the last batch was processed forms the next batch
+    alignas(inotify_event) char events[64 * (sizeof(inotify_event) + NAME_MAX + 1)];
+    for(;;)
+    {
+        ssize_t length = read(inotifyFd, events, sizeof(events));
+        if(length < 0 && errno == EINTR) continue;
+        if(length <= 0)
+        {
+            std::cerr << "Error: " << funcDef << ": reading inotify events failed: " << std::strerror(errno) << ".\n";
+            std::exit(1);
+        }
+        long long noticed = nowNanos();
+        batch.clear();
+        for(char* next = events; next < events + length; )
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(next);
+            next += sizeof(inotify_event) + event->len;
+            if(event->mask & IN_Q_OVERFLOW)
+                std::cerr << "Warning: " << funcDef << ": too many events at once; some files may have been missed.\n";
+            if(event->len == 0 || (event->mask & IN_ISDIR) || !hasSPAExtension(event->name)) continue;
+            NoticedFile file = {prefix + event->name, noticed};
+            if(!state.seen.insert(file.path).second)
+            { // Columns only grow; a rewritten file would silently change earlier results
+                std::cerr << "Warning: '" << file.path << "' was written again after it was added; ignoring.\n";
+                continue;
+            }
+            batch.push_back(file);
+        }
+        addFiles(state, batch, options, WAVENUMBER);
+    }
+}
+
+#endif // _WIN32
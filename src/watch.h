@@ -0,0 +1,40 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "data-processing.h"
+
+#include <string>
+
+// What to do with each spectrum and which data sets to keep up to date; mirrors the command line
+struct WatchOptions
+{
+    bool upperBoundSpecified;
+    bool lowerBoundSpecified;
+    int upperBound;
+    int lowerBound;
+    std::string ubStr;
+    std::string lbStr;
+    bool groupFiles;
+    int groupSize;
+    AggregateMode aggregateMode;
+    bool reportOutliers;
+    bool useConstCorr;
+    int ubCorr;
+    int lbCorr;
+    const float* reference;     // nullptr unless --reference was given
+    bool convertToAbsorbance;
+    bool useAlsBaseline;
+    double alsLambda;
+    double alsAsymmetry;
+    int alsIterations;
+    int numThreads;
+};
+
+// spa-reader --watch=<dir>: convert the SPA files already in directory, then wait (with inotify)
+// for more to be closed after writing or moved in, and add each to the outputs as it arrives.
+// Every spectrum is read once and kept in memory; the CSV files are rewritten from memory after
+// each batch of new files, and only groups completed by the batch are aggregated. The time from
+// noticing a file to its outputs being written is reported on std::cerr. Does not return.
+void watchDirectory(const char* directory, const WatchOptions& options, float WAVENUMBER[]);
+
+#endif // WATCH_H